@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 #include "wac/wac_common.h"
@@ -52,8 +53,20 @@ wac_value_t native_clock(uint32_t argc, wac_value_t *argv) {
 int main(int argc, char *argv[]) {
 	wac_state_t *W = wac_state_init();
 	wac_defineNativeFun(W, 0, "clock", native_clock);
-	if (argc == 2) {
-		runScript(W, argv[1]);
+	const char *filename = NULL;
+	int i;
+	for (i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "-r") == 0) {
+			W->backend = WAC_BACKEND_REG;
+		} else if (strncmp(argv[i], "-O", 2) == 0) {
+			W->optLevel = argv[i][2] ? (unsigned int)atoi(argv[i] + 2) : 1;
+		} else {
+			filename = argv[i];
+		}
+	}
+
+	if (filename) {
+		runScript(W, filename);
 	} else {
 		repl(W);
 	}
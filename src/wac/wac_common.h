@@ -5,6 +5,27 @@
 #include <stddef.h>
 #include <stdint.h>
 
+//pack wac_value_t into 8 bytes, see wac_value.h
+//#define WAC_NAN_BOXING
+
+//threaded dispatch in wac_vm_run using labels as values
+//define WAC_NO_COMPUTED_GOTO to force the plain switch
+#if defined(__GNUC__) && !defined(WAC_NO_COMPUTED_GOTO)
+#define WAC_COMPUTED_GOTO
+#endif
+
+//fused instructions made by wac_peephole_superinst
+//define WAC_NO_SUPERINST to keep the code as compiled
+
+//typed arithmetic made by wac_infer_types where operand types are proven
+//define WAC_NO_INFER to leave generic ops
+
+//FNV-1a, strings by wac_obj_string_hash and ids by the scanner
+#define WAC_HASH_INIT 2166136261u
+#define WAC_HASH_STEP(hash, c) (((hash) ^ (uint8_t)(c)) * 16777619u)
+
+//define WAC_DEBUG_PROFILE_OPS to print counts of executed opcode n-grams on exit
+
 #ifdef WAC_DEBUG_ALL
 #define WAC_DEBUG_PRINT_CODE
 #define WAC_DEBUG_TRACE_EXEC
@@ -1,12 +1,17 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <math.h>
 
 #include "wac_state.h"
 #include "wac_value.h"
 #include "wac_object.h"
 #include "wac_compiler.h"
 #include "wac_memory.h"
+#include "wac_peephole.h"
+#include "wac_tier.h"
+#include "wac_infer.h"
 
 #ifdef WAC_DEBUG_PRINT_CODE
 #include "wac_debug.h"
@@ -20,6 +25,8 @@
 static void wac_parser_decl(wac_state_t *state);
 static void wac_parser_statement(wac_state_t *state);
 static void wac_parser_decl_var(wac_state_t *state);
+static bool wac_parser_decl_scalar(wac_state_t *state);
+static uint32_t wac_parser_argc(wac_state_t *state);
 
 typedef enum wac_parser_prec_e {
 	WAC_PREC_NONE,
@@ -28,9 +35,13 @@ typedef enum wac_parser_prec_e {
 	WAC_PREC_AND,    	// &&
 	WAC_PREC_EQUAL,  	// == !=
 	WAC_PREC_COMPARE,	// < > <= >=
+	WAC_PREC_BOR,		// |
+	WAC_PREC_BXOR,		// ^
+	WAC_PREC_BAND,		// &
+	WAC_PREC_SHIFT,		// << >>
 	WAC_PREC_TERM,   	// + -
-	WAC_PREC_FACT,   	// * /
-	WAC_PREC_UNARY,  	// ! -
+	WAC_PREC_FACT,   	// * / % ~/
+	WAC_PREC_UNARY,  	// ! - ~
 	WAC_PREC_CALL,   	// . ()
 	WAC_PREC_PRIMARY
 } wac_parser_prec_t;
@@ -55,6 +66,7 @@ static void wac_parser_call(wac_state_t *state, bool canAssign);
 static void wac_parser_dot(wac_state_t *state, bool canAssign);
 static void wac_parser_square(wac_state_t *state, bool canAssign);
 static void wac_parser_this(wac_state_t *state, bool canAssign);
+static void wac_parser_super(wac_state_t *state, bool canAssign);
 
 static wac_parser_rule_t wac_parser_rules[] = {
 	[WAC_TOKEN_LPAREN]		= {wac_parser_group,	wac_parser_call,	WAC_PREC_CALL},
@@ -69,6 +81,9 @@ static wac_parser_rule_t wac_parser_rules[] = {
 	[WAC_TOKEN_MINUS]		= {wac_parser_unary,	wac_parser_binary,	WAC_PREC_TERM},
 	[WAC_TOKEN_STAR]		= {NULL,		wac_parser_binary,	WAC_PREC_FACT},
 	[WAC_TOKEN_SLASH]		= {NULL,		wac_parser_binary,	WAC_PREC_FACT},
+	[WAC_TOKEN_PERCENT]		= {NULL,		wac_parser_binary,	WAC_PREC_FACT},
+	[WAC_TOKEN_CARET]		= {NULL,		wac_parser_binary,	WAC_PREC_BXOR},
+	[WAC_TOKEN_TILDE]		= {wac_parser_unary,	NULL,			WAC_PREC_NONE},
 	[WAC_TOKEN_SEMICOLON]		= {NULL,		NULL,			WAC_PREC_NONE},
 	[WAC_TOKEN_BANG]		= {wac_parser_unary,	NULL,			WAC_PREC_NONE},
 	[WAC_TOKEN_BANG_EQUAL]		= {NULL,		wac_parser_binary,	WAC_PREC_EQUAL},
@@ -78,15 +93,21 @@ static wac_parser_rule_t wac_parser_rules[] = {
 	[WAC_TOKEN_GREATER_EQUAL]	= {NULL,		wac_parser_binary,	WAC_PREC_COMPARE},
 	[WAC_TOKEN_LESS]		= {NULL,		wac_parser_binary,	WAC_PREC_COMPARE},
 	[WAC_TOKEN_LESS_EQUAL]		= {NULL,		wac_parser_binary,	WAC_PREC_COMPARE},
+	[WAC_TOKEN_LESS_LESS]		= {NULL,		wac_parser_binary,	WAC_PREC_SHIFT},
+	[WAC_TOKEN_GREATER_GREATER]	= {NULL,		wac_parser_binary,	WAC_PREC_SHIFT},
+	[WAC_TOKEN_TILDE_SLASH]		= {NULL,		wac_parser_binary,	WAC_PREC_FACT},
+	[WAC_TOKEN_AMPER]		= {NULL,		wac_parser_binary,	WAC_PREC_BAND},
 	[WAC_TOKEN_AMPER_AMPER]		= {NULL,		wac_parser_and,		WAC_PREC_AND},
+	[WAC_TOKEN_BAR]			= {NULL,		wac_parser_binary,	WAC_PREC_BOR},
 	[WAC_TOKEN_BAR_BAR]		= {NULL,		wac_parser_or,		WAC_PREC_OR},
 	[WAC_TOKEN_ID]			= {wac_parser_variable,	NULL,			WAC_PREC_NONE},
 	[WAC_TOKEN_STRING]		= {wac_parser_string,	NULL,			WAC_PREC_NONE},
 	[WAC_TOKEN_NUMBER]		= {wac_parser_number,	NULL,			WAC_PREC_NONE},
 	[WAC_TOKEN_VAR]			= {NULL,		NULL,			WAC_PREC_NONE},
+	[WAC_TOKEN_CONST]		= {NULL,		NULL,			WAC_PREC_NONE},
 	[WAC_TOKEN_CLASS]		= {NULL,		NULL,			WAC_PREC_NONE},
 	[WAC_TOKEN_THIS]		= {wac_parser_this,	NULL,			WAC_PREC_NONE},
-	[WAC_TOKEN_SUPER]		= {NULL,		NULL,			WAC_PREC_NONE},
+	[WAC_TOKEN_SUPER]		= {wac_parser_super,	NULL,			WAC_PREC_NONE},
 	[WAC_TOKEN_FUN]			= {NULL,		NULL,			WAC_PREC_NONE},
 	[WAC_TOKEN_RETURN]		= {NULL,		NULL,			WAC_PREC_NONE},
 	[WAC_TOKEN_IF]			= {NULL,		NULL,			WAC_PREC_NONE},
@@ -152,43 +173,262 @@ static void wac_compiler_emit_2bytes(wac_state_t *state, uint8_t byte1, uint8_t
 	wac_compiler_emit_byte(state, byte2);
 }
 
-static void wac_compiler_emit_4bytes(wac_state_t *state, uint32_t bytes) {
-	wac_page_write_4bytes(state, &state->compiler->fun->page, bytes, state->parser.prev.line);
+//how many values the instruction pushes (or pops when negative)
+//ops whose effect depends on operand are handled in wac_compiler_emit_arg
+//register ops set the depth themselves
+static const int8_t wac_compiler_stackEffect[] = {
+	[WAC_OP_CONST]			= 1,
+	[WAC_OP_CONST_LONG]		= 1,
+	[WAC_OP_NULL]			= 1,
+	[WAC_OP_TRUE]			= 1,
+	[WAC_OP_FALSE]			= 1,
+	[WAC_OP_CLOSURE]		= 1,
+	[WAC_OP_CLOSURE_LONG]		= 1,
+	[WAC_OP_CLASS]			= 1,
+	[WAC_OP_CLASS_LONG]		= 1,
+	[WAC_OP_METHOD]			= -1,
+	[WAC_OP_METHOD_LONG]		= -1,
+	[WAC_OP_INHERIT]		= -1,
+	[WAC_OP_POP]			= -1,
+	[WAC_OP_GET_LOCAL]		= 1,
+	[WAC_OP_GET_LOCAL_LONG]		= 1,
+	[WAC_OP_GET_UPVAL]		= 1,
+	[WAC_OP_GET_UPVAL_LONG]		= 1,
+	[WAC_OP_GET_GLOBAL]		= 1,
+	[WAC_OP_GET_GLOBAL_LONG]	= 1,
+	[WAC_OP_GET_PROPERTY]		= -1,
+	[WAC_OP_GET_PROPERTY_LONG]	= -1,
+	[WAC_OP_SET_PROPERTY]		= -2,
+	[WAC_OP_SET_PROPERTY_LONG]	= -2,
+	[WAC_OP_SET_PROPERTY_CONST]	= -1,
+	[WAC_OP_SET_PROPERTY_CONST_LONG]	= -1,
+	[WAC_OP_GET_SUPER]		= -1,
+	[WAC_OP_GET_SUPER_LONG]		= -1,
+	[WAC_OP_SUPER_INVOKE]		= -1,
+	[WAC_OP_SUPER_INVOKE_LONG]	= -1,
+	[WAC_OP_CLOSE_UPVAL]		= -1,
+	[WAC_OP_DEFINE_GLOBAL]		= -1,
+	[WAC_OP_DEFINE_GLOBAL_LONG]	= -1,
+	[WAC_OP_EQUAL]			= -1,
+	[WAC_OP_GREATER]		= -1,
+	[WAC_OP_LESS]			= -1,
+	[WAC_OP_ADD]			= -1,
+	[WAC_OP_SUB]			= -1,
+	[WAC_OP_MUL]			= -1,
+	[WAC_OP_DIV]			= -1,
+	[WAC_OP_MOD]			= -1,
+	[WAC_OP_IDIV]			= -1,
+	[WAC_OP_BAND]			= -1,
+	[WAC_OP_BOR]			= -1,
+	[WAC_OP_BXOR]			= -1,
+	[WAC_OP_SHL]			= -1,
+	[WAC_OP_SHR]			= -1,
+	[WAC_OP_GET_SCALAR]		= 1,
+	[WAC_OP_GET_SCALAR_LONG]	= 1,
+	[WAC_OP_RET]			= -1,
+	[WAC_OP_ADD_T]			= 0,
+	[WAC_OP_ADD_R]			= 0,
+	[WAC_OP_SUB_T]			= 0,
+	[WAC_OP_SUB_R]			= 0,
+	[WAC_OP_MUL_T]			= 0,
+	[WAC_OP_MUL_R]			= 0,
+	[WAC_OP_DIV_T]			= 0,
+	[WAC_OP_DIV_R]			= 0,
+	[WAC_OP_EQUAL_T]		= 0,
+	[WAC_OP_EQUAL_R]		= 0,
+	[WAC_OP_GREATER_T]		= 0,
+	[WAC_OP_GREATER_R]		= 0,
+	[WAC_OP_LESS_T]			= 0,
+	[WAC_OP_LESS_R]			= 0,
+};
+
+static void wac_compiler_emit_op(wac_state_t *state, uint8_t op) {
+	wac_compiler_t *compiler = state->compiler;
+	compiler->prevInst = compiler->lastInst;
+	compiler->lastInst = compiler->fun->page.usize;
+	compiler->depth += wac_compiler_stackEffect[op];
+	if (compiler->depth > compiler->fun->maxStack) compiler->fun->maxStack = compiler->depth;
+	wac_compiler_emit_byte(state, op);
+}
+
+//picks short form if arg fits in a byte, otherwise op + 1 (the _LONG form)
+static void wac_compiler_emit_arg(wac_state_t *state, uint8_t op, uint32_t arg) {
+	if (arg <= UINT8_MAX) {
+		wac_compiler_emit_op(state, op);
+		wac_compiler_emit_byte(state, (uint8_t)arg);
+	} else {
+		wac_compiler_emit_op(state, op + 1);
+		wac_page_write_4bytes(state, &state->compiler->fun->page, arg, state->parser.prev.line);
+	}
+
+	switch (op) {
+		case WAC_OP_POPN: state->compiler->depth -= arg; break;
+		case WAC_OP_CALL: state->compiler->depth -= arg; break;
+		case WAC_OP_RET_INLINE: state->compiler->depth -= arg; break;
+		default: break;
+	}
+}
+
+//same for two operands, short form only if both fit
+static void wac_compiler_emit_arg2(wac_state_t *state, uint8_t op, uint32_t arg1, uint32_t arg2) {
+	wac_page_t *page = &state->compiler->fun->page;
+	if (arg1 <= UINT8_MAX && arg2 <= UINT8_MAX) {
+		wac_compiler_emit_op(state, op);
+		wac_compiler_emit_2bytes(state, (uint8_t)arg1, (uint8_t)arg2);
+	} else {
+		wac_compiler_emit_op(state, op + 1);
+		wac_page_write_4bytes(state, page, arg1, state->parser.prev.line);
+		wac_page_write_4bytes(state, page, arg2, state->parser.prev.line);
+	}
+
+	if (op == WAC_OP_INVOKE) state->compiler->depth -= arg2;
+}
+
+//same for three operands, only WAC_OP_SUPER_INVOKE has them
+static void wac_compiler_emit_arg3(wac_state_t *state, uint8_t op, uint32_t arg1, uint32_t arg2, uint32_t arg3) {
+	wac_page_t *page = &state->compiler->fun->page;
+	if (arg1 <= UINT8_MAX && arg2 <= UINT8_MAX && arg3 <= UINT8_MAX) {
+		wac_compiler_emit_op(state, op);
+		wac_compiler_emit_2bytes(state, (uint8_t)arg1, (uint8_t)arg2);
+		wac_compiler_emit_byte(state, (uint8_t)arg3);
+	} else {
+		wac_compiler_emit_op(state, op + 1);
+		wac_page_write_4bytes(state, page, arg1, state->parser.prev.line);
+		wac_page_write_4bytes(state, page, arg2, state->parser.prev.line);
+		wac_page_write_4bytes(state, page, arg3, state->parser.prev.line);
+	}
+
+	state->compiler->depth -= arg2;
 }
 
-static void wac_compiler_emit_5bytes(wac_state_t *state, uint8_t byte, uint32_t bytes) {
-	wac_compiler_emit_byte(state, byte);
-	wac_compiler_emit_4bytes(state, bytes);
+//GET_SCALAR or SET_SCALAR, short form only if all four operands fit in a byte
+static void wac_compiler_emit_scalar(wac_state_t *state, uint8_t op, uint32_t local, uint32_t slot, uint32_t name) {
+	wac_compiler_t *compiler = state->compiler;
+	wac_page_t *page = &compiler->fun->page;
+	uint32_t cache = wac_page_addPropertyCache(state, page);
+	if (local <= UINT8_MAX && slot <= UINT8_MAX && name <= UINT8_MAX && cache <= UINT8_MAX) {
+		wac_compiler_emit_op(state, op);
+		wac_compiler_emit_2bytes(state, (uint8_t)local, (uint8_t)slot);
+		wac_compiler_emit_2bytes(state, (uint8_t)name, (uint8_t)cache);
+	} else {
+		wac_compiler_emit_op(state, op + 1);
+		wac_page_write_4bytes(state, page, local, state->parser.prev.line);
+		wac_page_write_4bytes(state, page, slot, state->parser.prev.line);
+		wac_page_write_4bytes(state, page, name, state->parser.prev.line);
+		wac_page_write_4bytes(state, page, cache, state->parser.prev.line);
+	}
+
+	//with an instance in the local, SET_SCALAR puts it under the value
+	if (op == WAC_OP_SET_SCALAR && compiler->depth + 1 > compiler->fun->maxStack) compiler->fun->maxStack = compiler->depth + 1;
 }
 
 static void wac_compiler_emit_ret(wac_state_t *state) {
 	if (state->compiler->type == WAC_FUN_TYPE_INIT) {
-		wac_compiler_emit_5bytes(state, WAC_OP_GET_LOCAL, 0);
+		wac_compiler_emit_arg(state, WAC_OP_GET_LOCAL, 0);
 	} else {
-		wac_compiler_emit_byte(state, WAC_OP_NULL);
+		wac_compiler_emit_op(state, WAC_OP_NULL);
+	}
+	wac_compiler_emit_op(state, WAC_OP_RET);
+}
+
+//slot of the pool holding value, or the empty slot where it goes
+static uint32_t* wac_compiler_pool_find(wac_compiler_t *compiler, wac_value_t value) {
+	wac_value_t *values = compiler->fun->page.consts.values;
+	uint64_t bits = wac_value_bits(value);
+	size_t mask = compiler->pool_asize - 1, i;
+
+	bits ^= bits >> 33;
+	bits *= 0xff51afd7ed558ccdull;
+	bits ^= bits >> 33;
+	for (i = (size_t)bits & mask; compiler->pool[i]; i = (i + 1) & mask) {
+		if (wac_value_same(values[compiler->pool[i] - 1], value)) break;
+	}
+	return &compiler->pool[i];
+}
+
+//index of value in the consts of the function, each constant is added once
+uint32_t wac_compiler_addConst(wac_state_t *state, wac_value_t value) {
+	wac_compiler_t *compiler = state->compiler;
+	wac_valarr_t *consts = &compiler->fun->page.consts;
+	uint32_t *slot, k;
+
+	if ((consts->usize + 1) * 4 > compiler->pool_asize * 3) {
+		size_t oldSize = compiler->pool_asize;
+		//coz gc, value may be a new string nothing else holds yet
+		wac_vm_push(&state->vm, value);
+		WAC_ARRAY_FREE(state, uint32_t, compiler->pool, oldSize);
+		compiler->pool_asize = oldSize ? oldSize * WAC_ARRAY_GROW_MUL : WAC_ARRAY_DEFAULT_SIZE;
+		compiler->pool = WAC_ARRAY_INIT(state, uint32_t, compiler->pool_asize);
+		memset(compiler->pool, 0, compiler->pool_asize * sizeof(uint32_t));
+		for (k = 0; k < consts->usize; ++k) {
+			slot = wac_compiler_pool_find(compiler, consts->values[k]);
+			if (!*slot) *slot = k + 1;
+		}
+		wac_vm_pop(&state->vm);
 	}
-	wac_compiler_emit_byte(state, WAC_OP_RET);
+
+	slot = wac_compiler_pool_find(compiler, value);
+	if (*slot) return *slot - 1;
+	k = wac_page_addConst(state, &compiler->fun->page, value);
+	*slot = k + 1;
+	return k;
 }
 
 static void wac_compiler_emit_const(wac_state_t *state, uint8_t op, wac_value_t value) {
-	wac_compiler_emit_5bytes(state, op, wac_page_addConst(state, &state->compiler->fun->page, value));
+	wac_compiler_emit_arg(state, op, wac_compiler_addConst(state, value));
 }
 
+//inst is one of the _LONG forward jumps, wac_compiler_end shrinks the ones that reach
 static size_t wac_compiler_emit_jmp_forw(wac_state_t *state, uint8_t inst) {
-	wac_compiler_emit_5bytes(state, inst, INVALID_UINT32);
+	wac_compiler_emit_op(state, inst);
+	//until patched, the operand holds stack depth at the jump
+	wac_page_write_4bytes(state, &state->compiler->fun->page, (uint32_t)state->compiler->depth, state->parser.prev.line);
 	return state->compiler->fun->page.usize - 4;
 }
 
-static void wac_compiler_patchJmp(wac_page_t *page, size_t address) {
+static void wac_compiler_patchJmp(wac_state_t *state, size_t address) {
+	wac_page_t *page = &state->compiler->fun->page;
 	size_t jmpAddr = page->usize - address - 4;
+	state->compiler->depth = ((uint32_t)page->code[address] << 24) | (page->code[address + 1] << 16) | (page->code[address + 2] << 8) | page->code[address + 3];
+	state->compiler->lastLabel = page->usize;
+	if (jmpAddr > UINT32_MAX) {
+		wac_parser_error(&state->parser, "Too much code to jump over");
+	}
 	page->code[address    ] = (jmpAddr & 0xFF000000) >> 24;
 	page->code[address + 1] = (jmpAddr & 0x00FF0000) >> 16;
 	page->code[address + 2] = (jmpAddr & 0x0000FF00) >> 8;
 	page->code[address + 3] = (jmpAddr & 0x000000FF);
 }
 
+//backward jump target, code before it cant be merged with code after it
+static size_t wac_compiler_label(wac_state_t *state) {
+	state->compiler->lastLabel = state->compiler->fun->page.usize;
+	return state->compiler->lastLabel;
+}
+
 static void wac_compiler_emit_jmp_back(wac_state_t *state, size_t address) {
-	wac_compiler_emit_5bytes(state, WAC_OP_JMP_BACK, state->compiler->fun->page.usize - address + 5);
+	//offset is from the end of the jump, so it includes the jump itself
+	size_t jmpAddr = state->compiler->fun->page.usize - address + 2;
+	if (jmpAddr > UINT8_MAX) jmpAddr += 3;
+	wac_compiler_emit_arg(state, WAC_OP_JMP_BACK, jmpAddr);
+}
+
+//ids were hashed by the scanner, vm.strings then maps the text to the string
+//other tokens only get here after an error
+static wac_obj_string_t* wac_parser_intern(wac_state_t *state, wac_token_t *name) {
+	uint32_t hash = name->type == WAC_TOKEN_ID ? name->hash : wac_obj_string_hash(name->start, name->len);
+	return wac_obj_string_intern(state, name->start, name->len, hash);
+}
+
+//token for names the compiler declares itself, like this and super
+static wac_token_t wac_parser_token_synth(const char *text) {
+	wac_token_t token;
+	token.type = WAC_TOKEN_ID;
+	token.start = text;
+	token.len = strlen(text);
+	token.line = 0;
+	token.hash = wac_obj_string_hash(text, token.len);
+	return token;
 }
 
 static void wac_compiler_init(wac_state_t *state, wac_compiler_t *compiler, wac_fun_type_t type) {
@@ -202,8 +442,33 @@ static void wac_compiler_init(wac_state_t *state, wac_compiler_t *compiler, wac_
 	compiler->locals_usize = 0;
 	compiler->locals = WAC_ARRAY_INIT(state, wac_local_t, compiler->locals_asize);
 
+	compiler->captures_asize = 0;
+	compiler->captures_usize = 0;
+	compiler->captures = NULL;
+
+	compiler->consts_asize = 0;
+	compiler->consts_usize = 0;
+	compiler->consts = NULL;
+
+	compiler->inlines_asize = 0;
+	compiler->inlines_usize = 0;
+	compiler->inlines = NULL;
+
+	compiler->scalars_asize = 0;
+	compiler->scalars_usize = 0;
+	compiler->scalars = NULL;
+
+	compiler->pool_asize = 0;
+	compiler->pool = NULL;
+
 	compiler->scopeDepth = 0;
+	compiler->fold = false;
+	compiler->depth = 1;
+	compiler->lastInst = INVALID_SIZE;
+	compiler->prevInst = INVALID_SIZE;
+	compiler->lastLabel = 0;
 	compiler->fun = wac_obj_fun_init(state);
+	compiler->fun->maxStack = compiler->depth;
 	state->compiler = compiler;
 
 	if (type == WAC_FUN_TYPE_SCRIPT) {
@@ -212,24 +477,71 @@ static void wac_compiler_init(wac_state_t *state, wac_compiler_t *compiler, wac_
 	} else {
 		compiler->upvals_asize = WAC_ARRAY_DEFAULT_SIZE;
 		compiler->upvals = WAC_ARRAY_INIT(state, wac_upval_t, compiler->upvals_asize);
-		state->compiler->fun->name = wac_obj_string_copy(state, state->parser.prev.start, state->parser.prev.len);
+		state->compiler->fun->name = wac_parser_intern(state, &state->parser.prev);
 	}
 
 	local = &state->compiler->locals[state->compiler->locals_usize++];
 	local->depth = 0;
 	local->isCaptured = false;
+	local->isAssigned = false;
+	local->isCapturedEarly = false;
 	if (type != WAC_FUN_TYPE_FUN) {
-		local->name.start = "this";
-		local->name.len = 4;
+		local->name = wac_parser_token_synth("this");
 	} else {
-		local->name.start = "";
-		local->name.len = 0;
+		local->name = wac_parser_token_synth("");
+	}
+}
+
+//called when locals[index] goes out of scope, true when it has to be closed
+//closures got copies of it if it was never assigned, so it does not need that
+static bool wac_compiler_local_release(wac_compiler_t *compiler, uint32_t index) {
+	wac_local_t *local = &compiler->locals[index];
+	size_t i, j = 0;
+
+	for (i = 0; i < compiler->captures_usize; ++i) {
+		if (compiler->captures[i].local != index) {
+			compiler->captures[j++] = compiler->captures[i];
+		} else if (!local->isAssigned) {
+			compiler->fun->page.code[compiler->captures[i].address] |= WAC_UPVAL_COPY;
+		}
 	}
+	compiler->captures_usize = j;
+
+	if (!local->isCaptured || (!local->isAssigned && !local->isCapturedEarly)) return false;
+	compiler->fun->closesUpvals = true;
+	return true;
+}
+
+//field of the method when all it does is return this.field
+static wac_obj_string_t* wac_compiler_getter(wac_page_t *page) {
+	uint8_t *code = page->code;
+	if (page->usize >= 5 && code[0] == WAC_OP_GET_LOCAL_PROPERTY && code[1] == 0 && code[4] == WAC_OP_RET) {
+		return WAC_OBJ_AS_STRING(page->consts.values[code[2]]);
+	}
+	if (page->usize >= 6 && code[0] == WAC_OP_GET_LOCAL && code[1] == 0 && code[2] == WAC_OP_GET_PROPERTY_CONST && code[5] == WAC_OP_RET) {
+		return WAC_OBJ_AS_STRING(page->consts.values[code[3]]);
+	}
+	return NULL;
 }
 
 static wac_obj_fun_t* wac_compiler_end(wac_state_t *state) {
+	size_t i;
 	wac_compiler_emit_ret(state);
 	wac_obj_fun_t *fun = state->compiler->fun;
+	//locals of the function body are released by WAC_OP_RET
+	for (i = state->compiler->locals_usize - 1; i != INVALID_SIZE; --i) {
+		wac_compiler_local_release(state->compiler, (uint32_t)i);
+	}
+	if (!state->parser.error) wac_peephole_shrinkJumps(&fun->page);
+	if (!state->parser.error && state->optLevel >= 2) wac_peephole_optimize(state, &fun->page);
+#ifndef WAC_NO_SUPERINST
+	if (!state->parser.error && state->optLevel >= 1) wac_peephole_superinst(&fun->page);
+#endif
+#ifndef WAC_NO_INFER
+	if (!state->parser.error && state->optLevel >= 1) wac_infer_types(fun);
+#endif
+	if (!state->parser.error && state->optLevel >= 3) fun->hotCalls = WAC_TIER_HOT_CALLS;
+	if (!state->parser.error && state->compiler->type == WAC_FUN_TYPE_METHOD && !fun->arity) fun->getter = wac_compiler_getter(&fun->page);
 #ifdef WAC_DEBUG_PRINT_CODE
 	if (!state->parser.error) {
 		wac_page_disass(&state->compiler->fun->page, fun->name ? fun->name->buf : "<script>");
@@ -239,6 +551,32 @@ static wac_obj_fun_t* wac_compiler_end(wac_state_t *state) {
 	state->compiler->locals_asize = 0;
 	state->compiler->locals_usize = 0;
 	state->compiler->locals = NULL;
+	WAC_ARRAY_FREE(state, wac_capture_t, state->compiler->captures, state->compiler->captures_asize);
+	state->compiler->captures_asize = 0;
+	state->compiler->captures_usize = 0;
+	state->compiler->captures = NULL;
+	//top level consts stay constant for later compilations, their names are in vm.globalNames already
+	if (!state->parser.error && !state->compiler->prev) {
+		for (i = 0; i < state->compiler->consts_usize; ++i) {
+			if (state->compiler->consts[i].depth) continue;
+			wac_table_set(state, &state->vm.globalConsts, wac_parser_intern(state, &state->compiler->consts[i].name), state->compiler->consts[i].value);
+		}
+	}
+	WAC_ARRAY_FREE(state, wac_const_t, state->compiler->consts, state->compiler->consts_asize);
+	state->compiler->consts_asize = 0;
+	state->compiler->consts_usize = 0;
+	state->compiler->consts = NULL;
+	WAC_ARRAY_FREE(state, wac_inline_t, state->compiler->inlines, state->compiler->inlines_asize);
+	state->compiler->inlines_asize = 0;
+	state->compiler->inlines_usize = 0;
+	state->compiler->inlines = NULL;
+	WAC_ARRAY_FREE(state, wac_scalar_t, state->compiler->scalars, state->compiler->scalars_asize);
+	state->compiler->scalars_asize = 0;
+	state->compiler->scalars_usize = 0;
+	state->compiler->scalars = NULL;
+	WAC_ARRAY_FREE(state, uint32_t, state->compiler->pool, state->compiler->pool_asize);
+	state->compiler->pool_asize = 0;
+	state->compiler->pool = NULL;
 
 	state->compiler = state->compiler->prev;
 	return fun;
@@ -279,8 +617,38 @@ static void wac_parser_expr(wac_state_t *state) {
 	wac_parser_prec(state, WAC_PREC_ASSIGN);
 }
 
+//int without fraction, double if it has one or does not fit between WAC_VAL_INT_MIN and WAC_VAL_INT_MAX
+//hex is bit pattern of the int, so 0xFFFFFFFFFFFFFFFF is -1 (0xFFFFFFFFFFFF with nan boxing)
 static void wac_parser_number(wac_state_t *state, bool canAssign) {
-	wac_compiler_emit_const(state, WAC_OP_CONST, WAC_VAL_NUMBER(strtod(state->parser.prev.start, NULL)));
+	const char *start = state->parser.prev.start;
+	size_t len = state->parser.prev.len;
+	unsigned long long bits;
+	long long n;
+
+	if (len > 2 && (start[1] == 'x' || start[1] == 'X')) {
+		bits = len > 18 ? 0 : strtoull(start, NULL, 16);
+#ifdef WAC_NAN_BOXING
+		if (len > 18 || bits > WAC_VAL_INT_MASK) {
+#else
+		if (len > 18) {
+#endif
+			wac_parser_error(&state->parser, "Integer literal is too big");
+			return;
+		}
+		wac_compiler_emit_const(state, WAC_OP_CONST, WAC_VAL_INT((int64_t)bits));
+		return;
+	}
+
+	if (!memchr(start, '.', len)) {
+		errno = 0;
+		n = strtoll(start, NULL, 10);
+		if (errno != ERANGE && n >= WAC_VAL_INT_MIN && n <= WAC_VAL_INT_MAX) {
+			wac_compiler_emit_const(state, WAC_OP_CONST, WAC_VAL_INT((int64_t)n));
+			return;
+		}
+	}
+
+	wac_compiler_emit_const(state, WAC_OP_CONST, WAC_VAL_NUMBER(strtod(start, NULL)));
 }
 
 static void wac_parser_group(wac_state_t *state, bool canAssign) {
@@ -288,43 +656,204 @@ static void wac_parser_group(wac_state_t *state, bool canAssign) {
 	wac_parser_eat(state, WAC_TOKEN_RPAREN, "Expected ')' after expresion");
 }
 
+//value of instruction at address if it only loads a constant
+static bool wac_compiler_constLoad(wac_page_t *page, size_t address, wac_value_t *value) {
+	uint8_t *code = page->code + address;
+	switch (code[0]) {
+		case WAC_OP_CONST: *value = page->consts.values[code[1]]; return true;
+		case WAC_OP_CONST_LONG: *value = page->consts.values[((uint32_t)code[1] << 24) | (code[2] << 16) | (code[3] << 8) | code[4]]; return true;
+		case WAC_OP_NULL: *value = WAC_VAL_NULL; return true;
+		case WAC_OP_TRUE: *value = WAC_VAL_BOOL(true); return true;
+		case WAC_OP_FALSE: *value = WAC_VAL_BOOL(false); return true;
+		default: return false;
+	}
+}
+
+//the expression from start is a single constant load, that no jump goes into
+static bool wac_compiler_constExpr(wac_state_t *state, size_t start, wac_value_t *value) {
+	wac_compiler_t *compiler = state->compiler;
+	wac_page_t *page = &compiler->fun->page;
+	return start != INVALID_SIZE
+		&& compiler->lastInst == start
+		&& compiler->lastLabel <= start
+		&& start + wac_page_inst_size(page, start) == page->usize
+		&& wac_compiler_constLoad(page, start, value);
+}
+
+static void wac_compiler_emit_value(wac_state_t *state, wac_value_t value) {
+	if (WAC_VAL_IS_NULL(value)) {
+		wac_compiler_emit_op(state, WAC_OP_NULL);
+	} else if (WAC_VAL_IS_BOOL(value)) {
+		wac_compiler_emit_op(state, WAC_VAL_AS_BOOL(value) ? WAC_OP_TRUE : WAC_OP_FALSE);
+	} else {
+		wac_compiler_emit_const(state, WAC_OP_CONST, value);
+	}
+}
+
+//drops code of count constant operands from start and loads value instead
+static void wac_compiler_fold(wac_state_t *state, size_t start, size_t count, wac_value_t value) {
+	wac_compiler_t *compiler = state->compiler;
+	compiler->fun->page.usize = start;
+	compiler->depth -= count;
+	compiler->lastInst = compiler->prevInst = INVALID_SIZE;
+	wac_compiler_emit_value(state, value);
+}
+
 static void wac_parser_unary(wac_state_t *state, bool canAssign) {
 	wac_token_type_t type = state->parser.prev.type;
+	size_t operand = state->compiler->fun->page.usize;
+	wac_value_t a, result;
+	uint8_t op;
 
 	wac_parser_prec(state, WAC_PREC_UNARY);
 
 	switch (type) {
-		case WAC_TOKEN_PLUS: break;
-		case WAC_TOKEN_MINUS: wac_compiler_emit_byte(state, WAC_OP_NEG); break;
-		case WAC_TOKEN_BANG: wac_compiler_emit_byte(state, WAC_OP_NOT); break;
+		case WAC_TOKEN_PLUS: return;
+		case WAC_TOKEN_MINUS: op = WAC_OP_NEG; break;
+		case WAC_TOKEN_BANG: op = WAC_OP_NOT; break;
+		case WAC_TOKEN_TILDE: op = WAC_OP_BNOT; break;
 		default: return;
 	}
+
+	if (state->compiler->fold && wac_compiler_constExpr(state, operand, &a) && wac_peephole_fold_unary(op, a, &result)) {
+		wac_compiler_fold(state, operand, 1, result);
+	} else {
+		wac_compiler_emit_op(state, op);
+	}
+}
+
+//instruction at address as RK operand of register op
+static bool wac_compiler_rk(wac_page_t *page, size_t address, uint8_t *operand) {
+	uint8_t index = page->code[address + 1];
+	if (index > WAC_RK_INDEX_MAX) return false;
+
+	switch (page->code[address]) {
+		case WAC_OP_GET_LOCAL: *operand = index; return true;
+		case WAC_OP_CONST: *operand = index | WAC_RK_CONST; return true;
+		default: return false;
+	}
+}
+
+//left is the last instruction of left operand, right is where right operand starts
+//operands that are just local/const loads are dropped and read by register op directly
+static void wac_compiler_emit_binary(wac_state_t *state, uint8_t op, uint8_t regOp, size_t left, size_t right) {
+	wac_compiler_t *compiler = state->compiler;
+	wac_page_t *page = &compiler->fun->page;
+	size_t dst = compiler->depth - 2;
+	uint8_t a, b;
+
+	if (state->backend != WAC_BACKEND_REG
+		|| dst > WAC_RK_INDEX_MAX
+		|| compiler->lastInst != right
+		|| page->usize != right + 2
+		|| compiler->lastLabel > right
+		|| !wac_compiler_rk(page, right, &b)
+	) {
+		wac_compiler_emit_op(state, op);
+		return;
+	}
+
+	page->usize = right;
+	if (left != INVALID_SIZE && left + 2 == right && compiler->lastLabel <= left && wac_compiler_rk(page, left, &a)) {
+		page->usize = left;
+	} else {
+		a = (uint8_t)dst;
+	}
+
+	compiler->lastInst = compiler->prevInst = INVALID_SIZE;
+	wac_compiler_emit_op(state, regOp);
+	wac_compiler_emit_byte(state, (uint8_t)dst);
+	wac_compiler_emit_byte(state, a);
+	wac_compiler_emit_byte(state, b);
+	compiler->depth = dst + 1;
+}
+
+//both operands are constant loads, so the result is computed now
+static bool wac_compiler_fold_operands(wac_state_t *state, wac_token_type_t type, size_t left, size_t right) {
+	wac_page_t *page = &state->compiler->fun->page;
+	wac_value_t a, b, result;
+	bool negate = false;
+	uint8_t op;
+
+	switch (type) {
+		case WAC_TOKEN_PLUS: op = WAC_OP_ADD; break;
+		case WAC_TOKEN_MINUS: op = WAC_OP_SUB; break;
+		case WAC_TOKEN_STAR: op = WAC_OP_MUL; break;
+		case WAC_TOKEN_SLASH: op = WAC_OP_DIV; break;
+		case WAC_TOKEN_PERCENT: op = WAC_OP_MOD; break;
+		case WAC_TOKEN_TILDE_SLASH: op = WAC_OP_IDIV; break;
+		case WAC_TOKEN_AMPER: op = WAC_OP_BAND; break;
+		case WAC_TOKEN_BAR: op = WAC_OP_BOR; break;
+		case WAC_TOKEN_CARET: op = WAC_OP_BXOR; break;
+		case WAC_TOKEN_LESS_LESS: op = WAC_OP_SHL; break;
+		case WAC_TOKEN_GREATER_GREATER: op = WAC_OP_SHR; break;
+		case WAC_TOKEN_BANG_EQUAL: op = WAC_OP_EQUAL; negate = true; break;
+		case WAC_TOKEN_EQUAL_EQUAL: op = WAC_OP_EQUAL; break;
+		case WAC_TOKEN_GREATER: op = WAC_OP_GREATER; break;
+		case WAC_TOKEN_GREATER_EQUAL: op = WAC_OP_LESS; negate = true; break;
+		case WAC_TOKEN_LESS: op = WAC_OP_LESS; break;
+		case WAC_TOKEN_LESS_EQUAL: op = WAC_OP_GREATER; negate = true; break;
+		default: return false;
+	}
+
+	if (!state->compiler->fold
+		|| left == INVALID_SIZE
+		|| left + wac_page_inst_size(page, left) != right
+		|| state->compiler->lastLabel > left
+		|| !wac_compiler_constLoad(page, left, &a)
+		|| !wac_compiler_constExpr(state, right, &b)
+		|| !wac_peephole_fold_binary(state, op, a, b, &result)
+	) return false;
+
+	if (negate) result = WAC_VAL_BOOL(wac_value_falsey(result));
+	wac_compiler_fold(state, left, 2, result);
+	return true;
 }
 
 static void wac_parser_binary(wac_state_t *state, bool canAssign) {
 	wac_token_type_t type = state->parser.prev.type;
+	size_t left = state->compiler->lastInst;
+	size_t right = state->compiler->fun->page.usize;
 	wac_parser_prec(state, (wac_parser_prec_t)(wac_parser_rules[type].prec + 1));
 
+	if (wac_compiler_fold_operands(state, type, left, right)) return;
+
 	switch (type) {
-		case WAC_TOKEN_PLUS: wac_compiler_emit_byte(state, WAC_OP_ADD); break;
-		case WAC_TOKEN_MINUS: wac_compiler_emit_byte(state, WAC_OP_SUB); break;
-		case WAC_TOKEN_STAR: wac_compiler_emit_byte(state, WAC_OP_MUL); break;
-		case WAC_TOKEN_SLASH: wac_compiler_emit_byte(state, WAC_OP_DIV); break;
-		case WAC_TOKEN_BANG_EQUAL: wac_compiler_emit_2bytes(state, WAC_OP_EQUAL, WAC_OP_NOT); break;
-		case WAC_TOKEN_EQUAL_EQUAL: wac_compiler_emit_byte(state, WAC_OP_EQUAL); break;
-		case WAC_TOKEN_GREATER: wac_compiler_emit_byte(state, WAC_OP_GREATER); break;
-		case WAC_TOKEN_GREATER_EQUAL: wac_compiler_emit_2bytes(state, WAC_OP_LESS, WAC_OP_NOT); break;
-		case WAC_TOKEN_LESS: wac_compiler_emit_byte(state, WAC_OP_LESS); break;
-		case WAC_TOKEN_LESS_EQUAL: wac_compiler_emit_2bytes(state, WAC_OP_GREATER, WAC_OP_NOT); break;
+		case WAC_TOKEN_PLUS: wac_compiler_emit_binary(state, WAC_OP_ADD, WAC_OP_ADD_T, left, right); break;
+		case WAC_TOKEN_MINUS: wac_compiler_emit_binary(state, WAC_OP_SUB, WAC_OP_SUB_T, left, right); break;
+		case WAC_TOKEN_STAR: wac_compiler_emit_binary(state, WAC_OP_MUL, WAC_OP_MUL_T, left, right); break;
+		case WAC_TOKEN_SLASH: wac_compiler_emit_binary(state, WAC_OP_DIV, WAC_OP_DIV_T, left, right); break;
+		case WAC_TOKEN_PERCENT: wac_compiler_emit_op(state, WAC_OP_MOD); break;
+		case WAC_TOKEN_TILDE_SLASH: wac_compiler_emit_op(state, WAC_OP_IDIV); break;
+		case WAC_TOKEN_AMPER: wac_compiler_emit_op(state, WAC_OP_BAND); break;
+		case WAC_TOKEN_BAR: wac_compiler_emit_op(state, WAC_OP_BOR); break;
+		case WAC_TOKEN_CARET: wac_compiler_emit_op(state, WAC_OP_BXOR); break;
+		case WAC_TOKEN_LESS_LESS: wac_compiler_emit_op(state, WAC_OP_SHL); break;
+		case WAC_TOKEN_GREATER_GREATER: wac_compiler_emit_op(state, WAC_OP_SHR); break;
+		case WAC_TOKEN_BANG_EQUAL:
+			wac_compiler_emit_binary(state, WAC_OP_EQUAL, WAC_OP_EQUAL_T, left, right);
+			wac_compiler_emit_op(state, WAC_OP_NOT);
+			break;
+		case WAC_TOKEN_EQUAL_EQUAL: wac_compiler_emit_binary(state, WAC_OP_EQUAL, WAC_OP_EQUAL_T, left, right); break;
+		case WAC_TOKEN_GREATER: wac_compiler_emit_binary(state, WAC_OP_GREATER, WAC_OP_GREATER_T, left, right); break;
+		case WAC_TOKEN_GREATER_EQUAL:
+			wac_compiler_emit_binary(state, WAC_OP_LESS, WAC_OP_LESS_T, left, right);
+			wac_compiler_emit_op(state, WAC_OP_NOT);
+			break;
+		case WAC_TOKEN_LESS: wac_compiler_emit_binary(state, WAC_OP_LESS, WAC_OP_LESS_T, left, right); break;
+		case WAC_TOKEN_LESS_EQUAL:
+			wac_compiler_emit_binary(state, WAC_OP_GREATER, WAC_OP_GREATER_T, left, right);
+			wac_compiler_emit_op(state, WAC_OP_NOT);
+			break;
 		default: return;
 	}
 }
 
 static void wac_parser_literal(wac_state_t *state, bool canAssign) {
 	switch (state->parser.prev.type) {
-		case WAC_TOKEN_NULL: wac_compiler_emit_byte(state, WAC_OP_NULL); break;
-		case WAC_TOKEN_TRUE: wac_compiler_emit_byte(state, WAC_OP_TRUE); break;
-		case WAC_TOKEN_FALSE: wac_compiler_emit_byte(state, WAC_OP_FALSE); break;
+		case WAC_TOKEN_NULL: wac_compiler_emit_op(state, WAC_OP_NULL); break;
+		case WAC_TOKEN_TRUE: wac_compiler_emit_op(state, WAC_OP_TRUE); break;
+		case WAC_TOKEN_FALSE: wac_compiler_emit_op(state, WAC_OP_FALSE); break;
 		default: return;
 	}
 }
@@ -333,10 +862,39 @@ static void wac_parser_string(wac_state_t *state, bool canAssign) {
 	wac_compiler_emit_const(state, WAC_OP_CONST, WAC_VAL_OBJ(wac_obj_string_copy(state, state->parser.prev.start + 1, state->parser.prev.len - 2)));
 }
 
+//register op, SET_LOCAL x, POP becomes register op writing to x
+static bool wac_compiler_fuse_store(wac_state_t *state) {
+	wac_compiler_t *compiler = state->compiler;
+	wac_page_t *page = &compiler->fun->page;
+	size_t set = compiler->lastInst, reg = compiler->prevInst;
+	uint8_t dst, a, b;
+
+	if (state->backend != WAC_BACKEND_REG || set == INVALID_SIZE || reg == INVALID_SIZE) return false;
+	if (page->usize != set + 2 || page->code[set] != WAC_OP_SET_LOCAL || reg + 4 != set) return false;
+	if (page->code[reg] < WAC_OP_ADD_T || page->code[reg] > WAC_OP_LESS_T || compiler->lastLabel > reg) return false;
+
+	dst = page->code[reg + 1];
+	a = page->code[reg + 2];
+	b = page->code[reg + 3];
+	//_R form doesnt move sp, so the result must not be read from a temp slot
+	if (dst != compiler->depth - 1) return false;
+	if ((!(a & WAC_RK_CONST) && a >= dst) || (!(b & WAC_RK_CONST) && b >= dst)) return false;
+	//left as _T for wac_peephole_optimize to fold
+	if ((a & WAC_RK_CONST) && (b & WAC_RK_CONST) && state->optLevel >= 2) return false;
+
+	page->code[reg] += WAC_OP_ADD_R - WAC_OP_ADD_T;
+	page->code[reg + 1] = page->code[set + 1];
+	page->usize = set;
+	compiler->lastInst = reg;
+	compiler->prevInst = INVALID_SIZE;
+	--compiler->depth;
+	return true;
+}
+
 static void wac_parser_statement_expr(wac_state_t *state) {
 	wac_parser_expr(state);
 	wac_parser_eat(state, WAC_TOKEN_SEMICOLON, "Expected ';' after expression");
-	wac_compiler_emit_byte(state, WAC_OP_POP);
+	if (!wac_compiler_fuse_store(state)) wac_compiler_emit_op(state, WAC_OP_POP);
 }
 
 static void wac_parser_statement_block(wac_state_t *state) {
@@ -354,33 +912,33 @@ static void wac_parser_statement_if(wac_state_t *state) {
 	wac_parser_expr(state);
 	wac_parser_eat(state, WAC_TOKEN_RPAREN, "Expected ')' after condition");
 
-	ifJmp = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FALSE);
-	wac_compiler_emit_byte(state, WAC_OP_POP);
+	ifJmp = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FALSE_LONG);
+	wac_compiler_emit_op(state, WAC_OP_POP);
 	wac_parser_statement(state);
 
-	elseJmp = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FORW);
+	elseJmp = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FORW_LONG);
 
-	wac_compiler_patchJmp(&state->compiler->fun->page, ifJmp);
-	wac_compiler_emit_byte(state, WAC_OP_POP);
+	wac_compiler_patchJmp(state, ifJmp);
+	wac_compiler_emit_op(state, WAC_OP_POP);
 
 	if (wac_parser_match(state, WAC_TOKEN_ELSE)) wac_parser_statement(state);
-	wac_compiler_patchJmp(&state->compiler->fun->page, elseJmp);
+	wac_compiler_patchJmp(state, elseJmp);
 }
 
 static void wac_parser_statement_while(wac_state_t* state) {
-	size_t exitJmp, loopJmp = state->compiler->fun->page.usize;
+	size_t exitJmp, loopJmp = wac_compiler_label(state);
 
 	wac_parser_eat(state, WAC_TOKEN_LPAREN, "Expected '(' after while");
 	wac_parser_expr(state);
 	wac_parser_eat(state, WAC_TOKEN_RPAREN, "Expected ')' after condition");
 
-	exitJmp = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FALSE);
-	wac_compiler_emit_byte(state, WAC_OP_POP);
+	exitJmp = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FALSE_LONG);
+	wac_compiler_emit_op(state, WAC_OP_POP);
 	wac_parser_statement(state);
 	wac_compiler_emit_jmp_back(state, loopJmp);
 
-	wac_compiler_patchJmp(&state->compiler->fun->page, exitJmp);
-	wac_compiler_emit_byte(state, WAC_OP_POP);
+	wac_compiler_patchJmp(state, exitJmp);
+	wac_compiler_emit_op(state, WAC_OP_POP);
 }
 
 static void wac_compiler_scope_begin(wac_state_t *state) {
@@ -391,13 +949,17 @@ static void wac_compiler_scope_end(wac_state_t *state) {
 	uint32_t numLocals = 0;
 	--state->compiler->scopeDepth;
 
+	while (state->compiler->consts_usize > 0 && state->compiler->consts[state->compiler->consts_usize - 1].depth > state->compiler->scopeDepth) {
+		--state->compiler->consts_usize;
+	}
+
 	while (state->compiler->locals_usize > 0 && state->compiler->locals[state->compiler->locals_usize - 1].depth > state->compiler->scopeDepth) {
-		if (state->compiler->locals[state->compiler->locals_usize - 1].isCaptured) {
+		if (wac_compiler_local_release(state->compiler, (uint32_t)(state->compiler->locals_usize - 1))) {
 			if (numLocals > 0) {
-				wac_compiler_emit_5bytes(state, WAC_OP_POPN, numLocals);
+				wac_compiler_emit_arg(state, WAC_OP_POPN, numLocals);
 				numLocals = 0;
 			}
-			wac_compiler_emit_byte(state, WAC_OP_CLOSE_UPVAL);
+			wac_compiler_emit_op(state, WAC_OP_CLOSE_UPVAL);
 		} else {
 			++numLocals;
 		}
@@ -405,7 +967,11 @@ static void wac_compiler_scope_end(wac_state_t *state) {
 	}
 
 	if (numLocals > 0) {
-		wac_compiler_emit_5bytes(state, WAC_OP_POPN, numLocals);
+		wac_compiler_emit_arg(state, WAC_OP_POPN, numLocals);
+	}
+
+	while (state->compiler->scalars_usize > 0 && state->compiler->scalars[state->compiler->scalars_usize - 1].local >= state->compiler->locals_usize) {
+		--state->compiler->scalars_usize;
 	}
 }
 
@@ -422,39 +988,53 @@ static void wac_parser_statement_for(wac_state_t *state) {
 		wac_parser_statement_expr(state);
 	}
 
-	loopJmp = state->compiler->fun->page.usize;
+	loopJmp = wac_compiler_label(state);
 	exitJmp = INVALID_SIZE;
 	if (!wac_parser_match(state, WAC_TOKEN_SEMICOLON)) {
 		wac_parser_expr(state);
 		wac_parser_eat(state, WAC_TOKEN_SEMICOLON, "Expected ';' after for loop condition");
-		exitJmp = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FALSE);
-		wac_compiler_emit_byte(state, WAC_OP_POP);
+		exitJmp = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FALSE_LONG);
+		wac_compiler_emit_op(state, WAC_OP_POP);
 	}
 
 	if (!wac_parser_match(state, WAC_TOKEN_RPAREN)) {
-		size_t bodyJmp = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FORW);
-		size_t incJmp = state->compiler->fun->page.usize;
+		size_t bodyJmp = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FORW_LONG);
+		size_t incJmp = wac_compiler_label(state);
 		wac_parser_expr(state);
-		wac_compiler_emit_byte(state, WAC_OP_POP);
+		wac_compiler_emit_op(state, WAC_OP_POP);
 		wac_parser_eat(state, WAC_TOKEN_RPAREN, "Expected ')' after for clauses");
 
 		wac_compiler_emit_jmp_back(state, loopJmp);
 		loopJmp = incJmp;
-		wac_compiler_patchJmp(&state->compiler->fun->page, bodyJmp);
+		wac_compiler_patchJmp(state, bodyJmp);
 	}
 	
 	wac_parser_statement(state);
 	wac_compiler_emit_jmp_back(state, loopJmp);
 
 	if (exitJmp != INVALID_SIZE) {
-		wac_compiler_patchJmp(&state->compiler->fun->page, exitJmp);
-		wac_compiler_emit_byte(state, WAC_OP_POP);
+		wac_compiler_patchJmp(state, exitJmp);
+		wac_compiler_emit_op(state, WAC_OP_POP);
 	}
 
 	wac_compiler_scope_end(state);
 }
 
+//call that is the last instruction becomes TAIL_CALL
+//RET stays after it, for callees that get a frame of their own
+static void wac_compiler_tailCall(wac_state_t *state) {
+	wac_compiler_t *compiler = state->compiler;
+	wac_page_t *page = &compiler->fun->page;
+	size_t last = compiler->lastInst;
+
+	if (last == INVALID_SIZE || (page->code[last] != WAC_OP_CALL && page->code[last] != WAC_OP_CALL_LONG)) return;
+	if (last + wac_page_inst_size(page, last) != page->usize) return;
+	page->code[last] += WAC_OP_TAIL_CALL - WAC_OP_CALL;
+}
+
 static void wac_parser_statement_ret(wac_state_t *state) {
+	//code after return is unreachable, it continues with depth from before
+	size_t depth = state->compiler->depth;
 	if (wac_parser_match(state, WAC_TOKEN_SEMICOLON)) {
 		wac_compiler_emit_ret(state);
 	} else {
@@ -463,8 +1043,10 @@ static void wac_parser_statement_ret(wac_state_t *state) {
 		}
 		wac_parser_expr(state);
 		wac_parser_eat(state, WAC_TOKEN_SEMICOLON, "Expected ';' after return value");
-		wac_compiler_emit_byte(state, WAC_OP_RET);
+		wac_compiler_tailCall(state);
+		wac_compiler_emit_op(state, WAC_OP_RET);
 	}
+	state->compiler->depth = depth;
 }
 
 static void wac_parser_statement(wac_state_t *state) {
@@ -492,6 +1074,7 @@ static void wac_parser_sync(wac_state_t *state) {
 		if (state->parser.prev.type == WAC_TOKEN_SEMICOLON) return;
 		switch (state->parser.curr.type) {
 			case WAC_TOKEN_VAR:
+			case WAC_TOKEN_CONST:
 			case WAC_TOKEN_CLASS:
 			case WAC_TOKEN_FUN:
 			case WAC_TOKEN_RETURN:
@@ -507,7 +1090,11 @@ static void wac_parser_sync(wac_state_t *state) {
 }
 
 static uint32_t wac_parser_const_id(wac_state_t *state, wac_token_t *name) {
-	return wac_page_addConst(state, &state->compiler->fun->page, WAC_VAL_OBJ(wac_obj_string_copy(state, name->start, name->len)));
+	return wac_compiler_addConst(state, WAC_VAL_OBJ(wac_parser_intern(state, name)));
+}
+
+static uint32_t wac_parser_global_id(wac_state_t *state, wac_token_t *name) {
+	return wac_vm_global_index(state, wac_parser_intern(state, name));
 }
 
 static void wac_compiler_local_add(wac_state_t *state, wac_token_t name) {
@@ -520,6 +1107,8 @@ static void wac_compiler_local_add(wac_state_t *state, wac_token_t name) {
 	local->name = name;
 	local->depth = INVALID_UINT;
 	local->isCaptured = false;
+	local->isAssigned = false;
+	local->isCapturedEarly = false;
 }
 
 static bool wac_parser_idEqual(wac_token_t *a, wac_token_t *b) {
@@ -544,6 +1133,43 @@ static uint32_t wac_compiler_resolve_local(wac_parser_t *parser, wac_compiler_t
 	return INVALID_UINT32;
 }
 
+//value of name if it is a top level const of an earlier compilation, like a previous line of the repl
+static bool wac_compiler_const_global(wac_state_t *state, wac_token_t *name, wac_value_t *value) {
+	return wac_table_get(&state->vm.globalConsts, wac_parser_intern(state, name), value);
+}
+
+//const declared in the current scope
+static bool wac_compiler_const_inScope(wac_state_t *state, wac_token_t *name) {
+	wac_compiler_t *compiler = state->compiler;
+	wac_value_t value;
+	size_t i;
+	for (i = compiler->consts_usize - 1; i != INVALID_SIZE; --i) {
+		if (compiler->consts[i].depth < compiler->scopeDepth) break;
+		if (wac_parser_idEqual(name, &compiler->consts[i].name)) return true;
+	}
+	return compiler->scopeDepth == 0 && wac_compiler_const_global(state, name, &value);
+}
+
+//value of name if it is a const, false when it is a variable
+//the one from the deeper scope wins, in outer functions too
+static bool wac_compiler_resolve_const(wac_compiler_t *compiler, wac_token_t *name, wac_value_t *value) {
+	size_t i, j;
+	for (; compiler; compiler = compiler->prev) {
+		for (i = compiler->locals_usize - 1; i != INVALID_SIZE; --i) {
+			if (wac_parser_idEqual(name, &compiler->locals[i].name)) break;
+		}
+		for (j = compiler->consts_usize - 1; j != INVALID_SIZE; --j) {
+			if (wac_parser_idEqual(name, &compiler->consts[j].name)) break;
+		}
+		if (j != INVALID_SIZE && (i == INVALID_SIZE || compiler->consts[j].depth > compiler->locals[i].depth)) {
+			*value = compiler->consts[j].value;
+			return true;
+		}
+		if (i != INVALID_SIZE) return false;
+	}
+	return false;
+}
+
 static uint32_t wac_compiler_upval_add(wac_state_t *state, wac_compiler_t *compiler, uint32_t index, bool isLocal) {
 	size_t i, upvals_usize = compiler->fun->upvals_usize;
 	wac_upval_t *upval;
@@ -582,12 +1208,40 @@ static uint32_t wac_compiler_resolve_upval(wac_state_t *state, wac_compiler_t *c
 	return INVALID_UINT32;
 }
 
+//marks the local at the end of the upval chain as assigned
+static void wac_compiler_upval_assign(wac_compiler_t *compiler, uint32_t upval) {
+	while (!compiler->upvals[upval].isLocal) {
+		upval = compiler->upvals[upval].index;
+		compiler = compiler->prev;
+	}
+	compiler->prev->locals[compiler->upvals[upval].index].isAssigned = true;
+}
+
+//records the upval descriptor about to be emitted, which captures locals[local]
+//the closure is in the top slot, it gets its value only after WAC_OP_CLOSURE, so it can't be copied
+static void wac_compiler_capture_add(wac_state_t *state, uint32_t local) {
+	wac_compiler_t *compiler = state->compiler;
+	if (local + 1 >= compiler->depth) {
+		compiler->locals[local].isCapturedEarly = true;
+		return;
+	}
+	if (compiler->captures_asize <= compiler->captures_usize) {
+		size_t oldSize = compiler->captures_asize;
+		compiler->captures_asize = oldSize ? oldSize * WAC_ARRAY_GROW_MUL : WAC_ARRAY_DEFAULT_SIZE;
+		compiler->captures = WAC_ARRAY_GROW(state, wac_capture_t, compiler->captures, oldSize, compiler->captures_asize);
+	}
+	compiler->captures[compiler->captures_usize].local = local;
+	compiler->captures[compiler->captures_usize++].address = compiler->fun->page.usize;
+}
+
 static void wac_parser_decl_local(wac_state_t *state) {
+	wac_token_t *name = &state->parser.prev;
+
+	if (wac_compiler_const_inScope(state, name)) wac_parser_error(&state->parser, "Already a constant with this name in this scope");
+
 	//if global -> return
 	if (state->compiler->scopeDepth == 0) return;
 
-	wac_token_t *name = &state->parser.prev;
-
 	size_t i;
 	wac_local_t *local;
 	for (i = state->compiler->locals_usize - 1; i != INVALID_SIZE; --i) {
@@ -608,7 +1262,7 @@ static uint32_t wac_parser_var_parse(wac_state_t *state, const char *msg) {
 	wac_parser_decl_local(state);
 	if (state->compiler->scopeDepth > 0) return 0;
 
-	return wac_parser_const_id(state, &state->parser.prev);
+	return wac_parser_global_id(state, &state->parser.prev);
 }
 
 static void wac_compiler_local_mark(wac_compiler_t *compiler) {
@@ -622,16 +1276,17 @@ static void wac_parser_var_define(wac_state_t *state, uint32_t var) {
 		wac_compiler_local_mark(state->compiler);
 		return;
 	}
-	wac_compiler_emit_5bytes(state, WAC_OP_DEFINE_GLOBAL, var);
+	wac_compiler_emit_arg(state, WAC_OP_DEFINE_GLOBAL, var);
 }
 
 static void wac_parser_decl_var(wac_state_t *state) {
 	uint32_t var = wac_parser_var_parse(state, "Expected variable name");
 
 	if (wac_parser_match(state, WAC_TOKEN_EQUAL)) {
+		if (wac_parser_decl_scalar(state)) return;
 		wac_parser_expr(state);
 	} else {
-		wac_compiler_emit_byte(state, WAC_OP_NULL);
+		wac_compiler_emit_op(state, WAC_OP_NULL);
 	}
 
 	wac_parser_eat(state, WAC_TOKEN_SEMICOLON, "Expected ';' after variable declaration");
@@ -652,6 +1307,8 @@ static void wac_parser_function(wac_state_t *state, wac_fun_type_t type) {
 	if (!wac_parser_check(&state->parser, WAC_TOKEN_RPAREN)) {
 		do {
 			++state->compiler->fun->arity;
+			++state->compiler->depth;
+			state->compiler->fun->maxStack = state->compiler->depth;
 			wac_parser_var_define(state, wac_parser_var_parse(state, "Expected parameter name"));
 		} while (wac_parser_match(state, WAC_TOKEN_COMMA));
 	}
@@ -661,66 +1318,631 @@ static void wac_parser_function(wac_state_t *state, wac_fun_type_t type) {
 	wac_parser_statement_block(state);
 
 	fun = wac_compiler_end(state);
+
+	//with nothing to capture all runs of the declaration can share one closure, made here
+	if (!fun->upvals_usize) {
+		wac_vm_push(&state->vm, WAC_VAL_OBJ(fun));
+		wac_compiler_emit_const(state, WAC_OP_CONST, WAC_VAL_OBJ(wac_obj_closure_init(state, fun)));
+		wac_vm_pop(&state->vm);
+		WAC_ARRAY_FREE(state, wac_upval_t, compiler.upvals, compiler.upvals_asize);
+		return;
+	}
+
 	wac_compiler_emit_const(state, WAC_OP_CLOSURE, WAC_VAL_OBJ(fun));
 
 	for (i = 0; i < fun->upvals_usize; ++i) {
-		wac_compiler_emit_5bytes(state, compiler.upvals[i].isLocal ? 1 : 0, compiler.upvals[i].index);
+		uint8_t flags = compiler.upvals[i].isLocal ? WAC_UPVAL_LOCAL : 0;
+		if (compiler.upvals[i].isLocal) wac_compiler_capture_add(state, compiler.upvals[i].index);
+		if (compiler.upvals[i].index <= UINT8_MAX) {
+			wac_compiler_emit_2bytes(state, flags, (uint8_t)compiler.upvals[i].index);
+		} else {
+			wac_compiler_emit_byte(state, flags | WAC_UPVAL_LONG);
+			wac_page_write_4bytes(state, &state->compiler->fun->page, compiler.upvals[i].index, state->parser.prev.line);
+		}
 	}
 
 	WAC_ARRAY_FREE(state, wac_upval_t, compiler.upvals, compiler.upvals_asize);
 }
 
+//copies code of callee up to its first RET, with its slots moved up by base
+//fused, typed and quickened ops go back to the generic ones, coz the caller runs its passes again
+//without emit it only checks that the code is short and has no jumps, upvals or long operands
+static bool wac_compiler_inline_body(wac_state_t *state, wac_obj_fun_t *callee, size_t base, bool emit) {
+	wac_page_t *from = &callee->page, *page = &state->compiler->fun->page;
+	size_t address, start = page->usize, line;
+	uint8_t *code;
+
+	for (address = 0; address < from->usize && address <= WAC_INLINE_MAX_SIZE; address += wac_page_inst_size(from, address)) {
+		code = from->code + address;
+		if (code[0] == WAC_OP_RET) return true;
+		switch (code[0]) {
+			case WAC_OP_CONST:
+				if (emit) wac_compiler_emit_const(state, WAC_OP_CONST, from->consts.values[code[1]]);
+				break;
+			case WAC_OP_NULL:
+			case WAC_OP_TRUE:
+			case WAC_OP_FALSE:
+			case WAC_OP_POP:
+			case WAC_OP_NOT:
+			case WAC_OP_EQUAL:
+			case WAC_OP_GREATER:
+			case WAC_OP_LESS:
+			case WAC_OP_NEG:
+			case WAC_OP_ADD:
+			case WAC_OP_SUB:
+			case WAC_OP_MUL:
+			case WAC_OP_DIV:
+			case WAC_OP_MOD:
+			case WAC_OP_IDIV:
+			case WAC_OP_BAND:
+			case WAC_OP_BOR:
+			case WAC_OP_BXOR:
+			case WAC_OP_SHL:
+			case WAC_OP_SHR:
+			case WAC_OP_BNOT:
+				if (emit) wac_compiler_emit_op(state, code[0]);
+				break;
+			case WAC_OP_POPN:
+			case WAC_OP_GET_GLOBAL:
+			case WAC_OP_SET_GLOBAL:
+				if (emit) wac_compiler_emit_arg(state, code[0], code[1]);
+				break;
+			case WAC_OP_GET_LOCAL:
+			case WAC_OP_SET_LOCAL:
+				if (emit) wac_compiler_emit_arg(state, code[0], base + code[1]);
+				break;
+			case WAC_OP_SET_LOCAL_POP:
+				if (!emit) break;
+				wac_compiler_emit_arg(state, WAC_OP_SET_LOCAL, base + code[1]);
+				wac_compiler_emit_op(state, WAC_OP_POP);
+				break;
+			case WAC_OP_GET_LOCAL_2:
+				if (!emit) break;
+				wac_compiler_emit_arg(state, WAC_OP_GET_LOCAL, base + code[1]);
+				wac_compiler_emit_arg(state, WAC_OP_GET_LOCAL, base + code[2]);
+				break;
+			case WAC_OP_GET_LOCAL_CONST:
+				if (!emit) break;
+				wac_compiler_emit_arg(state, WAC_OP_GET_LOCAL, base + code[1]);
+				wac_compiler_emit_const(state, WAC_OP_CONST, from->consts.values[code[2]]);
+				break;
+			case WAC_OP_GET_LOCAL_PROPERTY:
+				if (!emit) break;
+				wac_compiler_emit_arg(state, WAC_OP_GET_LOCAL, base + code[1]);
+				wac_compiler_emit_arg2(state, WAC_OP_GET_PROPERTY_CONST, wac_compiler_addConst(state, from->consts.values[code[2]]), wac_page_addPropertyCache(state, page));
+				break;
+			case WAC_OP_GET_PROPERTY_CONST:
+			case WAC_OP_SET_PROPERTY_CONST:
+				if (emit) wac_compiler_emit_arg2(state, code[0], wac_compiler_addConst(state, from->consts.values[code[1]]), wac_page_addPropertyCache(state, page));
+				break;
+			case WAC_OP_GET_PROPERTY:
+			case WAC_OP_SET_PROPERTY:
+				if (emit) wac_compiler_emit_arg(state, code[0], wac_page_addPropertyCache(state, page));
+				break;
+			case WAC_OP_NOT_EQUAL:
+			case WAC_OP_GREATER_EQUAL:
+			case WAC_OP_LESS_EQUAL:
+				if (!emit) break;
+				wac_compiler_emit_op(state, code[0] == WAC_OP_NOT_EQUAL ? WAC_OP_EQUAL : code[0] == WAC_OP_GREATER_EQUAL ? WAC_OP_LESS : WAC_OP_GREATER);
+				wac_compiler_emit_op(state, WAC_OP_NOT);
+				break;
+			case WAC_OP_ADD_II:
+			case WAC_OP_ADD_DD:
+			case WAC_OP_ADD_NUM_NUM:
+			case WAC_OP_ADD_INT_INT:
+				if (emit) wac_compiler_emit_op(state, WAC_OP_ADD);
+				break;
+			case WAC_OP_SUB_II:
+			case WAC_OP_SUB_DD:
+				if (emit) wac_compiler_emit_op(state, WAC_OP_SUB);
+				break;
+			case WAC_OP_MUL_II:
+			case WAC_OP_MUL_DD:
+				if (emit) wac_compiler_emit_op(state, WAC_OP_MUL);
+				break;
+			case WAC_OP_DIV_DD:
+				if (emit) wac_compiler_emit_op(state, WAC_OP_DIV);
+				break;
+			case WAC_OP_LESS_NUM:
+			case WAC_OP_LESS_INT:
+				if (emit) wac_compiler_emit_op(state, WAC_OP_LESS);
+				break;
+			case WAC_OP_CALL:
+			case WAC_OP_TAIL_CALL:
+			case WAC_OP_CALL_CLOSURE_EXACT_ARITY:
+				if (emit) wac_compiler_emit_arg(state, WAC_OP_CALL, code[1]);
+				break;
+			case WAC_OP_INVOKE:
+				if (emit) wac_compiler_emit_arg2(state, WAC_OP_INVOKE, wac_compiler_addConst(state, from->consts.values[code[1]]), code[2]);
+				break;
+			default:
+				return false;
+		}
+
+		//copied code gets the line it came from, errors show it as a frame of callee
+		if (emit) {
+			line = wac_page_addInlined(state, page, callee, from->lines[address], state->parser.prev.line);
+			for (; start < page->usize; ++start) page->lines[start] = line;
+		}
+	}
+	return false;
+}
+
+//body of closure in place of the call, callee and argc args are on the stack from base
+//with guard, CALL_INLINE checks that the callee is still closure and calls it when it is not
+static bool wac_compiler_inline(wac_state_t *state, wac_obj_closure_t *closure, size_t base, uint32_t argc, bool guard) {
+	wac_compiler_t *compiler = state->compiler;
+	wac_page_t *page = &compiler->fun->page;
+	size_t jump = INVALID_SIZE, offset;
+	uint32_t k;
+
+	if (closure->fun->arity != argc || !wac_compiler_inline_body(state, closure->fun, base, false)) return false;
+	if (guard) {
+		if (argc > UINT8_MAX || page->consts.usize > UINT8_MAX) return false;
+		k = wac_compiler_addConst(state, WAC_VAL_OBJ(closure));
+		wac_compiler_emit_op(state, WAC_OP_CALL_INLINE);
+		wac_compiler_emit_2bytes(state, (uint8_t)k, (uint8_t)argc);
+		wac_page_write_2bytes(state, page, 0, state->parser.prev.line);
+		jump = page->usize - 2;
+	}
+
+	wac_compiler_inline_body(state, closure->fun, base, true);
+	wac_compiler_emit_arg(state, WAC_OP_RET_INLINE, compiler->depth - base - 1);
+
+	if (guard) {
+		offset = page->usize - jump - 2;
+		page->code[jump    ] = (offset & 0xFF00) >> 8;
+		page->code[jump + 1] = (offset & 0x00FF);
+		compiler->lastLabel = page->usize;
+	}
+	compiler->lastInst = compiler->prevInst = INVALID_SIZE;
+	return true;
+}
+
+//closure of the last top level declaration of the global, if it can be inlined
+//with init, init of the class in the global instead
+static wac_obj_closure_t* wac_compiler_inline_global(wac_state_t *state, uint32_t global, bool init) {
+	wac_compiler_t *compiler = state->compiler;
+	size_t i;
+
+	while (compiler->prev) compiler = compiler->prev;
+	for (i = 0; i < compiler->inlines_usize; ++i) {
+		if (compiler->inlines[i].global == global) return compiler->inlines[i].init == init ? compiler->inlines[i].closure : NULL;
+	}
+	return NULL;
+}
+
+//top level declaration of the global replaces the entry, NULL closure drops it
+static void wac_compiler_inline_set(wac_state_t *state, uint32_t global, wac_obj_closure_t *closure, bool init) {
+	wac_compiler_t *compiler = state->compiler;
+	size_t i;
+
+	for (i = 0; i < compiler->inlines_usize; ++i) {
+		if (compiler->inlines[i].global != global) continue;
+		if (closure) {
+			compiler->inlines[i].closure = closure;
+			compiler->inlines[i].init = init;
+		} else {
+			compiler->inlines[i] = compiler->inlines[--compiler->inlines_usize];
+		}
+		return;
+	}
+	if (!closure) return;
+
+	if (compiler->inlines_asize <= compiler->inlines_usize) {
+		size_t oldSize = compiler->inlines_asize;
+		compiler->inlines_asize = oldSize ? oldSize * WAC_ARRAY_GROW_MUL : WAC_ARRAY_DEFAULT_SIZE;
+		compiler->inlines = WAC_ARRAY_GROW(state, wac_inline_t, compiler->inlines, oldSize, compiler->inlines_asize);
+	}
+	compiler->inlines[compiler->inlines_usize].global = global;
+	compiler->inlines[compiler->inlines_usize].closure = closure;
+	compiler->inlines[compiler->inlines_usize++].init = init;
+}
+
+//top level function declaration, its closure is the constant loaded by the last instruction
+static void wac_compiler_inline_record(wac_state_t *state, uint32_t global) {
+	wac_compiler_t *compiler = state->compiler;
+	wac_obj_closure_t *closure = NULL;
+	wac_value_t value;
+
+	if (compiler->lastInst != INVALID_SIZE && wac_compiler_constLoad(&compiler->fun->page, compiler->lastInst, &value)
+		&& WAC_OBJ_IS_CLOSURE(value) && wac_compiler_inline_body(state, WAC_OBJ_AS_CLOSURE(value)->fun, 0, false)
+	) {
+		closure = WAC_OBJ_AS_CLOSURE(value);
+	}
+	wac_compiler_inline_set(state, global, closure, false);
+}
+
+//value init has in slot, or value when slot is INVALID_UINT32, false when there is no room
+static bool wac_compiler_scalar_push(wac_scalar_field_t *stack, size_t *usize, uint32_t slot, wac_value_t value) {
+	if (*usize == 3) return false;
+	stack[*usize].param = slot;
+	stack[(*usize)++].value = value;
+	return true;
+}
+
+//fields set by init when all it does is this.name = param or constant, INVALID_SIZE otherwise
+//values on the stack of init are followed by their slots, this is 0 and params 1 to arity
+static size_t wac_compiler_scalar_fields(wac_obj_fun_t *init, wac_scalar_field_t *fields) {
+	wac_page_t *page = &init->page;
+	wac_scalar_field_t stack[3];
+	size_t stack_usize = 0, fields_usize = 0, address, i;
+	wac_obj_string_t *name;
+	wac_value_t value = WAC_VAL_NULL;
+	uint8_t *code;
+	bool ok;
+
+	for (address = 0; address < page->usize; address += wac_page_inst_size(page, address)) {
+		code = page->code + address;
+		switch (code[0]) {
+			case WAC_OP_GET_LOCAL:
+				ok = code[1] <= init->arity && wac_compiler_scalar_push(stack, &stack_usize, code[1], value);
+				break;
+			case WAC_OP_GET_LOCAL_2:
+				ok = code[1] <= init->arity && code[2] <= init->arity
+					&& wac_compiler_scalar_push(stack, &stack_usize, code[1], value)
+					&& wac_compiler_scalar_push(stack, &stack_usize, code[2], value);
+				break;
+			case WAC_OP_GET_LOCAL_CONST:
+				ok = code[1] <= init->arity
+					&& wac_compiler_scalar_push(stack, &stack_usize, code[1], value)
+					&& wac_compiler_scalar_push(stack, &stack_usize, INVALID_UINT32, page->consts.values[code[2]]);
+				break;
+			case WAC_OP_SET_PROPERTY_CONST:
+				//this.name = value, where value is not this
+				if (stack_usize < 2 || stack[stack_usize - 2].param != 0 || stack[stack_usize - 1].param == 0) return INVALID_SIZE;
+				name = WAC_OBJ_AS_STRING(page->consts.values[code[1]]);
+				for (i = 0; i < fields_usize && fields[i].name != name; ++i);
+				if (i == WAC_SCALAR_MAX_FIELDS) return INVALID_SIZE;
+				if (i == fields_usize) ++fields_usize;
+				fields[i] = stack[--stack_usize];
+				fields[i].name = name;
+				stack[stack_usize - 1] = fields[i];
+				ok = true;
+				break;
+			case WAC_OP_POP:
+				if (!stack_usize) return INVALID_SIZE;
+				--stack_usize;
+				ok = true;
+				break;
+			case WAC_OP_RET:
+				return stack_usize == 1 && stack[0].param == 0 ? fields_usize : INVALID_SIZE;
+			default:
+				ok = wac_compiler_constLoad(page, address, &value) && wac_compiler_scalar_push(stack, &stack_usize, INVALID_UINT32, value);
+				break;
+		}
+		if (!ok) return INVALID_SIZE;
+	}
+	return INVALID_SIZE;
+}
 
 static void wac_parser_decl_fun(wac_state_t *state) {
 	uint32_t var = wac_parser_var_parse(state, "Expected function name");
 	wac_compiler_local_mark(state->compiler);
 	wac_parser_function(state, WAC_FUN_TYPE_FUN);
+	if (state->compiler->scopeDepth == 0 && !state->parser.error && state->optLevel >= 2) wac_compiler_inline_record(state, var);
 	wac_parser_var_define(state, var);
 }
 
 static void wac_parser_var_named(wac_state_t *state, bool canAssign, wac_token_t name);
 
-static void wac_parser_method(wac_state_t *state) {
+//init is set to the closure of init, when it is made at compile time
+static void wac_parser_method(wac_state_t *state, wac_obj_closure_t **init) {
 	wac_parser_eat(state, WAC_TOKEN_ID, "Expected method name");
 	uint32_t name = wac_parser_const_id(state, &state->parser.prev);
+	wac_value_t value;
 
 	wac_fun_type_t type = WAC_FUN_TYPE_METHOD;
 	if (state->parser.prev.len == 4 && !memcmp(state->parser.prev.start, "init", 4)) {
 		type = WAC_FUN_TYPE_INIT;
 	}
 	wac_parser_function(state, type);
+	if (type == WAC_FUN_TYPE_INIT) {
+		*init = NULL;
+		if (wac_compiler_constLoad(&state->compiler->fun->page, state->compiler->lastInst, &value) && WAC_OBJ_IS_CLOSURE(value)) *init = WAC_OBJ_AS_CLOSURE(value);
+	}
 
-	wac_compiler_emit_5bytes(state, WAC_OP_METHOD, name);
+	wac_compiler_emit_arg(state, WAC_OP_METHOD, name);
 }
 
 static void wac_parser_decl_class(wac_state_t *state) {
 	wac_parser_eat(state, WAC_TOKEN_ID, "Expected class name");
 	wac_token_t nameToken = state->parser.prev;
 	uint32_t nameConst = wac_parser_const_id(state, &state->parser.prev);
+	uint32_t global = state->compiler->scopeDepth > 0 ? 0 : wac_parser_global_id(state, &nameToken);
+	wac_scalar_field_t fields[WAC_SCALAR_MAX_FIELDS];
+	wac_obj_closure_t *init = NULL;
 	wac_parser_decl_local(state);
-	wac_compiler_emit_5bytes(state, WAC_OP_CLASS, nameConst);
-	wac_parser_var_define(state, nameConst);
+	wac_compiler_emit_arg(state, WAC_OP_CLASS, nameConst);
+	wac_parser_var_define(state, global);
 
 	wac_class_compiler_t classCompiler;
 	classCompiler.prev = state->classCompiler;
+	classCompiler.hasSuper = false;
 	state->classCompiler = &classCompiler;
 
+	if (wac_parser_match(state, WAC_TOKEN_LESS)) {
+		wac_parser_eat(state, WAC_TOKEN_ID, "Expected superclass name");
+		wac_parser_variable(state, false);
+		if (wac_parser_idEqual(&nameToken, &state->parser.prev)) {
+			wac_parser_error(&state->parser, "A class can't inherit from itself");
+		}
+
+		//methods reach the superclass through local super
+		wac_compiler_scope_begin(state);
+		wac_compiler_local_add(state, wac_parser_token_synth("super"));
+		wac_parser_var_define(state, 0);
+
+		wac_parser_var_named(state, false, nameToken);
+		wac_compiler_emit_op(state, WAC_OP_INHERIT);
+		classCompiler.hasSuper = true;
+	}
+
 	wac_parser_var_named(state, false, nameToken);
 
 	wac_parser_eat(state, WAC_TOKEN_LCURLY, "Expected '{' before class body");
 
 	while (!wac_parser_check(&state->parser, WAC_TOKEN_RCURLY) && !wac_parser_check(&state->parser, WAC_TOKEN_EOF)) {
-		wac_parser_method(state);
+		wac_parser_method(state, &init);
 	}
 
 	wac_parser_eat(state, WAC_TOKEN_RCURLY, "Expected '}' after class body");
-	wac_compiler_emit_byte(state, WAC_OP_POP);
+	wac_compiler_emit_op(state, WAC_OP_POP);
+	if (classCompiler.hasSuper) wac_compiler_scope_end(state);
 	state->classCompiler = state->classCompiler->prev;
+
+	//instances of it made in locals can be kept in slots, see wac_parser_decl_scalar
+	if (state->compiler->scopeDepth == 0 && !state->parser.error && state->optLevel >= 2) {
+		if (classCompiler.hasSuper || !init || wac_compiler_scalar_fields(init->fun, fields) == INVALID_SIZE) init = NULL;
+		wac_compiler_inline_set(state, global, init, true);
+	}
+}
+
+//const name = expr; or const fun name(...) {...} at top level
+//value has to be known at compile time, uses of name are replaced by it
+static void wac_parser_decl_const(wac_state_t *state) {
+	wac_compiler_t *compiler = state->compiler;
+	bool isFun = wac_parser_match(state, WAC_TOKEN_FUN);
+	wac_value_t value = WAC_VAL_NULL;
+	wac_token_t name;
+	size_t start, i;
+
+	wac_parser_eat(state, WAC_TOKEN_ID, "Expected constant name");
+	name = state->parser.prev;
+	if (wac_compiler_const_inScope(state, &name)) wac_parser_error(&state->parser, "Already a constant with this name in this scope");
+	for (i = compiler->locals_usize - 1; i != INVALID_SIZE; --i) {
+		if (compiler->locals[i].depth != INVALID_UINT && compiler->locals[i].depth < compiler->scopeDepth) break;
+		if (wac_parser_idEqual(&name, &compiler->locals[i].name)) wac_parser_error(&state->parser, "Already a variable with this name in this scope");
+	}
+	if (isFun && compiler->scopeDepth > 0) wac_parser_error(&state->parser, "Const functions have to be at top level");
+
+	start = compiler->fun->page.usize;
+	if (isFun) {
+		wac_parser_function(state, WAC_FUN_TYPE_FUN);
+	} else {
+		wac_parser_eat(state, WAC_TOKEN_EQUAL, "Expected '=' after constant name");
+		compiler->fold = true;
+		wac_parser_expr(state);
+		compiler->fold = false;
+		wac_parser_eat(state, WAC_TOKEN_SEMICOLON, "Expected ';' after constant declaration");
+	}
+
+	if (!wac_compiler_constExpr(state, start, &value)) {
+		wac_parser_error(&state->parser, isFun ? "Const function can't capture variables" : "Constant value has to be known at compile time");
+		return;
+	}
+
+	if (compiler->consts_asize <= compiler->consts_usize) {
+		size_t oldSize = compiler->consts_asize;
+		compiler->consts_asize = oldSize ? oldSize * WAC_ARRAY_GROW_MUL : WAC_ARRAY_DEFAULT_SIZE;
+		compiler->consts = WAC_ARRAY_GROW(state, wac_const_t, compiler->consts, oldSize, compiler->consts_asize);
+	}
+	compiler->consts[compiler->consts_usize].name = name;
+	compiler->consts[compiler->consts_usize].depth = compiler->scopeDepth;
+	compiler->consts[compiler->consts_usize++].value = value;
+
+	//top level ones are globals too, for code compiled before them and the repl
+	if (compiler->scopeDepth == 0) {
+		wac_compiler_emit_arg(state, WAC_OP_DEFINE_GLOBAL, wac_parser_global_id(state, &name));
+	} else {
+		compiler->fun->page.usize = start;
+		--compiler->depth;
+		compiler->lastInst = compiler->prevInst = INVALID_SIZE;
+	}
+}
+
+//field of fields named like token, NULL when there is none
+static wac_scalar_field_t* wac_compiler_scalar_field(wac_scalar_field_t *fields, size_t fields_usize, wac_token_t *token) {
+	size_t i;
+	if (token->type != WAC_TOKEN_ID) return NULL;
+	for (i = 0; i < fields_usize; ++i) {
+		if (fields[i].name->len == token->len && !memcmp(fields[i].name->buf, token->start, token->len)) return &fields[i];
+	}
+	return NULL;
+}
+
+//looks ahead from Class in var name = Class(args); for what the rest of the block does with name
+//it can only be read or assigned as name.field with the fields init sets, so the instance never escapes
+//functions and classes in the block could capture it, so they are not allowed either
+static bool wac_parser_scalar_scan(wac_state_t *state, wac_token_t *name, wac_scalar_field_t *fields, size_t fields_usize) {
+	wac_scanner_t scanner = state->scanner;
+	wac_token_t prev = state->parser.curr, token;
+	size_t depth;
+	bool field = false;
+
+	if (wac_scanner_token_next(&scanner).type != WAC_TOKEN_LPAREN) return false;
+	for (depth = 1; depth > 0; ) {
+		token = wac_scanner_token_next(&scanner);
+		if (token.type == WAC_TOKEN_LPAREN) {
+			++depth;
+		} else if (token.type == WAC_TOKEN_RPAREN) {
+			--depth;
+		} else if (token.type == WAC_TOKEN_EOF || token.type == WAC_TOKEN_ERROR || token.type == WAC_TOKEN_FUN || token.type == WAC_TOKEN_CLASS || wac_parser_idEqual(&token, name)) {
+			return false;
+		}
+	}
+	if (wac_scanner_token_next(&scanner).type != WAC_TOKEN_SEMICOLON) return false;
+
+	for (depth = 0; ; prev = token) {
+		token = wac_scanner_token_next(&scanner);
+		//name.field(...) would call a method
+		if (field && token.type == WAC_TOKEN_LPAREN) return false;
+		field = false;
+		switch (token.type) {
+			case WAC_TOKEN_LCURLY:
+				++depth;
+				break;
+			case WAC_TOKEN_RCURLY:
+				if (!depth) return true;
+				--depth;
+				break;
+			case WAC_TOKEN_EOF:
+			case WAC_TOKEN_ERROR:
+			case WAC_TOKEN_FUN:
+			case WAC_TOKEN_CLASS:
+				return false;
+			case WAC_TOKEN_ID:
+				if (prev.type == WAC_TOKEN_DOT || !wac_parser_idEqual(&token, name)) break;
+				if (wac_scanner_token_next(&scanner).type != WAC_TOKEN_DOT) return false;
+				token = wac_scanner_token_next(&scanner);
+				if (!wac_compiler_scalar_field(fields, fields_usize, &token)) return false;
+				field = true;
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+//initializer of local declared by var, when it is Class(args) and the instance can be kept in slots
+//the local holds the class, args stay in slots after it and fields set to constants, or to a param
+//other fields use too, get slots of their own, CALL_INLINE makes the instance when the global is
+//not the class any more, then the slots after it are only nulls and GET_SCALAR uses the instance
+//false when nothing was parsed, otherwise the whole declaration is
+static bool wac_parser_decl_scalar(wac_state_t *state) {
+	wac_compiler_t *compiler = state->compiler, *outer;
+	wac_page_t *page = &compiler->fun->page;
+	wac_scalar_field_t *field;
+	wac_obj_closure_t *init;
+	wac_scalar_t scalar;
+	size_t base, jump, skip, offset, pushed = 0, uses, i, j;
+	uint32_t argc, k;
+
+	if (compiler->scopeDepth == 0 || state->optLevel < 2 || state->parser.error || state->parser.curr.type != WAC_TOKEN_ID) return false;
+
+	//Class has to be a global, not a local, upval or const of any function around
+	for (outer = compiler; outer; outer = outer->prev) {
+		for (i = 0; i < outer->locals_usize; ++i) {
+			if (wac_parser_idEqual(&state->parser.curr, &outer->locals[i].name)) return false;
+		}
+		for (i = 0; i < outer->consts_usize; ++i) {
+			if (wac_parser_idEqual(&state->parser.curr, &outer->consts[i].name)) return false;
+		}
+	}
+	init = wac_compiler_inline_global(state, wac_parser_global_id(state, &state->parser.curr), true);
+	if (!init) return false;
+	scalar.fields_usize = wac_compiler_scalar_fields(init->fun, scalar.fields);
+	if (scalar.fields_usize == INVALID_SIZE || !wac_parser_scalar_scan(state, &compiler->locals[compiler->locals_usize - 1].name, scalar.fields, scalar.fields_usize)) return false;
+
+	wac_parser_advance(state);
+	wac_parser_variable(state, false);
+	base = compiler->depth - 1;
+	wac_parser_eat(state, WAC_TOKEN_LPAREN, "Expected '(' after class name");
+	argc = wac_parser_argc(state);
+
+	if (state->parser.error || argc != init->fun->arity || argc > UINT8_MAX || page->consts.usize > UINT8_MAX || base + 1 != compiler->locals_usize) {
+		wac_compiler_emit_arg(state, WAC_OP_CALL, argc);
+		wac_parser_eat(state, WAC_TOKEN_SEMICOLON, "Expected ';' after variable declaration");
+		wac_parser_var_define(state, 0);
+		return true;
+	}
+
+	k = wac_compiler_addConst(state, WAC_VAL_OBJ(init));
+	wac_compiler_emit_op(state, WAC_OP_CALL_INLINE);
+	wac_compiler_emit_2bytes(state, (uint8_t)k, (uint8_t)argc);
+	wac_page_write_2bytes(state, page, 0, state->parser.prev.line);
+	jump = page->usize - 2;
+
+	for (i = 0; i < scalar.fields_usize; ++i) {
+		field = &scalar.fields[i];
+		for (j = 0, uses = 0; j < scalar.fields_usize; ++j) {
+			if (scalar.fields[j].param == field->param) ++uses;
+		}
+		if (field->param != INVALID_UINT32 && uses == 1) {
+			field->slot = (uint32_t)(base + field->param);
+			continue;
+		}
+		field->slot = (uint32_t)compiler->depth;
+		if (field->param != INVALID_UINT32) {
+			wac_compiler_emit_arg(state, WAC_OP_GET_LOCAL, (uint32_t)(base + field->param));
+		} else {
+			wac_compiler_emit_value(state, field->value);
+		}
+		++pushed;
+	}
+	skip = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FORW_LONG);
+
+	//the call left the instance in place of the class
+	offset = page->usize - jump - 2;
+	page->code[jump    ] = (offset & 0xFF00) >> 8;
+	page->code[jump + 1] = (offset & 0x00FF);
+	compiler->lastLabel = page->usize;
+	compiler->depth = base + 1;
+	for (i = 0; i < argc + pushed; ++i) wac_compiler_emit_op(state, WAC_OP_NULL);
+	wac_compiler_patchJmp(state, skip);
+	compiler->lastInst = compiler->prevInst = INVALID_SIZE;
+
+	wac_parser_eat(state, WAC_TOKEN_SEMICOLON, "Expected ';' after variable declaration");
+	wac_parser_var_define(state, 0);
+	for (i = 0; i < argc + pushed; ++i) {
+		wac_compiler_local_add(state, wac_parser_token_synth(""));
+		wac_compiler_local_mark(compiler);
+	}
+
+	if (compiler->scalars_asize <= compiler->scalars_usize) {
+		size_t oldSize = compiler->scalars_asize;
+		compiler->scalars_asize = oldSize ? oldSize * WAC_ARRAY_GROW_MUL : WAC_ARRAY_DEFAULT_SIZE;
+		compiler->scalars = WAC_ARRAY_GROW(state, wac_scalar_t, compiler->scalars, oldSize, compiler->scalars_asize);
+	}
+	scalar.local = (uint32_t)base;
+	compiler->scalars[compiler->scalars_usize++] = scalar;
+	return true;
+}
+
+//slot of field name of the local kept in slots that the last instruction loads, which is dropped then
+static bool wac_compiler_scalar_load(wac_state_t *state, wac_token_t *name, uint32_t *local, uint32_t *slot) {
+	wac_compiler_t *compiler = state->compiler;
+	wac_page_t *page = &compiler->fun->page;
+	size_t last = compiler->lastInst, i;
+	wac_scalar_field_t *field;
+
+	if (!compiler->scalars_usize || last == INVALID_SIZE || compiler->lastLabel > last || last + wac_page_inst_size(page, last) != page->usize) return false;
+	if (page->code[last] == WAC_OP_GET_LOCAL) {
+		*local = page->code[last + 1];
+	} else if (page->code[last] == WAC_OP_GET_LOCAL_LONG) {
+		*local = ((uint32_t)page->code[last + 1] << 24) | (page->code[last + 2] << 16) | (page->code[last + 3] << 8) | page->code[last + 4];
+	} else {
+		return false;
+	}
+
+	for (i = 0; i < compiler->scalars_usize; ++i) {
+		if (compiler->scalars[i].local != *local) continue;
+		field = wac_compiler_scalar_field(compiler->scalars[i].fields, compiler->scalars[i].fields_usize, name);
+		if (!field) return false;
+		*slot = field->slot;
+		page->usize = last;
+		--compiler->depth;
+		compiler->lastInst = compiler->prevInst = INVALID_SIZE;
+		return true;
+	}
+	return false;
 }
 
 static void wac_parser_decl(wac_state_t *state) {
 	if (wac_parser_match(state, WAC_TOKEN_VAR)) {
 		wac_parser_decl_var(state);
+	} else if (wac_parser_match(state, WAC_TOKEN_CONST)) {
+		wac_parser_decl_const(state);
 	} else if (wac_parser_match(state, WAC_TOKEN_FUN)) {
 		wac_parser_decl_fun(state);
 	} else if (wac_parser_match(state, WAC_TOKEN_CLASS)) {
@@ -732,9 +1954,26 @@ static void wac_parser_decl(wac_state_t *state) {
 	if (state->parser.panic) wac_parser_sync(state);
 }
 
+static void wac_parser_const_named(wac_state_t *state, bool canAssign, wac_value_t value) {
+	if (canAssign && wac_parser_match(state, WAC_TOKEN_EQUAL)) {
+		wac_parser_error(&state->parser, "Can't assign to a constant");
+		wac_parser_expr(state);
+		return;
+	}
+	wac_compiler_emit_value(state, value);
+}
+
 static void wac_parser_var_named(wac_state_t *state, bool canAssign, wac_token_t name) {
 	uint8_t get, set;
-	uint32_t arg = wac_compiler_resolve_local(&state->parser, state->compiler, &name);
+	uint32_t arg;
+	wac_value_t value;
+
+	if (wac_compiler_resolve_const(state->compiler, &name, &value)) {
+		wac_parser_const_named(state, canAssign, value);
+		return;
+	}
+
+	arg = wac_compiler_resolve_local(&state->parser, state->compiler, &name);
 
 	if (arg != INVALID_UINT32) {
 		//local
@@ -743,18 +1982,26 @@ static void wac_parser_var_named(wac_state_t *state, bool canAssign, wac_token_t
 	} else if ((arg = wac_compiler_resolve_upval(state, state->compiler, &name)) != INVALID_UINT32) {
 		get = WAC_OP_GET_UPVAL;
 		set = WAC_OP_SET_UPVAL;
+	} else if (wac_compiler_const_global(state, &name, &value)) {
+		wac_parser_const_named(state, canAssign, value);
+		return;
 	} else {
 		//global
-		arg = wac_parser_const_id(state, &name);
+		arg = wac_parser_global_id(state, &name);
 		get = WAC_OP_GET_GLOBAL;
 		set = WAC_OP_SET_GLOBAL;
 	}
 
 	if (canAssign && wac_parser_match(state, WAC_TOKEN_EQUAL)) {
+		if (set == WAC_OP_SET_LOCAL) {
+			state->compiler->locals[arg].isAssigned = true;
+		} else if (set == WAC_OP_SET_UPVAL) {
+			wac_compiler_upval_assign(state->compiler, arg);
+		}
 		wac_parser_expr(state);
-		wac_compiler_emit_5bytes(state, set, arg);
+		wac_compiler_emit_arg(state, set, arg);
 	} else {
-		wac_compiler_emit_5bytes(state, get, arg);
+		wac_compiler_emit_arg(state, get, arg);
 	}
 }
 
@@ -762,20 +2009,46 @@ static void wac_parser_variable(wac_state_t *state, bool canAssign) {
 	wac_parser_var_named(state, canAssign, state->parser.prev);
 }
 
+//left is the last instruction of left operand, jmpAddr the operand of the jump after it, right is where right operand starts
+//when both operands are constant loads, the one && or || gives is loaded instead
+static bool wac_compiler_fold_logical(wac_state_t *state, bool isAnd, size_t left, size_t jmpAddr, size_t right) {
+	wac_page_t *page = &state->compiler->fun->page;
+	wac_value_t a, b;
+
+	if (!state->compiler->fold
+		|| left == INVALID_SIZE
+		|| left + wac_page_inst_size(page, left) != jmpAddr - 1
+		|| state->compiler->lastLabel > left
+		|| !wac_compiler_constLoad(page, left, &a)
+		|| !wac_compiler_constExpr(state, right, &b)
+	) return false;
+
+	wac_compiler_fold(state, left, 1, wac_value_falsey(a) == isAnd ? a : b);
+	return true;
+}
+
 static void wac_parser_and(wac_state_t *state, bool canAssign) {
-	size_t jmpAddr = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FALSE);
+	size_t left = state->compiler->lastInst;
+	size_t jmpAddr = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_FALSE_LONG);
+	size_t right;
 
-	wac_compiler_emit_byte(state, WAC_OP_POP);
+	wac_compiler_emit_op(state, WAC_OP_POP);
+	right = state->compiler->fun->page.usize;
 	wac_parser_prec(state, WAC_PREC_AND);
-	wac_compiler_patchJmp(&state->compiler->fun->page, jmpAddr);
+	if (wac_compiler_fold_logical(state, true, left, jmpAddr, right)) return;
+	wac_compiler_patchJmp(state, jmpAddr);
 }
 
 static void wac_parser_or(wac_state_t *state, bool canAssign) {
-	size_t jmpAddr = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_TRUE);
+	size_t left = state->compiler->lastInst;
+	size_t jmpAddr = wac_compiler_emit_jmp_forw(state, WAC_OP_JMP_TRUE_LONG);
+	size_t right;
 
-	wac_compiler_emit_byte(state, WAC_OP_POP);
+	wac_compiler_emit_op(state, WAC_OP_POP);
+	right = state->compiler->fun->page.usize;
 	wac_parser_prec(state, WAC_PREC_OR);
-	wac_compiler_patchJmp(&state->compiler->fun->page, jmpAddr);
+	if (wac_compiler_fold_logical(state, false, left, jmpAddr, right)) return;
+	wac_compiler_patchJmp(state, jmpAddr);
 }
 
 static uint32_t wac_parser_argc(wac_state_t *state) {
@@ -792,34 +2065,70 @@ static uint32_t wac_parser_argc(wac_state_t *state) {
 	return argc;
 }
 
+//callee loaded by the last instruction, when it is known to be a closure
+//a global may be something else when the call runs, so it needs a guard
+static wac_obj_closure_t* wac_compiler_inline_callee(wac_state_t *state, bool *guard) {
+	wac_compiler_t *compiler = state->compiler;
+	wac_page_t *page = &compiler->fun->page;
+	size_t last = compiler->lastInst;
+	wac_value_t value;
+
+	if (state->optLevel < 2 || last == INVALID_SIZE || compiler->lastLabel > last || last + wac_page_inst_size(page, last) != page->usize) return NULL;
+	if (page->code[last] == WAC_OP_GET_GLOBAL) {
+		*guard = true;
+		return wac_compiler_inline_global(state, page->code[last + 1], false);
+	}
+	if (wac_compiler_constLoad(page, last, &value) && WAC_OBJ_IS_CLOSURE(value)) {
+		*guard = false;
+		return WAC_OBJ_AS_CLOSURE(value);
+	}
+	return NULL;
+}
+
 static void wac_parser_call(wac_state_t *state, bool canAssign) {
-	wac_compiler_emit_5bytes(state, WAC_OP_CALL, wac_parser_argc(state));
+	bool guard = false;
+	wac_obj_closure_t *closure = wac_compiler_inline_callee(state, &guard);
+	size_t base = state->compiler->depth - 1;
+	uint32_t argc = wac_parser_argc(state);
+
+	if (closure && !state->parser.error && wac_compiler_inline(state, closure, base, argc, guard)) return;
+	wac_compiler_emit_arg(state, WAC_OP_CALL, argc);
 }
 
 static void wac_parser_dot(wac_state_t *state, bool canAssign) {
 	wac_parser_eat(state, WAC_TOKEN_ID, "Expected property name after '.'");
-	wac_compiler_emit_5bytes(state, WAC_OP_CONST, wac_parser_const_id(state, &state->parser.prev));
+	wac_token_t property = state->parser.prev;
+	uint32_t name = wac_parser_const_id(state, &property), local, slot;
+	bool scalar;
 
 	if (canAssign && wac_parser_match(state, WAC_TOKEN_EQUAL)) {
+		scalar = wac_compiler_scalar_load(state, &property, &local, &slot);
 		wac_parser_expr(state);
-		wac_compiler_emit_byte(state, WAC_OP_SET_PROPERTY);
+		if (scalar) {
+			wac_compiler_emit_scalar(state, WAC_OP_SET_SCALAR, local, slot, name);
+		} else {
+			wac_compiler_emit_arg2(state, WAC_OP_SET_PROPERTY_CONST, name, wac_page_addPropertyCache(state, &state->compiler->fun->page));
+		}
 	} else if (wac_parser_match(state, WAC_TOKEN_LPAREN)) {
-		wac_compiler_emit_5bytes(state, WAC_OP_INVOKE, wac_parser_argc(state));
+		uint32_t argc = wac_parser_argc(state);
+		wac_compiler_emit_arg2(state, WAC_OP_INVOKE, name, argc);
+	} else if (wac_compiler_scalar_load(state, &property, &local, &slot)) {
+		wac_compiler_emit_scalar(state, WAC_OP_GET_SCALAR, local, slot, name);
 	} else {
-		wac_compiler_emit_byte(state, WAC_OP_GET_PROPERTY);
+		wac_compiler_emit_arg2(state, WAC_OP_GET_PROPERTY_CONST, name, wac_page_addPropertyCache(state, &state->compiler->fun->page));
 	}
 }
 
 static void wac_parser_square(wac_state_t *state, bool canAssign) {
 	wac_parser_expr(state);
+	wac_parser_eat(state, WAC_TOKEN_RSQUARE, "Expected ']' after expresion");
 
 	if (canAssign && wac_parser_match(state, WAC_TOKEN_EQUAL)) {
 		wac_parser_expr(state);
-		wac_compiler_emit_byte(state, WAC_OP_SET_PROPERTY);
+		wac_compiler_emit_arg(state, WAC_OP_SET_PROPERTY, wac_page_addPropertyCache(state, &state->compiler->fun->page));
 	} else {
-		wac_compiler_emit_byte(state, WAC_OP_GET_PROPERTY);
+		wac_compiler_emit_arg(state, WAC_OP_GET_PROPERTY, wac_page_addPropertyCache(state, &state->compiler->fun->page));
 	}
-	wac_parser_eat(state, WAC_TOKEN_RSQUARE, "Expected ']' after expresion");
 }
 
 static void wac_parser_this(wac_state_t *state, bool canAssign) {
@@ -830,6 +2139,30 @@ static void wac_parser_this(wac_state_t *state, bool canAssign) {
 	wac_parser_variable(state, false);
 }
 
+//super.name binds the method of superclass to this, super.name(...) calls it right away
+static void wac_parser_super(wac_state_t *state, bool canAssign) {
+	uint32_t name;
+	if (!state->classCompiler) {
+		wac_parser_error(&state->parser, "Can't use super outside of a class");
+	} else if (!state->classCompiler->hasSuper) {
+		wac_parser_error(&state->parser, "Can't use super in a class with no superclass");
+	}
+
+	wac_parser_eat(state, WAC_TOKEN_DOT, "Expected '.' after super");
+	wac_parser_eat(state, WAC_TOKEN_ID, "Expected superclass method name");
+	name = wac_parser_const_id(state, &state->parser.prev);
+
+	wac_parser_var_named(state, false, wac_parser_token_synth("this"));
+	if (wac_parser_match(state, WAC_TOKEN_LPAREN)) {
+		uint32_t argc = wac_parser_argc(state);
+		wac_parser_var_named(state, false, wac_parser_token_synth("super"));
+		wac_compiler_emit_arg3(state, WAC_OP_SUPER_INVOKE, name, argc, wac_page_addPropertyCache(state, &state->compiler->fun->page));
+	} else {
+		wac_parser_var_named(state, false, wac_parser_token_synth("super"));
+		wac_compiler_emit_arg2(state, WAC_OP_GET_SUPER, name, wac_page_addPropertyCache(state, &state->compiler->fun->page));
+	}
+}
+
 wac_obj_fun_t* wac_compiler_compile(wac_state_t *state, const char *src) {
 	wac_scanner_init(&state->scanner, src);
 	wac_compiler_t compiler;
@@ -14,6 +14,8 @@ typedef struct wac_local_s {
 	wac_token_t name;
 	unsigned int depth;
 	bool isCaptured;
+	//never assigned locals are captured by copy, unless captured before they got their value
+	bool isAssigned, isCapturedEarly;
 } wac_local_t;
 
 typedef enum wac_fun_type_e {
@@ -23,11 +25,65 @@ typedef enum wac_fun_type_e {
 	WAC_FUN_TYPE_INIT,
 } wac_fun_type_t;
 
+typedef enum wac_backend_e {
+	WAC_BACKEND_STACK,
+	WAC_BACKEND_REG,
+} wac_backend_t;
+
+//0 keeps the code as compiled, 1 adds superinstructions and typed ops,
+//2 also runs wac_peephole_optimize (constant folding among others), inlines small functions
+//and keeps fields of local instances in slots, values of const declarations are folded with any level
+//3 also wac_tier_optimize on hot functions
+#define WAC_OPT_LEVEL_DEFAULT 2
+
+//functions with more code before their RET are not inlined, with optLevel 2
+#define WAC_INLINE_MAX_SIZE 32
+
+//name bound by const, uses are replaced by value
+typedef struct wac_const_s {
+	wac_token_t name;
+	unsigned int depth;
+	wac_value_t value;
+} wac_const_t;
+
+//closure of function declared at top level, calls of the global can get its body
+//with init it is init of a class declared at top level, which only sets fields
+typedef struct wac_inline_s {
+	uint32_t global;
+	wac_obj_closure_t *closure;
+	bool init;
+} wac_inline_t;
+
+//instances kept in locals have at most this many fields in slots, with optLevel 2
+#define WAC_SCALAR_MAX_FIELDS 8
+
+//field set by init, from param or to value when param is INVALID_UINT32
+//slot is where the field lives in the function with the local
+typedef struct wac_scalar_field_s {
+	wac_obj_string_t *name;
+	uint32_t param;
+	wac_value_t value;
+	uint32_t slot;
+} wac_scalar_field_t;
+
+//local whose instance never escapes, it holds the class and fields are in slots
+typedef struct wac_scalar_s {
+	uint32_t local;
+	size_t fields_usize;
+	wac_scalar_field_t fields[WAC_SCALAR_MAX_FIELDS];
+} wac_scalar_t;
+
 typedef struct wac_upval_s {
 	uint32_t index;
 	bool isLocal;
 } wac_upval_t;
 
+//flags of an upval descriptor capturing locals[local], at address in the page
+typedef struct wac_capture_s {
+	uint32_t local;
+	size_t address;
+} wac_capture_t;
+
 typedef struct wac_compiler_s {
 	struct wac_compiler_s* prev;
 
@@ -37,16 +93,44 @@ typedef struct wac_compiler_s {
 	size_t locals_asize, locals_usize;
 	wac_local_t *locals;
 
+	size_t consts_asize, consts_usize;
+	wac_const_t *consts;
+
+	//only in the compiler of the script, closures are kept by consts of its page
+	size_t inlines_asize, inlines_usize;
+	wac_inline_t *inlines;
+
+	size_t scalars_asize, scalars_usize;
+	wac_scalar_t *scalars;
+
+	//open addressing index of the consts of the page, entries are index + 1 and 0 is empty
+	size_t pool_asize;
+	uint32_t *pool;
+
 	size_t upvals_asize;
 	wac_upval_t *upvals;
 
+	//patched to WAC_UPVAL_COPY when the local goes out of scope
+	size_t captures_asize, captures_usize;
+	wac_capture_t *captures;
+
 	unsigned int scopeDepth;
+	//set while the value of a const is parsed, it has to fold to a constant with any optLevel
+	//other expressions are folded by wac_peephole_optimize
+	bool fold;
+
+	//number of values on the stack from bp, used for register ops
+	size_t depth;
+	//start of the last two emitted instructions and of the last jump target
+	size_t lastInst, prevInst, lastLabel;
 } wac_compiler_t;
 
 typedef struct wac_class_compiler_s {
 	struct wac_class_compiler_s *prev;
+	bool hasSuper;
 } wac_class_compiler_t;
 
 wac_obj_fun_t* wac_compiler_compile(wac_state_t *state, const char *src);
+uint32_t wac_compiler_addConst(wac_state_t *state, wac_value_t value);
 
 #endif //__WAC_COMPILER_H
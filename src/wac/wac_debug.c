@@ -1,14 +1,22 @@
 #include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
 
 #include "wac_state.h"
 #include "wac_debug.h"
 #include "wac_object.h"
 
 static size_t wac_inst_simple(const char *name, size_t address);
-static size_t wac_inst_const(const char *name, size_t address, wac_page_t *page);
-static size_t wac_inst_bytes(const char *name, size_t address, wac_page_t *page);
-static size_t wac_inst_jmp_forw(const char *name, size_t address, wac_page_t *page);
-static size_t wac_inst_jmp_back(const char *name, size_t address, wac_page_t *page);
+static size_t wac_inst_const(const char *name, size_t address, wac_page_t *page, size_t size);
+static size_t wac_inst_bytes(const char *name, size_t address, wac_page_t *page, size_t size);
+static size_t wac_inst_jmp_forw(const char *name, size_t address, wac_page_t *page, size_t size);
+static size_t wac_inst_jmp_back(const char *name, size_t address, wac_page_t *page, size_t size);
+static size_t wac_inst_reg(const char *name, size_t address, wac_page_t *page);
+static size_t wac_inst_local_const(const char *name, size_t address, wac_page_t *page);
+static size_t wac_inst_const_arg(const char *name, size_t address, wac_page_t *page, bool local, size_t size);
+static size_t wac_inst_const_arg2(const char *name, size_t address, wac_page_t *page, size_t size);
+static size_t wac_inst_call_inline(const char *name, size_t address, wac_page_t *page);
+static size_t wac_inst_scalar(const char *name, size_t address, wac_page_t *page, size_t size);
 
 void wac_page_disass(wac_page_t *page, const char *name) {
 	printf("== %s ==\n", name);
@@ -18,75 +26,129 @@ void wac_page_disass(wac_page_t *page, const char *name) {
 	}
 }
 
+//reads big endian operand of size bytes starting at address
+static uint32_t wac_inst_operand(wac_page_t *page, size_t address, size_t size) {
+	uint32_t operand = 0;
+	size_t i;
+	for (i = 0; i < size; ++i) {
+		operand = (operand << 8) | page->code[address + i];
+	}
+	return operand;
+}
+
+static size_t wac_inst_closure(const char *name, size_t address, wac_page_t *page, size_t size) {
+	uint32_t constant = wac_inst_operand(page, address + 1, size);
+	printf("%-20s %u ", name, constant);
+	wac_value_print(page->consts.values[constant]);
+	printf("\n");
+	address += 1 + size;
+
+	size_t i;
+	uint8_t flags;
+	uint32_t index;
+	wac_obj_fun_t *fun = WAC_OBJ_AS_FUN(page->consts.values[constant]);
+
+	for (i = 0; i < fun->upvals_usize; ++i) {
+		flags = page->code[address];
+		size = (flags & WAC_UPVAL_LONG) ? 4 : 1;
+		index = wac_inst_operand(page, address + 1, size);
+		printf("%08x      |                         %s %u\n", address, (flags & WAC_UPVAL_COPY) ? "copy" : (flags & WAC_UPVAL_LOCAL) ? "local" : "upval", index);
+		address += 1 + size;
+	}
+
+	return address;
+}
 
 size_t wac_inst_disass(wac_page_t *page, size_t address) {
 	printf("%08x ", address);
 
-	if (address != 0 && page->lines[address] == page->lines[address - 1]) {
+	if (address != 0 && wac_page_line(page, address) == wac_page_line(page, address - 1)) {
 		printf("   | ");
 	} else {
-		printf("%4u ", page->lines[address]);
+		printf("%4u ", wac_page_line(page, address));
 	}
 
 	switch (page->code[address]) {
 		case WAC_OP_CONST:
-			return wac_inst_const("WAC_OP_CONST", address, page);
+			return wac_inst_const("WAC_OP_CONST", address, page, 1);
+		case WAC_OP_CONST_LONG:
+			return wac_inst_const("WAC_OP_CONST_LONG", address, page, 4);
 		case WAC_OP_NULL:
 			return wac_inst_simple("WAC_OP_NULL", address);
 		case WAC_OP_TRUE:
 			return wac_inst_simple("WAC_OP_TRUE", address);
 		case WAC_OP_FALSE:
 			return wac_inst_simple("WAC_OP_FALSE", address);
-		case WAC_OP_CLOSURE: {
-#define WAC_READ_4_BYTES() ((uint32_t)((page->code[address++] << 24) | (page->code[address++] << 16) | (page->code[address++] << 8) | page->code[address++]))
-			++address;
-			uint32_t constant = WAC_READ_4_BYTES();
-			printf("%-20s %u ", "WAC_OP_CLOSURE", constant);
-			wac_value_print(page->consts.values[constant]);
-			printf("\n");
-
-			size_t i;
-			uint8_t isLocal;
-			uint32_t index;
-			wac_obj_fun_t *fun = WAC_OBJ_AS_FUN(page->consts.values[constant]);
-			
-			for (i = 0; i < fun->upvals_usize; ++i) {
-				isLocal = page->code[address++];
-				index = WAC_READ_4_BYTES();
-				printf("%08x      |                         %s %u\n", address - 5, isLocal ? "local" : "upval", index);
-			}
-
-			return address;
-#undef WAC_READ_4_BYTES
-		}
+		case WAC_OP_CLOSURE:
+			return wac_inst_closure("WAC_OP_CLOSURE", address, page, 1);
+		case WAC_OP_CLOSURE_LONG:
+			return wac_inst_closure("WAC_OP_CLOSURE_LONG", address, page, 4);
 		case WAC_OP_CLASS:
-			return wac_inst_const("WAC_OP_CLASS", address, page);
+			return wac_inst_const("WAC_OP_CLASS", address, page, 1);
+		case WAC_OP_CLASS_LONG:
+			return wac_inst_const("WAC_OP_CLASS_LONG", address, page, 4);
 		case WAC_OP_METHOD:
-			return wac_inst_const("WAC_OP_METHOD", address, page);
+			return wac_inst_const("WAC_OP_METHOD", address, page, 1);
+		case WAC_OP_METHOD_LONG:
+			return wac_inst_const("WAC_OP_METHOD_LONG", address, page, 4);
+		case WAC_OP_INHERIT:
+			return wac_inst_simple("WAC_OP_INHERIT", address);
 		case WAC_OP_POP:
 			return wac_inst_simple("WAC_OP_POP", address);
 		case WAC_OP_POPN:
-			return wac_inst_bytes("WAC_OP_POPN", address, page);
+			return wac_inst_bytes("WAC_OP_POPN", address, page, 1);
+		case WAC_OP_POPN_LONG:
+			return wac_inst_bytes("WAC_OP_POPN_LONG", address, page, 4);
 		case WAC_OP_GET_LOCAL:
-			return wac_inst_bytes("WAC_OP_GET_LOCAL", address, page);
+			return wac_inst_bytes("WAC_OP_GET_LOCAL", address, page, 1);
+		case WAC_OP_GET_LOCAL_LONG:
+			return wac_inst_bytes("WAC_OP_GET_LOCAL_LONG", address, page, 4);
 		case WAC_OP_SET_LOCAL:
-			return wac_inst_bytes("WAC_OP_SET_LOCAL", address, page);
+			return wac_inst_bytes("WAC_OP_SET_LOCAL", address, page, 1);
+		case WAC_OP_SET_LOCAL_LONG:
+			return wac_inst_bytes("WAC_OP_SET_LOCAL_LONG", address, page, 4);
 		case WAC_OP_GET_UPVAL:
-			return wac_inst_bytes("WAC_OP_GET_UPVAL", address, page);
+			return wac_inst_bytes("WAC_OP_GET_UPVAL", address, page, 1);
+		case WAC_OP_GET_UPVAL_LONG:
+			return wac_inst_bytes("WAC_OP_GET_UPVAL_LONG", address, page, 4);
 		case WAC_OP_SET_UPVAL:
-			return wac_inst_bytes("WAC_OP_SET_UPVAL", address, page);
+			return wac_inst_bytes("WAC_OP_SET_UPVAL", address, page, 1);
+		case WAC_OP_SET_UPVAL_LONG:
+			return wac_inst_bytes("WAC_OP_SET_UPVAL_LONG", address, page, 4);
 		case WAC_OP_GET_GLOBAL:
-			return wac_inst_const("WAC_OP_GET_GLOBAL", address, page);
+			return wac_inst_bytes("WAC_OP_GET_GLOBAL", address, page, 1);
+		case WAC_OP_GET_GLOBAL_LONG:
+			return wac_inst_bytes("WAC_OP_GET_GLOBAL_LONG", address, page, 4);
 		case WAC_OP_SET_GLOBAL:
-			return wac_inst_const("WAC_OP_SET_GLOBAL", address, page);
+			return wac_inst_bytes("WAC_OP_SET_GLOBAL", address, page, 1);
+		case WAC_OP_SET_GLOBAL_LONG:
+			return wac_inst_bytes("WAC_OP_SET_GLOBAL_LONG", address, page, 4);
 		case WAC_OP_GET_PROPERTY:
-			return wac_inst_simple("WAC_OP_GET_PROPERTY", address);
+			return wac_inst_bytes("WAC_OP_GET_PROPERTY", address, page, 1);
+		case WAC_OP_GET_PROPERTY_LONG:
+			return wac_inst_bytes("WAC_OP_GET_PROPERTY_LONG", address, page, 4);
 		case WAC_OP_SET_PROPERTY:
-			return wac_inst_simple("WAC_OP_SET_PROPERTY", address);
+			return wac_inst_bytes("WAC_OP_SET_PROPERTY", address, page, 1);
+		case WAC_OP_SET_PROPERTY_LONG:
+			return wac_inst_bytes("WAC_OP_SET_PROPERTY_LONG", address, page, 4);
+		case WAC_OP_GET_PROPERTY_CONST:
+			return wac_inst_const_arg("WAC_OP_GET_PROPERTY_CONST", address, page, false, 1);
+		case WAC_OP_GET_PROPERTY_CONST_LONG:
+			return wac_inst_const_arg("WAC_OP_GET_PROPERTY_CONST_LONG", address, page, false, 4);
+		case WAC_OP_SET_PROPERTY_CONST:
+			return wac_inst_const_arg("WAC_OP_SET_PROPERTY_CONST", address, page, false, 1);
+		case WAC_OP_SET_PROPERTY_CONST_LONG:
+			return wac_inst_const_arg("WAC_OP_SET_PROPERTY_CONST_LONG", address, page, false, 4);
+		case WAC_OP_GET_SUPER:
+			return wac_inst_const_arg("WAC_OP_GET_SUPER", address, page, false, 1);
+		case WAC_OP_GET_SUPER_LONG:
+			return wac_inst_const_arg("WAC_OP_GET_SUPER_LONG", address, page, false, 4);
 		case WAC_OP_CLOSE_UPVAL:
 			return wac_inst_simple("WAC_OP_CLOSE_UPVAL", address);
 		case WAC_OP_DEFINE_GLOBAL:
-			return wac_inst_const("WAC_OP_DEFINE_GLOBAL", address, page);
+			return wac_inst_bytes("WAC_OP_DEFINE_GLOBAL", address, page, 1);
+		case WAC_OP_DEFINE_GLOBAL_LONG:
+			return wac_inst_bytes("WAC_OP_DEFINE_GLOBAL_LONG", address, page, 4);
 		case WAC_OP_NOT:
 			return wac_inst_simple("WAC_OP_NOT", address);
 		case WAC_OP_EQUAL:
@@ -105,52 +167,453 @@ size_t wac_inst_disass(wac_page_t *page, size_t address) {
 			return wac_inst_simple("WAC_OP_MUL", address);
 		case WAC_OP_DIV:
 			return wac_inst_simple("WAC_OP_DIV", address);
+		case WAC_OP_MOD:
+			return wac_inst_simple("WAC_OP_MOD", address);
+		case WAC_OP_IDIV:
+			return wac_inst_simple("WAC_OP_IDIV", address);
+		case WAC_OP_BAND:
+			return wac_inst_simple("WAC_OP_BAND", address);
+		case WAC_OP_BOR:
+			return wac_inst_simple("WAC_OP_BOR", address);
+		case WAC_OP_BXOR:
+			return wac_inst_simple("WAC_OP_BXOR", address);
+		case WAC_OP_SHL:
+			return wac_inst_simple("WAC_OP_SHL", address);
+		case WAC_OP_SHR:
+			return wac_inst_simple("WAC_OP_SHR", address);
+		case WAC_OP_BNOT:
+			return wac_inst_simple("WAC_OP_BNOT", address);
 		case WAC_OP_JMP_FORW:
-			return wac_inst_jmp_forw("WAC_OP_JMP_FORW", address, page);
+			return wac_inst_jmp_forw("WAC_OP_JMP_FORW", address, page, 2);
 		case WAC_OP_JMP_BACK:
-			return wac_inst_jmp_back("WAC_OP_JMP_BACK", address, page);
+			return wac_inst_jmp_back("WAC_OP_JMP_BACK", address, page, 1);
+		case WAC_OP_JMP_BACK_LONG:
+			return wac_inst_jmp_back("WAC_OP_JMP_BACK_LONG", address, page, 4);
 		case WAC_OP_JMP_TRUE:
-			return wac_inst_jmp_forw("WAC_OP_JMP_TRUE", address, page);
+			return wac_inst_jmp_forw("WAC_OP_JMP_TRUE", address, page, 2);
 		case WAC_OP_JMP_FALSE:
-			return wac_inst_jmp_forw("WAC_OP_JMP_FALSE", address, page);
+			return wac_inst_jmp_forw("WAC_OP_JMP_FALSE", address, page, 2);
+		case WAC_OP_JMP_FORW_LONG:
+			return wac_inst_jmp_forw("WAC_OP_JMP_FORW_LONG", address, page, 4);
+		case WAC_OP_JMP_TRUE_LONG:
+			return wac_inst_jmp_forw("WAC_OP_JMP_TRUE_LONG", address, page, 4);
+		case WAC_OP_JMP_FALSE_LONG:
+			return wac_inst_jmp_forw("WAC_OP_JMP_FALSE_LONG", address, page, 4);
 		case WAC_OP_CALL:
-			return wac_inst_bytes("WAC_OP_CALL", address, page);
+			return wac_inst_bytes("WAC_OP_CALL", address, page, 1);
+		case WAC_OP_CALL_LONG:
+			return wac_inst_bytes("WAC_OP_CALL_LONG", address, page, 4);
 		case WAC_OP_INVOKE:
-			return wac_inst_bytes("WAC_OP_INVOKE", address, page);
+			return wac_inst_const_arg("WAC_OP_INVOKE", address, page, false, 1);
+		case WAC_OP_INVOKE_LONG:
+			return wac_inst_const_arg("WAC_OP_INVOKE_LONG", address, page, false, 4);
+		case WAC_OP_TAIL_CALL:
+			return wac_inst_bytes("WAC_OP_TAIL_CALL", address, page, 1);
+		case WAC_OP_TAIL_CALL_LONG:
+			return wac_inst_bytes("WAC_OP_TAIL_CALL_LONG", address, page, 4);
+		case WAC_OP_SUPER_INVOKE:
+			return wac_inst_const_arg2("WAC_OP_SUPER_INVOKE", address, page, 1);
+		case WAC_OP_SUPER_INVOKE_LONG:
+			return wac_inst_const_arg2("WAC_OP_SUPER_INVOKE_LONG", address, page, 4);
+		case WAC_OP_CALL_INLINE:
+			return wac_inst_call_inline("WAC_OP_CALL_INLINE", address, page);
+		case WAC_OP_RET_INLINE:
+			return wac_inst_bytes("WAC_OP_RET_INLINE", address, page, 1);
+		case WAC_OP_RET_INLINE_LONG:
+			return wac_inst_bytes("WAC_OP_RET_INLINE_LONG", address, page, 4);
+		case WAC_OP_GET_SCALAR:
+			return wac_inst_scalar("WAC_OP_GET_SCALAR", address, page, 1);
+		case WAC_OP_GET_SCALAR_LONG:
+			return wac_inst_scalar("WAC_OP_GET_SCALAR_LONG", address, page, 4);
+		case WAC_OP_SET_SCALAR:
+			return wac_inst_scalar("WAC_OP_SET_SCALAR", address, page, 1);
+		case WAC_OP_SET_SCALAR_LONG:
+			return wac_inst_scalar("WAC_OP_SET_SCALAR_LONG", address, page, 4);
 		case WAC_OP_RET:
 			return wac_inst_simple("WAC_OP_RET", address);
+		case WAC_OP_ADD_T:
+			return wac_inst_reg("WAC_OP_ADD_T", address, page);
+		case WAC_OP_SUB_T:
+			return wac_inst_reg("WAC_OP_SUB_T", address, page);
+		case WAC_OP_MUL_T:
+			return wac_inst_reg("WAC_OP_MUL_T", address, page);
+		case WAC_OP_DIV_T:
+			return wac_inst_reg("WAC_OP_DIV_T", address, page);
+		case WAC_OP_EQUAL_T:
+			return wac_inst_reg("WAC_OP_EQUAL_T", address, page);
+		case WAC_OP_GREATER_T:
+			return wac_inst_reg("WAC_OP_GREATER_T", address, page);
+		case WAC_OP_LESS_T:
+			return wac_inst_reg("WAC_OP_LESS_T", address, page);
+		case WAC_OP_ADD_R:
+			return wac_inst_reg("WAC_OP_ADD_R", address, page);
+		case WAC_OP_SUB_R:
+			return wac_inst_reg("WAC_OP_SUB_R", address, page);
+		case WAC_OP_MUL_R:
+			return wac_inst_reg("WAC_OP_MUL_R", address, page);
+		case WAC_OP_DIV_R:
+			return wac_inst_reg("WAC_OP_DIV_R", address, page);
+		case WAC_OP_EQUAL_R:
+			return wac_inst_reg("WAC_OP_EQUAL_R", address, page);
+		case WAC_OP_GREATER_R:
+			return wac_inst_reg("WAC_OP_GREATER_R", address, page);
+		case WAC_OP_LESS_R:
+			return wac_inst_reg("WAC_OP_LESS_R", address, page);
+		case WAC_OP_GET_LOCAL_2:
+			printf("%-20s %u %u\n", "WAC_OP_GET_LOCAL_2", page->code[address + 1], page->code[address + 2]);
+			return address + 3;
+		case WAC_OP_GET_LOCAL_CONST:
+			return wac_inst_local_const("WAC_OP_GET_LOCAL_CONST", address, page);
+		case WAC_OP_GET_LOCAL_PROPERTY:
+			return wac_inst_const_arg("WAC_OP_GET_LOCAL_PROPERTY", address, page, true, 1);
+		case WAC_OP_SET_LOCAL_POP:
+			return wac_inst_bytes("WAC_OP_SET_LOCAL_POP", address, page, 1);
+		case WAC_OP_NOT_EQUAL:
+			return wac_inst_simple("WAC_OP_NOT_EQUAL", address);
+		case WAC_OP_GREATER_EQUAL:
+			return wac_inst_simple("WAC_OP_GREATER_EQUAL", address);
+		case WAC_OP_LESS_EQUAL:
+			return wac_inst_simple("WAC_OP_LESS_EQUAL", address);
+		case WAC_OP_EQUAL_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_EQUAL_JMP_FALSE", address, page, 2);
+		case WAC_OP_NOT_EQUAL_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_NOT_EQUAL_JMP_FALSE", address, page, 2);
+		case WAC_OP_GREATER_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_GREATER_JMP_FALSE", address, page, 2);
+		case WAC_OP_GREATER_EQUAL_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_GREATER_EQUAL_JMP_FALSE", address, page, 2);
+		case WAC_OP_LESS_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_LESS_JMP_FALSE", address, page, 2);
+		case WAC_OP_LESS_EQUAL_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_LESS_EQUAL_JMP_FALSE", address, page, 2);
+		case WAC_OP_ADD_NUM_NUM:
+			return wac_inst_simple("WAC_OP_ADD_NUM_NUM", address);
+		case WAC_OP_LESS_NUM:
+			return wac_inst_simple("WAC_OP_LESS_NUM", address);
+		case WAC_OP_ADD_INT_INT:
+			return wac_inst_simple("WAC_OP_ADD_INT_INT", address);
+		case WAC_OP_LESS_INT:
+			return wac_inst_simple("WAC_OP_LESS_INT", address);
+		case WAC_OP_CALL_CLOSURE_EXACT_ARITY:
+			return wac_inst_bytes("WAC_OP_CALL_CLOSURE_EXACT_ARITY", address, page, 1);
+		case WAC_OP_CALL_CLOSURE_EXACT_ARITY_LONG:
+			return wac_inst_bytes("WAC_OP_CALL_CLOSURE_EXACT_ARITY_LONG", address, page, 4);
+		case WAC_OP_ADD_II:
+			return wac_inst_simple("WAC_OP_ADD_II", address);
+		case WAC_OP_SUB_II:
+			return wac_inst_simple("WAC_OP_SUB_II", address);
+		case WAC_OP_MUL_II:
+			return wac_inst_simple("WAC_OP_MUL_II", address);
+		case WAC_OP_ADD_DD:
+			return wac_inst_simple("WAC_OP_ADD_DD", address);
+		case WAC_OP_SUB_DD:
+			return wac_inst_simple("WAC_OP_SUB_DD", address);
+		case WAC_OP_MUL_DD:
+			return wac_inst_simple("WAC_OP_MUL_DD", address);
+		case WAC_OP_DIV_DD:
+			return wac_inst_simple("WAC_OP_DIV_DD", address);
+		case WAC_OP_GREATER_II_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_GREATER_II_JMP_FALSE", address, page, 2);
+		case WAC_OP_GREATER_EQUAL_II_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_GREATER_EQUAL_II_JMP_FALSE", address, page, 2);
+		case WAC_OP_LESS_II_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_LESS_II_JMP_FALSE", address, page, 2);
+		case WAC_OP_LESS_EQUAL_II_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_LESS_EQUAL_II_JMP_FALSE", address, page, 2);
+		case WAC_OP_GREATER_DD_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_GREATER_DD_JMP_FALSE", address, page, 2);
+		case WAC_OP_GREATER_EQUAL_DD_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_GREATER_EQUAL_DD_JMP_FALSE", address, page, 2);
+		case WAC_OP_LESS_DD_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_LESS_DD_JMP_FALSE", address, page, 2);
+		case WAC_OP_LESS_EQUAL_DD_JMP_FALSE:
+			return wac_inst_jmp_forw("WAC_OP_LESS_EQUAL_DD_JMP_FALSE", address, page, 2);
 		default:
 			fprintf(stderr, "[-] Unknown instruction %u\n", page->code[address]);
 			return address + 1;
 	}
 }
 
-#define WAC_READ_4_BYTES() ((uint32_t)((page->code[address + 1] << 24) | (page->code[address + 2] << 16) | (page->code[address + 3] << 8) | page->code[address + 4]))
-
 static size_t wac_inst_simple(const char *name, size_t address) {
 	printf("%s\n", name);
 	return address + 1;
 }
 
-static size_t wac_inst_const(const char *name, size_t address, wac_page_t *page) {
-	uint32_t constant = WAC_READ_4_BYTES();
+static size_t wac_inst_const(const char *name, size_t address, wac_page_t *page, size_t size) {
+	uint32_t constant = wac_inst_operand(page, address + 1, size);
 	printf("%-20s %u '", name, constant);
 	wac_value_print(page->consts.values[constant]);
 	printf("'\n");
-	return address + 5;
+	return address + 1 + size;
 }
 
-static size_t wac_inst_bytes(const char *name, size_t address, wac_page_t *page) {
-	printf("%-20s %u\n", name, WAC_READ_4_BYTES());
-	return address + 5;
+static size_t wac_inst_bytes(const char *name, size_t address, wac_page_t *page, size_t size) {
+	printf("%-20s %u\n", name, wac_inst_operand(page, address + 1, size));
+	return address + 1 + size;
 }
 
-static size_t wac_inst_jmp_forw(const char *name, size_t address, wac_page_t *page) {
-	printf("%-20s %08x -> %08x\n", name, address, address + 5 + WAC_READ_4_BYTES());
-	return address + 5;
+static size_t wac_inst_jmp_forw(const char *name, size_t address, wac_page_t *page, size_t size) {
+	printf("%-20s %08x -> %08x\n", name, address, address + 1 + size + wac_inst_operand(page, address + 1, size));
+	return address + 1 + size;
+}
+
+static size_t wac_inst_jmp_back(const char *name, size_t address, wac_page_t *page, size_t size) {
+	printf("%-20s %08x -> %08x\n", name, address, address + 1 + size - wac_inst_operand(page, address + 1, size));
+	return address + 1 + size;
+}
+
+static void wac_inst_rk(wac_page_t *page, uint8_t operand) {
+	if (operand & WAC_RK_CONST) {
+		printf(" k%u '", operand & WAC_RK_INDEX_MAX);
+		wac_value_print(page->consts.values[operand & WAC_RK_INDEX_MAX]);
+		printf("'");
+	} else {
+		printf(" r%u", operand);
+	}
+}
+
+static size_t wac_inst_reg(const char *name, size_t address, wac_page_t *page) {
+	printf("%-20s r%u", name, page->code[address + 1]);
+	wac_inst_rk(page, page->code[address + 2]);
+	wac_inst_rk(page, page->code[address + 3]);
+	printf("\n");
+	return address + 4;
+}
+
+static size_t wac_inst_local_const(const char *name, size_t address, wac_page_t *page) {
+	printf("%-20s %u %u '", name, page->code[address + 1], page->code[address + 2]);
+	wac_value_print(page->consts.values[page->code[address + 2]]);
+	printf("'\n");
+	return address + 3;
+}
+
+//[local] constant, property cache index or argc, the last two of size bytes
+static size_t wac_inst_const_arg(const char *name, size_t address, wac_page_t *page, bool local, size_t size) {
+	uint32_t constant, arg;
+	printf("%-20s ", name);
+	if (local) printf("%u ", page->code[++address]);
+	constant = wac_inst_operand(page, address + 1, size);
+	arg = wac_inst_operand(page, address + 1 + size, size);
+	printf("%u '", constant);
+	wac_value_print(page->consts.values[constant]);
+	printf("' %u\n", arg);
+	return address + 1 + 2 * size;
 }
 
-static size_t wac_inst_jmp_back(const char *name, size_t address, wac_page_t *page) {
-	printf("%-20s %08x -> %08x\n", name, address, address + 5 - WAC_READ_4_BYTES());
+static size_t wac_inst_const_arg2(const char *name, size_t address, wac_page_t *page, size_t size) {
+	uint32_t constant = wac_inst_operand(page, address + 1, size);
+	printf("%-20s %u '", name, constant);
+	wac_value_print(page->consts.values[constant]);
+	printf("' %u %u\n", wac_inst_operand(page, address + 1 + size, size), wac_inst_operand(page, address + 1 + 2 * size, size));
+	return address + 1 + 3 * size;
+}
+
+static size_t wac_inst_call_inline(const char *name, size_t address, wac_page_t *page) {
+	uint8_t constant = page->code[address + 1];
+	printf("%-20s %u '", name, constant);
+	wac_value_print(page->consts.values[constant]);
+	printf("' %u -> %08zx\n", page->code[address + 2], address + 5 + wac_inst_operand(page, address + 3, 2));
 	return address + 5;
 }
+
+//local slot, field slot, name constant and cache, each operand has size bytes
+static size_t wac_inst_scalar(const char *name, size_t address, wac_page_t *page, size_t size) {
+	uint32_t constant = wac_inst_operand(page, address + 1 + 2 * size, size);
+	printf("%-20s %u %u %u '", name, wac_inst_operand(page, address + 1, size), wac_inst_operand(page, address + 1 + size, size), constant);
+	wac_value_print(page->consts.values[constant]);
+	printf("' %u\n", wac_inst_operand(page, address + 1 + 3 * size, size));
+	return address + 1 + 4 * size;
+}
+
+#ifdef WAC_DEBUG_PROFILE_OPS
+static const char *wac_profile_names[] = {
+	[WAC_OP_CONST]				= "CONST",
+	[WAC_OP_CONST_LONG]			= "CONST_LONG",
+	[WAC_OP_NULL]				= "NULL",
+	[WAC_OP_TRUE]				= "TRUE",
+	[WAC_OP_FALSE]				= "FALSE",
+	[WAC_OP_CLOSURE]			= "CLOSURE",
+	[WAC_OP_CLOSURE_LONG]			= "CLOSURE_LONG",
+	[WAC_OP_CLASS]				= "CLASS",
+	[WAC_OP_CLASS_LONG]			= "CLASS_LONG",
+	[WAC_OP_METHOD]				= "METHOD",
+	[WAC_OP_METHOD_LONG]			= "METHOD_LONG",
+	[WAC_OP_INHERIT]			= "INHERIT",
+	[WAC_OP_POP]				= "POP",
+	[WAC_OP_POPN]				= "POPN",
+	[WAC_OP_POPN_LONG]			= "POPN_LONG",
+	[WAC_OP_GET_LOCAL]			= "GET_LOCAL",
+	[WAC_OP_GET_LOCAL_LONG]			= "GET_LOCAL_LONG",
+	[WAC_OP_SET_LOCAL]			= "SET_LOCAL",
+	[WAC_OP_SET_LOCAL_LONG]			= "SET_LOCAL_LONG",
+	[WAC_OP_GET_UPVAL]			= "GET_UPVAL",
+	[WAC_OP_GET_UPVAL_LONG]			= "GET_UPVAL_LONG",
+	[WAC_OP_SET_UPVAL]			= "SET_UPVAL",
+	[WAC_OP_SET_UPVAL_LONG]			= "SET_UPVAL_LONG",
+	[WAC_OP_GET_GLOBAL]			= "GET_GLOBAL",
+	[WAC_OP_GET_GLOBAL_LONG]		= "GET_GLOBAL_LONG",
+	[WAC_OP_SET_GLOBAL]			= "SET_GLOBAL",
+	[WAC_OP_SET_GLOBAL_LONG]		= "SET_GLOBAL_LONG",
+	[WAC_OP_GET_PROPERTY]			= "GET_PROPERTY",
+	[WAC_OP_GET_PROPERTY_LONG]		= "GET_PROPERTY_LONG",
+	[WAC_OP_SET_PROPERTY]			= "SET_PROPERTY",
+	[WAC_OP_SET_PROPERTY_LONG]		= "SET_PROPERTY_LONG",
+	[WAC_OP_GET_PROPERTY_CONST]		= "GET_PROPERTY_CONST",
+	[WAC_OP_GET_PROPERTY_CONST_LONG]	= "GET_PROPERTY_CONST_LONG",
+	[WAC_OP_SET_PROPERTY_CONST]		= "SET_PROPERTY_CONST",
+	[WAC_OP_SET_PROPERTY_CONST_LONG]	= "SET_PROPERTY_CONST_LONG",
+	[WAC_OP_GET_SUPER]			= "GET_SUPER",
+	[WAC_OP_GET_SUPER_LONG]			= "GET_SUPER_LONG",
+	[WAC_OP_CLOSE_UPVAL]			= "CLOSE_UPVAL",
+	[WAC_OP_DEFINE_GLOBAL]			= "DEFINE_GLOBAL",
+	[WAC_OP_DEFINE_GLOBAL_LONG]		= "DEFINE_GLOBAL_LONG",
+	[WAC_OP_NOT]				= "NOT",
+	[WAC_OP_EQUAL]				= "EQUAL",
+	[WAC_OP_GREATER]			= "GREATER",
+	[WAC_OP_LESS]				= "LESS",
+	[WAC_OP_NEG]				= "NEG",
+	[WAC_OP_ADD]				= "ADD",
+	[WAC_OP_SUB]				= "SUB",
+	[WAC_OP_MUL]				= "MUL",
+	[WAC_OP_DIV]				= "DIV",
+	[WAC_OP_MOD]				= "MOD",
+	[WAC_OP_IDIV]				= "IDIV",
+	[WAC_OP_BAND]				= "BAND",
+	[WAC_OP_BOR]				= "BOR",
+	[WAC_OP_BXOR]				= "BXOR",
+	[WAC_OP_SHL]				= "SHL",
+	[WAC_OP_SHR]				= "SHR",
+	[WAC_OP_BNOT]				= "BNOT",
+	[WAC_OP_JMP_FORW]			= "JMP_FORW",
+	[WAC_OP_JMP_BACK]			= "JMP_BACK",
+	[WAC_OP_JMP_BACK_LONG]			= "JMP_BACK_LONG",
+	[WAC_OP_JMP_TRUE]			= "JMP_TRUE",
+	[WAC_OP_JMP_FALSE]			= "JMP_FALSE",
+	[WAC_OP_JMP_FORW_LONG]			= "JMP_FORW_LONG",
+	[WAC_OP_JMP_TRUE_LONG]			= "JMP_TRUE_LONG",
+	[WAC_OP_JMP_FALSE_LONG]			= "JMP_FALSE_LONG",
+	[WAC_OP_CALL]				= "CALL",
+	[WAC_OP_CALL_LONG]			= "CALL_LONG",
+	[WAC_OP_INVOKE]				= "INVOKE",
+	[WAC_OP_INVOKE_LONG]			= "INVOKE_LONG",
+	[WAC_OP_TAIL_CALL]			= "TAIL_CALL",
+	[WAC_OP_TAIL_CALL_LONG]			= "TAIL_CALL_LONG",
+	[WAC_OP_SUPER_INVOKE]			= "SUPER_INVOKE",
+	[WAC_OP_SUPER_INVOKE_LONG]		= "SUPER_INVOKE_LONG",
+	[WAC_OP_CALL_INLINE]			= "CALL_INLINE",
+	[WAC_OP_RET_INLINE]			= "RET_INLINE",
+	[WAC_OP_RET_INLINE_LONG]		= "RET_INLINE_LONG",
+	[WAC_OP_GET_SCALAR]			= "GET_SCALAR",
+	[WAC_OP_GET_SCALAR_LONG]		= "GET_SCALAR_LONG",
+	[WAC_OP_SET_SCALAR]			= "SET_SCALAR",
+	[WAC_OP_SET_SCALAR_LONG]		= "SET_SCALAR_LONG",
+	[WAC_OP_RET]				= "RET",
+	[WAC_OP_ADD_T]				= "ADD_T",
+	[WAC_OP_SUB_T]				= "SUB_T",
+	[WAC_OP_MUL_T]				= "MUL_T",
+	[WAC_OP_DIV_T]				= "DIV_T",
+	[WAC_OP_EQUAL_T]			= "EQUAL_T",
+	[WAC_OP_GREATER_T]			= "GREATER_T",
+	[WAC_OP_LESS_T]				= "LESS_T",
+	[WAC_OP_ADD_R]				= "ADD_R",
+	[WAC_OP_SUB_R]				= "SUB_R",
+	[WAC_OP_MUL_R]				= "MUL_R",
+	[WAC_OP_DIV_R]				= "DIV_R",
+	[WAC_OP_EQUAL_R]			= "EQUAL_R",
+	[WAC_OP_GREATER_R]			= "GREATER_R",
+	[WAC_OP_LESS_R]				= "LESS_R",
+	[WAC_OP_GET_LOCAL_2]			= "GET_LOCAL_2",
+	[WAC_OP_GET_LOCAL_CONST]		= "GET_LOCAL_CONST",
+	[WAC_OP_GET_LOCAL_PROPERTY]		= "GET_LOCAL_PROPERTY",
+	[WAC_OP_SET_LOCAL_POP]			= "SET_LOCAL_POP",
+	[WAC_OP_NOT_EQUAL]			= "NOT_EQUAL",
+	[WAC_OP_GREATER_EQUAL]			= "GREATER_EQUAL",
+	[WAC_OP_LESS_EQUAL]			= "LESS_EQUAL",
+	[WAC_OP_EQUAL_JMP_FALSE]		= "EQUAL_JMP_FALSE",
+	[WAC_OP_NOT_EQUAL_JMP_FALSE]		= "NOT_EQUAL_JMP_FALSE",
+	[WAC_OP_GREATER_JMP_FALSE]		= "GREATER_JMP_FALSE",
+	[WAC_OP_GREATER_EQUAL_JMP_FALSE]	= "GREATER_EQUAL_JMP_FALSE",
+	[WAC_OP_LESS_JMP_FALSE]			= "LESS_JMP_FALSE",
+	[WAC_OP_LESS_EQUAL_JMP_FALSE]		= "LESS_EQUAL_JMP_FALSE",
+	[WAC_OP_ADD_NUM_NUM]			= "ADD_NUM_NUM",
+	[WAC_OP_LESS_NUM]			= "LESS_NUM",
+	[WAC_OP_ADD_INT_INT]			= "ADD_INT_INT",
+	[WAC_OP_LESS_INT]			= "LESS_INT",
+	[WAC_OP_CALL_CLOSURE_EXACT_ARITY]	= "CALL_CLOSURE_EXACT_ARITY",
+	[WAC_OP_CALL_CLOSURE_EXACT_ARITY_LONG]	= "CALL_CLOSURE_EXACT_ARITY_LONG",
+	[WAC_OP_ADD_II]			= "ADD_II",
+	[WAC_OP_SUB_II]			= "SUB_II",
+	[WAC_OP_MUL_II]			= "MUL_II",
+	[WAC_OP_ADD_DD]			= "ADD_DD",
+	[WAC_OP_SUB_DD]			= "SUB_DD",
+	[WAC_OP_MUL_DD]			= "MUL_DD",
+	[WAC_OP_DIV_DD]			= "DIV_DD",
+	[WAC_OP_GREATER_II_JMP_FALSE]	= "GREATER_II_JMP_FALSE",
+	[WAC_OP_GREATER_EQUAL_II_JMP_FALSE]	= "GREATER_EQUAL_II_JMP_FALSE",
+	[WAC_OP_LESS_II_JMP_FALSE]	= "LESS_II_JMP_FALSE",
+	[WAC_OP_LESS_EQUAL_II_JMP_FALSE]	= "LESS_EQUAL_II_JMP_FALSE",
+	[WAC_OP_GREATER_DD_JMP_FALSE]	= "GREATER_DD_JMP_FALSE",
+	[WAC_OP_GREATER_EQUAL_DD_JMP_FALSE]	= "GREATER_EQUAL_DD_JMP_FALSE",
+	[WAC_OP_LESS_DD_JMP_FALSE]	= "LESS_DD_JMP_FALSE",
+	[WAC_OP_LESS_EQUAL_DD_JMP_FALSE]	= "LESS_EQUAL_DD_JMP_FALSE",
+};
+
+void wac_profile_init(wac_profile_t *profile) {
+	profile->history = 0;
+	profile->recorded = 0;
+	memset(profile->keys, 0, sizeof(profile->keys));
+	memset(profile->counts, 0, sizeof(profile->counts));
+}
+
+//key holds length of the n-gram above the opcodes, so it is never 0
+static void wac_profile_count(wac_profile_t *profile, uint64_t key) {
+	size_t i, index = (size_t)((key * 0x9E3779B97F4A7C15ULL) >> 50) & (WAC_PROFILE_SIZE - 1);
+	for (i = 0; i < WAC_PROFILE_SIZE; ++i, index = (index + 1) & (WAC_PROFILE_SIZE - 1)) {
+		if (profile->keys[index] == key) {
+			++profile->counts[index];
+			return;
+		}
+		if (profile->keys[index] == 0) {
+			profile->keys[index] = key;
+			profile->counts[index] = 1;
+			return;
+		}
+	}
+}
+
+void wac_profile_record(wac_profile_t *profile, uint8_t op) {
+	uint64_t n;
+	profile->history = (profile->history << 8) | op;
+	++profile->recorded;
+
+	for (n = 2; n <= WAC_PROFILE_NGRAM_MAX && n <= profile->recorded; ++n) {
+		wac_profile_count(profile, (n << 32) | (profile->history & (uint32_t)(((uint64_t)1 << (8 * n)) - 1)));
+	}
+}
+
+//prints most common n-grams of each length, clears the counts while at it
+void wac_profile_print(wac_profile_t *profile) {
+	uint64_t n, key;
+	size_t i, j, top;
+
+	for (n = 2; n <= WAC_PROFILE_NGRAM_MAX; ++n) {
+		fprintf(stderr, "== opcode %u-grams ==\n", (unsigned int)n);
+		for (i = 0; i < WAC_PROFILE_TOP; ++i) {
+			top = WAC_PROFILE_SIZE;
+			for (j = 0; j < WAC_PROFILE_SIZE; ++j) {
+				if ((profile->keys[j] >> 32) != n || profile->counts[j] == 0) continue;
+				if (top == WAC_PROFILE_SIZE || profile->counts[j] > profile->counts[top]) top = j;
+			}
+			if (top == WAC_PROFILE_SIZE) break;
+
+			fprintf(stderr, "%12" PRIu64, profile->counts[top]);
+			key = profile->keys[top];
+			for (j = n; j-- > 0; ) {
+				fprintf(stderr, " %s", wac_profile_names[(key >> (8 * j)) & 0xFF]);
+			}
+			fprintf(stderr, "\n");
+			profile->counts[top] = 0;
+		}
+	}
+}
+#endif //WAC_DEBUG_PROFILE_OPS
@@ -6,4 +6,23 @@
 void wac_page_disass(wac_page_t *page, const char *name);
 size_t wac_inst_disass(wac_page_t *page, size_t address);
 
+#ifdef WAC_DEBUG_PROFILE_OPS
+//counts of opcode sequences as they are executed, for picking superinstructions
+//build with WAC_NO_SUPERINST to see the sequences the compiler emits
+#define WAC_PROFILE_NGRAM_MAX	4
+#define WAC_PROFILE_SIZE	16384
+#define WAC_PROFILE_TOP		20
+
+typedef struct wac_profile_s {
+	uint32_t history;
+	size_t recorded;
+	uint64_t keys[WAC_PROFILE_SIZE];
+	uint64_t counts[WAC_PROFILE_SIZE];
+} wac_profile_t;
+
+void wac_profile_init(wac_profile_t *profile);
+void wac_profile_record(wac_profile_t *profile, uint8_t op);
+void wac_profile_print(wac_profile_t *profile);
+#endif
+
 #endif //__WAC_DEBUG_H
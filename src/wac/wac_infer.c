@@ -0,0 +1,564 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wac_state.h"
+#include "wac_infer.h"
+#include "wac_object.h"
+#include "wac_memory.h"
+
+#define WAC_INFER_NO_LABEL ((size_t)(-1))
+
+//types of stack slots of the frame at the current instruction
+//and at the start of every jump target
+typedef struct wac_infer_s {
+	wac_page_t *page;
+	size_t slots, depth;
+	uint8_t *curr;
+	bool *captured;
+	size_t *labels;
+	size_t *depths;
+	uint8_t *types;
+	//depth and types of the two values on top before each instruction, see wac_infer_facts
+	size_t *atDepths;
+	uint8_t *atTops;
+	bool failed;
+} wac_infer_t;
+
+static uint8_t wac_infer_merge(uint8_t a, uint8_t b) {
+	if (a == b || b == WAC_INFER_NONE) return a;
+	if (a == WAC_INFER_NONE) return b;
+	return WAC_INFER_ANY;
+}
+
+static uint8_t wac_infer_const(wac_infer_t *in, uint32_t index) {
+	wac_value_t value = in->page->consts.values[index];
+	if (WAC_VAL_IS_INT(value)) return WAC_INFER_INT;
+	if (WAC_VAL_IS_NUMBER(value)) return WAC_INFER_NUM;
+	return WAC_INFER_ANY;
+}
+
+static uint8_t wac_infer_arith(uint8_t a, uint8_t b) {
+	if (a == WAC_INFER_INT && b == WAC_INFER_INT) return WAC_INFER_INT;
+	if ((a == WAC_INFER_INT || a == WAC_INFER_NUM) && (b == WAC_INFER_INT || b == WAC_INFER_NUM)) return WAC_INFER_NUM;
+	return WAC_INFER_ANY;
+}
+
+//index or count operand of short and _LONG forms
+static uint32_t wac_infer_arg(wac_page_t *page, size_t address) {
+	uint8_t *code = page->code + address;
+	if (wac_page_inst_size(page, address) == 2) return code[1];
+	return ((uint32_t)code[1] << 24) | (code[2] << 16) | (code[3] << 8) | code[4];
+}
+
+//second operand of instruction with two or three
+static uint32_t wac_infer_arg2(wac_page_t *page, size_t address) {
+	uint8_t *code = page->code + address;
+	if (wac_page_inst_size(page, address) <= 4) return code[2];
+	return ((uint32_t)code[5] << 24) | (code[6] << 16) | (code[7] << 8) | code[8];
+}
+
+static void wac_infer_pop(wac_infer_t *in, size_t n) {
+	if (in->depth < n) {
+		in->failed = true;
+		return;
+	}
+	in->depth -= n;
+}
+
+static void wac_infer_push(wac_infer_t *in, uint8_t type) {
+	if (in->depth >= in->slots) {
+		in->failed = true;
+		return;
+	}
+	in->curr[in->depth++] = type;
+}
+
+static uint8_t wac_infer_top(wac_infer_t *in, size_t dist) {
+	if (in->depth <= dist) {
+		in->failed = true;
+		return WAC_INFER_ANY;
+	}
+	return in->curr[in->depth - 1 - dist];
+}
+
+//captured locals can be written through upvalues, so they are never known
+static uint8_t wac_infer_getLocal(wac_infer_t *in, uint32_t slot) {
+	if (slot >= in->depth) {
+		in->failed = true;
+		return WAC_INFER_ANY;
+	}
+	return in->captured[slot] ? WAC_INFER_ANY : in->curr[slot];
+}
+
+static void wac_infer_setLocal(wac_infer_t *in, uint32_t slot, uint8_t type) {
+	if (slot >= in->depth) {
+		in->failed = true;
+		return;
+	}
+	in->curr[slot] = in->captured[slot] ? WAC_INFER_ANY : type;
+}
+
+static uint8_t wac_infer_rk(wac_infer_t *in, uint8_t operand) {
+	if (operand & WAC_RK_CONST) return wac_infer_const(in, operand & WAC_RK_INDEX_MAX);
+	return wac_infer_getLocal(in, operand);
+}
+
+//state flowing into the label, returns whether it changed
+static bool wac_infer_flow(wac_infer_t *in, size_t label, size_t depth, const uint8_t *types) {
+	uint8_t *dst = in->types + label * in->slots;
+	bool changed = false;
+	size_t i;
+
+	if (in->depths[label] == WAC_INFER_NO_DEPTH) {
+		in->depths[label] = depth;
+		memcpy(dst, types, depth);
+		return true;
+	}
+	if (in->depths[label] != depth) {
+		in->failed = true;
+		return false;
+	}
+	for (i = 0; i < depth; ++i) {
+		uint8_t type = wac_infer_merge(dst[i], types[i]);
+		if (type != dst[i]) {
+			dst[i] = type;
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+static uint8_t wac_infer_typed(uint8_t op, uint8_t a, uint8_t b) {
+	if (a != b) return op;
+	if (a == WAC_INFER_INT) {
+		switch (op) {
+			case WAC_OP_ADD:
+			case WAC_OP_ADD_NUM_NUM:
+			case WAC_OP_ADD_INT_INT: return WAC_OP_ADD_II;
+			case WAC_OP_SUB: return WAC_OP_SUB_II;
+			case WAC_OP_MUL: return WAC_OP_MUL_II;
+			case WAC_OP_GREATER_JMP_FALSE: return WAC_OP_GREATER_II_JMP_FALSE;
+			case WAC_OP_GREATER_EQUAL_JMP_FALSE: return WAC_OP_GREATER_EQUAL_II_JMP_FALSE;
+			case WAC_OP_LESS_JMP_FALSE: return WAC_OP_LESS_II_JMP_FALSE;
+			case WAC_OP_LESS_EQUAL_JMP_FALSE: return WAC_OP_LESS_EQUAL_II_JMP_FALSE;
+		}
+	} else if (a == WAC_INFER_NUM) {
+		switch (op) {
+			case WAC_OP_ADD:
+			case WAC_OP_ADD_NUM_NUM:
+			case WAC_OP_ADD_INT_INT: return WAC_OP_ADD_DD;
+			case WAC_OP_SUB: return WAC_OP_SUB_DD;
+			case WAC_OP_MUL: return WAC_OP_MUL_DD;
+			case WAC_OP_DIV: return WAC_OP_DIV_DD;
+			case WAC_OP_GREATER_JMP_FALSE: return WAC_OP_GREATER_DD_JMP_FALSE;
+			case WAC_OP_GREATER_EQUAL_JMP_FALSE: return WAC_OP_GREATER_EQUAL_DD_JMP_FALSE;
+			case WAC_OP_LESS_JMP_FALSE: return WAC_OP_LESS_DD_JMP_FALSE;
+			case WAC_OP_LESS_EQUAL_JMP_FALSE: return WAC_OP_LESS_EQUAL_DD_JMP_FALSE;
+		}
+	}
+	return op;
+}
+
+//effect of the instruction at address on in->curr, jumps are done by caller
+static void wac_infer_inst(wac_infer_t *in, size_t address) {
+	uint8_t *code = in->page->code + address;
+	uint8_t type;
+
+	switch (code[0]) {
+		case WAC_OP_CONST:
+		case WAC_OP_CONST_LONG:
+			wac_infer_push(in, wac_infer_const(in, wac_infer_arg(in->page, address)));
+			break;
+		case WAC_OP_NULL:
+		case WAC_OP_TRUE:
+		case WAC_OP_FALSE:
+		case WAC_OP_CLOSURE:
+		case WAC_OP_CLOSURE_LONG:
+		case WAC_OP_CLASS:
+		case WAC_OP_CLASS_LONG:
+		case WAC_OP_GET_UPVAL:
+		case WAC_OP_GET_UPVAL_LONG:
+		case WAC_OP_GET_GLOBAL:
+		case WAC_OP_GET_GLOBAL_LONG:
+			wac_infer_push(in, WAC_INFER_ANY);
+			break;
+		case WAC_OP_METHOD:
+		case WAC_OP_METHOD_LONG:
+		case WAC_OP_INHERIT:
+		case WAC_OP_POP:
+		case WAC_OP_CLOSE_UPVAL:
+		case WAC_OP_DEFINE_GLOBAL:
+		case WAC_OP_DEFINE_GLOBAL_LONG:
+			wac_infer_pop(in, 1);
+			break;
+		case WAC_OP_POPN:
+		case WAC_OP_POPN_LONG:
+			wac_infer_pop(in, wac_infer_arg(in->page, address));
+			break;
+
+		case WAC_OP_GET_LOCAL:
+		case WAC_OP_GET_LOCAL_LONG:
+			wac_infer_push(in, wac_infer_getLocal(in, wac_infer_arg(in->page, address)));
+			break;
+		case WAC_OP_SET_LOCAL:
+		case WAC_OP_SET_LOCAL_LONG:
+			wac_infer_setLocal(in, wac_infer_arg(in->page, address), wac_infer_top(in, 0));
+			break;
+		case WAC_OP_SET_LOCAL_POP:
+			wac_infer_setLocal(in, code[1], wac_infer_top(in, 0));
+			wac_infer_pop(in, 1);
+			break;
+		case WAC_OP_GET_LOCAL_2:
+			type = wac_infer_getLocal(in, code[2]);
+			wac_infer_push(in, wac_infer_getLocal(in, code[1]));
+			wac_infer_push(in, type);
+			break;
+		case WAC_OP_GET_LOCAL_CONST:
+			wac_infer_push(in, wac_infer_getLocal(in, code[1]));
+			wac_infer_push(in, wac_infer_const(in, code[2]));
+			break;
+		case WAC_OP_GET_LOCAL_PROPERTY:
+			wac_infer_getLocal(in, code[1]);
+			wac_infer_push(in, WAC_INFER_ANY);
+			break;
+		case WAC_OP_SET_UPVAL:
+		case WAC_OP_SET_UPVAL_LONG:
+		case WAC_OP_SET_GLOBAL:
+		case WAC_OP_SET_GLOBAL_LONG:
+			wac_infer_top(in, 0);
+			break;
+		case WAC_OP_GET_PROPERTY:
+		case WAC_OP_GET_PROPERTY_LONG:
+			wac_infer_pop(in, 2);
+			wac_infer_push(in, WAC_INFER_ANY);
+			break;
+		case WAC_OP_GET_PROPERTY_CONST:
+		case WAC_OP_GET_PROPERTY_CONST_LONG:
+		case WAC_OP_NOT:
+			wac_infer_pop(in, 1);
+			wac_infer_push(in, WAC_INFER_ANY);
+			break;
+		case WAC_OP_SET_PROPERTY:
+		case WAC_OP_SET_PROPERTY_LONG:
+			wac_infer_pop(in, 3);
+			wac_infer_push(in, WAC_INFER_ANY);
+			break;
+		case WAC_OP_SET_PROPERTY_CONST:
+		case WAC_OP_SET_PROPERTY_CONST_LONG:
+		case WAC_OP_GET_SUPER:
+		case WAC_OP_GET_SUPER_LONG:
+			wac_infer_pop(in, 2);
+			wac_infer_push(in, WAC_INFER_ANY);
+			break;
+
+		case WAC_OP_EQUAL:
+		case WAC_OP_GREATER:
+		case WAC_OP_LESS:
+		case WAC_OP_NOT_EQUAL:
+		case WAC_OP_GREATER_EQUAL:
+		case WAC_OP_LESS_EQUAL:
+		case WAC_OP_LESS_NUM:
+		case WAC_OP_LESS_INT:
+			wac_infer_pop(in, 2);
+			wac_infer_push(in, WAC_INFER_ANY);
+			break;
+		case WAC_OP_NEG:
+			type = wac_infer_arith(wac_infer_top(in, 0), WAC_INFER_INT);
+			wac_infer_pop(in, 1);
+			wac_infer_push(in, type);
+			break;
+		//quickened ones only run on the types they are made for, or as the generic op
+		case WAC_OP_ADD:
+		case WAC_OP_ADD_NUM_NUM:
+		case WAC_OP_ADD_INT_INT:
+		case WAC_OP_SUB:
+		case WAC_OP_MUL:
+		case WAC_OP_MOD:
+		case WAC_OP_IDIV:
+			type = wac_infer_arith(wac_infer_top(in, 1), wac_infer_top(in, 0));
+			wac_infer_pop(in, 2);
+			wac_infer_push(in, type);
+			break;
+		case WAC_OP_DIV:
+			type = wac_infer_arith(wac_infer_top(in, 1), wac_infer_top(in, 0));
+			wac_infer_pop(in, 2);
+			wac_infer_push(in, type == WAC_INFER_ANY ? WAC_INFER_ANY : WAC_INFER_NUM);
+			break;
+		case WAC_OP_BAND:
+		case WAC_OP_BOR:
+		case WAC_OP_BXOR:
+		case WAC_OP_SHL:
+		case WAC_OP_SHR:
+			wac_infer_pop(in, 2);
+			wac_infer_push(in, WAC_INFER_INT);
+			break;
+		case WAC_OP_BNOT:
+			wac_infer_pop(in, 1);
+			wac_infer_push(in, WAC_INFER_INT);
+			break;
+		case WAC_OP_ADD_II:
+		case WAC_OP_SUB_II:
+		case WAC_OP_MUL_II:
+			wac_infer_pop(in, 2);
+			wac_infer_push(in, WAC_INFER_INT);
+			break;
+		case WAC_OP_ADD_DD:
+		case WAC_OP_SUB_DD:
+		case WAC_OP_MUL_DD:
+		case WAC_OP_DIV_DD:
+			wac_infer_pop(in, 2);
+			wac_infer_push(in, WAC_INFER_NUM);
+			break;
+
+		case WAC_OP_JMP_FORW:
+		case WAC_OP_JMP_BACK:
+		case WAC_OP_JMP_BACK_LONG:
+		case WAC_OP_JMP_TRUE:
+		case WAC_OP_JMP_FALSE:
+		case WAC_OP_JMP_FORW_LONG:
+		case WAC_OP_JMP_TRUE_LONG:
+		case WAC_OP_JMP_FALSE_LONG:
+		case WAC_OP_RET:
+			break;
+		case WAC_OP_EQUAL_JMP_FALSE:
+		case WAC_OP_NOT_EQUAL_JMP_FALSE:
+		case WAC_OP_GREATER_JMP_FALSE:
+		case WAC_OP_GREATER_EQUAL_JMP_FALSE:
+		case WAC_OP_LESS_JMP_FALSE:
+		case WAC_OP_LESS_EQUAL_JMP_FALSE:
+		case WAC_OP_GREATER_II_JMP_FALSE:
+		case WAC_OP_GREATER_EQUAL_II_JMP_FALSE:
+		case WAC_OP_LESS_II_JMP_FALSE:
+		case WAC_OP_LESS_EQUAL_II_JMP_FALSE:
+		case WAC_OP_GREATER_DD_JMP_FALSE:
+		case WAC_OP_GREATER_EQUAL_DD_JMP_FALSE:
+		case WAC_OP_LESS_DD_JMP_FALSE:
+		case WAC_OP_LESS_EQUAL_DD_JMP_FALSE:
+			wac_infer_pop(in, 2);
+			break;
+
+		case WAC_OP_CALL:
+		case WAC_OP_CALL_LONG:
+		case WAC_OP_TAIL_CALL:
+		case WAC_OP_TAIL_CALL_LONG:
+		case WAC_OP_CALL_CLOSURE_EXACT_ARITY:
+		case WAC_OP_CALL_CLOSURE_EXACT_ARITY_LONG:
+			wac_infer_pop(in, wac_infer_arg(in->page, address) + 1);
+			wac_infer_push(in, WAC_INFER_ANY);
+			break;
+		case WAC_OP_INVOKE:
+		case WAC_OP_INVOKE_LONG:
+			wac_infer_pop(in, wac_infer_arg2(in->page, address) + 1);
+			wac_infer_push(in, WAC_INFER_ANY);
+			break;
+		case WAC_OP_SUPER_INVOKE:
+		case WAC_OP_SUPER_INVOKE_LONG:
+			wac_infer_pop(in, wac_infer_arg2(in->page, address) + 2);
+			wac_infer_push(in, WAC_INFER_ANY);
+			break;
+		case WAC_OP_CALL_INLINE:
+			break;
+		case WAC_OP_RET_INLINE:
+		case WAC_OP_RET_INLINE_LONG:
+			type = wac_infer_top(in, 0);
+			wac_infer_pop(in, wac_infer_arg(in->page, address) + 1);
+			wac_infer_push(in, type);
+			break;
+		case WAC_OP_GET_SCALAR:
+		case WAC_OP_GET_SCALAR_LONG:
+			wac_infer_push(in, WAC_INFER_ANY);
+			break;
+		case WAC_OP_SET_SCALAR:
+		case WAC_OP_SET_SCALAR_LONG:
+			wac_infer_setLocal(in, wac_infer_arg2(in->page, address), WAC_INFER_ANY);
+			break;
+
+		case WAC_OP_ADD_T:
+		case WAC_OP_SUB_T:
+		case WAC_OP_MUL_T:
+		case WAC_OP_DIV_T:
+		case WAC_OP_EQUAL_T:
+		case WAC_OP_GREATER_T:
+		case WAC_OP_LESS_T:
+		case WAC_OP_ADD_R:
+		case WAC_OP_SUB_R:
+		case WAC_OP_MUL_R:
+		case WAC_OP_DIV_R:
+		case WAC_OP_EQUAL_R:
+		case WAC_OP_GREATER_R:
+		case WAC_OP_LESS_R: {
+			uint8_t op = code[0] >= WAC_OP_ADD_R ? code[0] - (WAC_OP_ADD_R - WAC_OP_ADD_T) : code[0];
+			type = wac_infer_arith(wac_infer_rk(in, code[2]), wac_infer_rk(in, code[3]));
+			if (op == WAC_OP_DIV_T && type != WAC_INFER_ANY) type = WAC_INFER_NUM;
+			if (op == WAC_OP_EQUAL_T || op == WAC_OP_GREATER_T || op == WAC_OP_LESS_T) type = WAC_INFER_ANY;
+			if (code[0] < WAC_OP_ADD_R) {
+				//operands may not have been pushed, so the slot can be at depth
+				if (code[1] > in->depth) {
+					in->failed = true;
+					break;
+				}
+				in->depth = code[1];
+				wac_infer_push(in, type);
+			} else {
+				wac_infer_setLocal(in, code[1], type);
+			}
+			break;
+		}
+
+		//anything else is not known here, so the page is left alone
+		default:
+			in->failed = true;
+			break;
+	}
+}
+
+//walks the page once from the entry state, jump targets take the merged state
+//returns whether some label state changed, with rewrite the typed ops are written
+static bool wac_infer_sweep(wac_infer_t *in, size_t entryDepth, bool rewrite) {
+	wac_page_t *page = in->page;
+	size_t address, target, label, n;
+	bool changed = false, reachable = true;
+	uint8_t *jump = in->curr + in->slots;
+
+	in->depth = entryDepth;
+	for (n = 0; n < entryDepth; ++n) in->curr[n] = WAC_INFER_ANY;
+
+	for (address = 0; address < page->usize && !in->failed; address += wac_page_inst_size(page, address)) {
+		uint8_t op = page->code[address];
+
+		label = in->labels[address];
+		if (label != WAC_INFER_NO_LABEL) {
+			if (reachable && wac_infer_flow(in, label, in->depth, in->curr)) changed = true;
+			reachable = in->depths[label] != WAC_INFER_NO_DEPTH;
+			if (reachable) {
+				in->depth = in->depths[label];
+				memcpy(in->curr, in->types + label * in->slots, in->depth);
+			}
+		}
+		if (!reachable) continue;
+
+		if (in->atDepths) {
+			in->atDepths[address] = in->depth;
+			in->atTops[address * 2] = in->depth >= 2 ? in->curr[in->depth - 2] : WAC_INFER_ANY;
+			in->atTops[address * 2 + 1] = in->depth >= 1 ? in->curr[in->depth - 1] : WAC_INFER_ANY;
+		}
+		if (rewrite && in->depth >= 2) {
+			page->code[address] = wac_infer_typed(op, in->curr[in->depth - 2], in->curr[in->depth - 1]);
+		}
+
+		target = wac_page_inst_target(page, address);
+		if (target != WAC_PAGE_NO_TARGET) {
+			//fused compares jump with false in place of the operands
+			//CALL_INLINE jumps with the result in place of callee and args
+			n = in->depth;
+			memcpy(jump, in->curr, n);
+			if (op == WAC_OP_CALL_INLINE) {
+				if (n <= in->page->code[address + 2]) {
+					in->failed = true;
+					break;
+				}
+				n -= in->page->code[address + 2];
+				jump[n - 1] = WAC_INFER_ANY;
+			} else if (!wac_page_isJump(op)) {
+				if (n < 2) {
+					in->failed = true;
+					break;
+				}
+				jump[--n - 1] = WAC_INFER_ANY;
+			}
+			if (wac_infer_flow(in, in->labels[target], n, jump)) changed = true;
+		}
+
+		wac_infer_inst(in, address);
+		if (wac_page_isExit(op)) {
+			reachable = false;
+		}
+	}
+	return changed;
+}
+
+//forward dataflow over stack slots of the function, the last sweep rewrites
+//or records the state before each instruction into depths and tops
+static bool wac_infer_run(wac_obj_fun_t *fun, bool rewrite, size_t *depths, uint8_t *tops) {
+	wac_page_t *page = &fun->page;
+	size_t size = page->usize, address, target, labels_usize = 0, i;
+	bool failed;
+	wac_infer_t in;
+
+	in.page = page;
+	in.slots = fun->maxStack + 1;
+	in.atDepths = NULL;
+	in.atTops = NULL;
+	in.failed = false;
+	in.curr = WAC_ARRAY_INIT_NOGC(uint8_t, in.slots * 2);
+	in.captured = WAC_ARRAY_INIT_NOGC(bool, in.slots);
+	in.labels = WAC_ARRAY_INIT_NOGC(size_t, size + 1);
+	if (!in.curr || !in.captured || !in.labels) {
+		fprintf(stderr, "[-] Failed to allocate memory for infer\n");
+		exit(1);
+	}
+
+	memset(in.captured, 0, sizeof(bool) * in.slots);
+	for (i = 0; i <= size; ++i) in.labels[i] = WAC_INFER_NO_LABEL;
+	for (address = 0; address < size; address += wac_page_inst_size(page, address)) {
+		uint8_t op = page->code[address];
+		target = wac_page_inst_target(page, address);
+		if (target != WAC_PAGE_NO_TARGET && in.labels[target] == WAC_INFER_NO_LABEL) {
+			in.labels[target] = labels_usize++;
+		}
+
+		if (op == WAC_OP_CLOSURE || op == WAC_OP_CLOSURE_LONG) {
+			size_t end = address + wac_page_inst_size(page, address);
+			size_t at = address + (op == WAC_OP_CLOSURE ? 2 : 5);
+			while (at < end) {
+				uint8_t flags = page->code[at];
+				uint32_t slot = (flags & WAC_UPVAL_LONG)
+					? ((uint32_t)page->code[at + 1] << 24) | (page->code[at + 2] << 16) | (page->code[at + 3] << 8) | page->code[at + 4]
+					: page->code[at + 1];
+				if ((flags & WAC_UPVAL_LOCAL) && !(flags & WAC_UPVAL_COPY) && slot < in.slots) in.captured[slot] = true;
+				at += (flags & WAC_UPVAL_LONG) ? 5 : 2;
+			}
+		}
+	}
+
+	in.depths = WAC_ARRAY_INIT_NOGC(size_t, labels_usize + 1);
+	in.types = WAC_ARRAY_INIT_NOGC(uint8_t, (labels_usize + 1) * in.slots);
+	if (!in.depths || !in.types) {
+		fprintf(stderr, "[-] Failed to allocate memory for infer\n");
+		exit(1);
+	}
+	for (i = 0; i < labels_usize; ++i) in.depths[i] = WAC_INFER_NO_DEPTH;
+
+	//label states only grow, so this ends
+	while (wac_infer_sweep(&in, fun->arity + 1, false) && !in.failed);
+	if (!in.failed) {
+		if (depths) {
+			for (i = 0; i <= size; ++i) depths[i] = WAC_INFER_NO_DEPTH;
+			in.atDepths = depths;
+			in.atTops = tops;
+		}
+		wac_infer_sweep(&in, fun->arity + 1, rewrite);
+	}
+	failed = in.failed;
+
+	free(in.curr);
+	free(in.captured);
+	free(in.labels);
+	free(in.depths);
+	free(in.types);
+	return !failed;
+}
+
+//where both operands are proven ints or doubles the generic or quickened op is replaced by typed one
+//instructions keep their size, so jumps stay as they are
+void wac_infer_types(wac_obj_fun_t *fun) {
+	wac_infer_run(fun, true, NULL, NULL);
+}
+
+//stack depth before each instruction (WAC_INFER_NO_DEPTH where it is not reached) and types
+//of the two values on top of it at tops[address * 2], the second one first, for wac_tier
+//depths has room for page->usize + 1, tops for twice that, false when the page is not known
+bool wac_infer_facts(wac_obj_fun_t *fun, size_t *depths, uint8_t *tops) {
+	return wac_infer_run(fun, false, depths, tops);
+}
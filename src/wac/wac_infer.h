@@ -0,0 +1,20 @@
+#ifndef __WAC_INFER_H
+#define __WAC_INFER_H
+
+#include "wac_object.h"
+
+#define WAC_INFER_NO_DEPTH ((size_t)(-1))
+
+//NONE is not known yet, ANY is anything, INT and NUM meet in ANY
+//coz typed ops need both operands of the same kind
+typedef enum wac_infer_type_e {
+	WAC_INFER_NONE,
+	WAC_INFER_INT,
+	WAC_INFER_NUM,
+	WAC_INFER_ANY,
+} wac_infer_type_t;
+
+void wac_infer_types(wac_obj_fun_t *fun);
+bool wac_infer_facts(wac_obj_fun_t *fun, size_t *depths, uint8_t *tops);
+
+#endif //__WAC_INFER_H
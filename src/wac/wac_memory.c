@@ -43,6 +43,15 @@ static void wac_gc_mark_table(wac_vm_t *vm, wac_table_t *table) {
 	}
 }
 
+//shape keeps its parents, keys of shapes are compared by address, so they have to stay alive
+//each shape marks the key it added, the parents mark the rest
+static void wac_gc_mark_shape(wac_vm_t *vm, wac_shape_t *shape) {
+	for (; shape && !shape->isMarked; shape = shape->parent) {
+		shape->isMarked = true;
+		if (shape->count) wac_gc_mark_obj(vm, (wac_obj_t*)shape->keys[shape->count - 1]);
+	}
+}
+
 static void wac_gc_mark_roots(wac_state_t *state) {
 	wac_vm_t *vm = &state->vm;
 	size_t i;
@@ -62,13 +71,21 @@ static void wac_gc_mark_roots(wac_state_t *state) {
 		wac_gc_mark_obj(vm, (wac_obj_t*)upval);
 	}
 
-	wac_gc_mark_table(vm, &vm->globals);
+	for (i = 0; i < vm->globals_usize; ++i) {
+		wac_gc_mark_value(vm, vm->globals[i]);
+	}
+	wac_gc_mark_table(vm, &vm->globalNames);
+	wac_gc_mark_table(vm, &vm->globalConsts);
 
 	for (compiler = state->compiler; compiler; compiler = compiler->prev) {
 		wac_gc_mark_obj(vm, (wac_obj_t*)compiler->fun);
+		for (i = 0; i < compiler->consts_usize; ++i) {
+			wac_gc_mark_value(vm, compiler->consts[i].value);
+		}
 	}
 
 	wac_gc_mark_obj(vm, (wac_obj_t*)vm->initString);
+	wac_gc_mark_shape(vm, vm->shapeRoot);
 }
 
 static void wac_gc_mark_valarr(wac_vm_t *vm, wac_valarr_t *arr) {
@@ -89,9 +106,24 @@ static void wac_gc_blacken(wac_vm_t *vm, wac_obj_t *obj) {
 		case WAC_OBJ_NATIVE:
 			break;
 		case WAC_OBJ_FUN: {
+			size_t i, j;
 			wac_obj_fun_t *fun = (wac_obj_fun_t*)obj;
 			wac_gc_mark_obj(vm, (wac_obj_t*)fun->name);
 			wac_gc_mark_valarr(vm, &fun->page.consts);
+			for (i = 0; i < fun->page.inlined_usize; ++i) {
+				wac_gc_mark_obj(vm, (wac_obj_t*)fun->page.inlined[i].fun);
+			}
+			//class of method entry has to live, or other class could take its address
+			for (i = 0; i < fun->page.props_usize; ++i) {
+				wac_page_propertyCache_t *cache = &fun->page.props[i];
+				for (j = 0; j < cache->usize && j < WAC_PAGE_PIC_SIZE; ++j) {
+					wac_gc_mark_obj(vm, (wac_obj_t*)cache->entries[j].klass);
+					wac_gc_mark_obj(vm, (wac_obj_t*)cache->entries[j].method);
+					//same for shapes, a new shape could take the address of a freed one
+					wac_gc_mark_shape(vm, cache->entries[j].shape);
+					wac_gc_mark_shape(vm, cache->entries[j].next);
+				}
+			}
 			break;
 		}
 		case WAC_OBJ_CLOSURE: {
@@ -110,12 +142,21 @@ static void wac_gc_blacken(wac_vm_t *vm, wac_obj_t *obj) {
 			wac_obj_class_t *klass = (wac_obj_class_t*)obj;
 			wac_gc_mark_obj(vm, (wac_obj_t*)klass->name);
 			wac_gc_mark_table(vm, &klass->methods);
+			wac_gc_mark_obj(vm, (wac_obj_t*)klass->init);
 			break;
 		}
 		case WAC_OBJ_INSTANCE: {
+			size_t i;
 			wac_obj_instance_t *instance = (wac_obj_instance_t*)obj;
 			wac_gc_mark_obj(vm, (wac_obj_t*)instance->klass);
-			wac_gc_mark_table(vm, &instance->fields);
+			wac_gc_mark_shape(vm, instance->shape);
+			if (instance->dict) {
+				wac_gc_mark_table(vm, instance->dict);
+			} else {
+				for (i = 0; i < instance->shape->count; ++i) {
+					wac_gc_mark_value(vm, *wac_obj_instance_slot(instance, i));
+				}
+			}
 			break;
 		}
 		case WAC_OBJ_BOUND: {
@@ -173,6 +214,9 @@ static void wac_gc_collect(wac_state_t *state) {
 	}
 
 	wac_gc_sweep(state);
+	//after the instances that used them are gone
+	if (state->vm.shapeRoot) wac_shape_sweep(state, state->vm.shapeRoot);
+	wac_vm_methods_clear(&state->vm);
 
 	state->vm.mem_nextGC = state->vm.mem_total * WAC_GC_GROW_MUL;
 
@@ -32,28 +32,28 @@ static wac_obj_string_t* wac_obj_string_alloc(wac_state_t *state, char *buf, siz
 	return string;
 }
 
-static uint32_t wac_obj_string_hash(const char *string, size_t len) {
-	uint32_t hash = 2166136261u;
+uint32_t wac_obj_string_hash(const char *string, size_t len) {
+	uint32_t hash = WAC_HASH_INIT;
 	size_t i;
-	for (i = 0; i < len; ++i) {
-		hash ^= (uint8_t)string[i];
-		hash *= 16777619;
-	}
+	for (i = 0; i < len; ++i) hash = WAC_HASH_STEP(hash, string[i]);
 	return hash;
 }
 
-wac_obj_string_t* wac_obj_string_copy(wac_state_t *state, const char *src, size_t len) {
-	char *dst = WAC_ARRAY_INIT(state, char, len + 1);
-	uint32_t hash = wac_obj_string_hash(src, len);
-
+//hash must be wac_obj_string_hash of src, the buffer is only allocated when src is not interned yet
+wac_obj_string_t* wac_obj_string_intern(wac_state_t *state, const char *src, size_t len, uint32_t hash) {
 	wac_obj_string_t *interned = wac_table_find_string(&state->vm.strings, src, len, hash);
 	if (interned) return interned;
 
+	char *dst = WAC_ARRAY_INIT(state, char, len + 1);
 	memcpy(dst, src, len);
 	dst[len] = '\0';
 	return wac_obj_string_alloc(state, dst, len, hash);
 }
 
+wac_obj_string_t* wac_obj_string_copy(wac_state_t *state, const char *src, size_t len) {
+	return wac_obj_string_intern(state, src, len, wac_obj_string_hash(src, len));
+}
+
 wac_obj_string_t* wac_obj_string_take(wac_state_t *state, char *buf, size_t len) {
 	uint32_t hash = wac_obj_string_hash(buf, len);
 	wac_obj_string_t *interned = wac_table_find_string(&state->vm.strings, buf, len, hash);
@@ -105,6 +105,10 @@ wac_obj_fun_t* wac_obj_fun_init(wac_state_t *state) {
 	wac_obj_fun_t *fun = WAC_OBJ_ALLOC(wac_obj_fun_t, WAC_OBJ_FUN);
 	fun->arity = 0;
 	fun->upvals_usize = 0;
+	fun->maxStack = 0;
+	fun->closesUpvals = false;
+	fun->hotCalls = 0;
+	fun->getter = NULL;
 	fun->name = NULL;
 	//coz the page_init might trigger wac_realloc
 	wac_vm_push(&state->vm, WAC_VAL_OBJ(fun));
@@ -144,6 +148,8 @@ wac_obj_upval_t* wac_obj_upval_init(wac_state_t *state, wac_value_t *loc) {
 wac_obj_class_t* wac_obj_class_init(wac_state_t *state, wac_obj_string_t *name) {
 	wac_obj_class_t *klass = WAC_OBJ_ALLOC(wac_obj_class_t, WAC_OBJ_CLASS);
 	klass->name = name;
+	klass->init = NULL;
+	klass->version = 0;
 	wac_vm_push(&state->vm, WAC_VAL_OBJ(klass));
 	wac_table_init(state, &klass->methods);
 	wac_vm_pop(&state->vm);
@@ -153,12 +159,70 @@ wac_obj_class_t* wac_obj_class_init(wac_state_t *state, wac_obj_string_t *name)
 wac_obj_instance_t* wac_obj_instance_init(wac_state_t *state, wac_obj_class_t *klass) {
 	wac_obj_instance_t *instance = WAC_OBJ_ALLOC(wac_obj_instance_t, WAC_OBJ_INSTANCE);
 	instance->klass = klass;
-	wac_vm_push(&state->vm, WAC_VAL_OBJ(instance));
-	wac_table_init(state, &instance->fields);
-	wac_vm_pop(&state->vm);
+	instance->shape = state->vm.shapeRoot;
+	instance->overflow_asize = 0;
+	instance->overflow = NULL;
+	instance->dict = NULL;
 	return instance;
 }
 
+bool wac_obj_instance_get(wac_obj_instance_t *instance, wac_obj_string_t *key, wac_value_t *value) {
+	size_t slot;
+	if (instance->dict) return wac_table_get(instance->dict, key, value);
+	if (!wac_shape_find(instance->shape, key, &slot)) return false;
+	*value = *wac_obj_instance_slot(instance, slot);
+	return true;
+}
+
+//fields are copied to the table before the instance switches to it
+//so gc still sees them through the shape meanwhile
+static void wac_obj_instance_toDict(wac_state_t *state, wac_obj_instance_t *instance) {
+	size_t i;
+	wac_table_t *dict = WAC_ARRAY_INIT(state, wac_table_t, 1);
+	dict->asize = 0;
+	dict->usize = 0;
+	dict->entries = NULL;
+	wac_table_init(state, dict);
+	for (i = 0; i < instance->shape->count; ++i) {
+		wac_table_set(state, dict, instance->shape->keys[i], *wac_obj_instance_slot(instance, i));
+	}
+
+	WAC_ARRAY_FREE(state, wac_value_t, instance->overflow, instance->overflow_asize);
+	instance->overflow_asize = 0;
+	instance->overflow = NULL;
+	instance->shape = NULL;
+	instance->dict = dict;
+}
+
+//key and value have to be reachable by gc, coz this can allocate
+void wac_obj_instance_set(wac_state_t *state, wac_obj_instance_t *instance, wac_obj_string_t *key, wac_value_t value) {
+	size_t slot;
+	wac_shape_t *shape;
+
+	if (!instance->dict) {
+		if (wac_shape_find(instance->shape, key, &slot)) {
+			*wac_obj_instance_slot(instance, slot) = value;
+			return;
+		}
+
+		//grow before adding the shape, gc frees a new shape until the instance points at it
+		slot = instance->shape->count;
+		if (slot >= WAC_OBJ_INSTANCE_INLINE && slot - WAC_OBJ_INSTANCE_INLINE >= instance->overflow_asize) {
+			size_t oldSize = instance->overflow_asize;
+			instance->overflow_asize = oldSize ? oldSize * WAC_ARRAY_GROW_MUL : WAC_OBJ_INSTANCE_INLINE;
+			instance->overflow = WAC_ARRAY_GROW(state, wac_value_t, instance->overflow, oldSize, instance->overflow_asize);
+		}
+		shape = wac_shape_add(state, instance->shape, key);
+		if (shape) {
+			*wac_obj_instance_slot(instance, slot) = value;
+			instance->shape = shape;
+			return;
+		}
+		wac_obj_instance_toDict(state, instance);
+	}
+	wac_table_set(state, instance->dict, key, value);
+}
+
 wac_obj_bound_t* wac_obj_bound_init(wac_state_t *state, wac_value_t receiver, wac_obj_closure_t *method) {
 	wac_obj_bound_t *bound = WAC_OBJ_ALLOC(wac_obj_bound_t, WAC_OBJ_BOUND);
 	bound->receiver = receiver;
@@ -197,10 +261,16 @@ void wac_obj_free(wac_state_t *state, wac_obj_t *obj) {
 			wac_table_free(state, &((wac_obj_class_t*)obj)->methods);
 			WAC_FREE(state, wac_obj_class_t, obj);
 			break;
-		case WAC_OBJ_INSTANCE:
-			wac_table_free(state, &((wac_obj_instance_t*)obj)->fields);
+		case WAC_OBJ_INSTANCE: {
+			wac_obj_instance_t *instance = (wac_obj_instance_t*)obj;
+			WAC_ARRAY_FREE(state, wac_value_t, instance->overflow, instance->overflow_asize);
+			if (instance->dict) {
+				wac_table_free(state, instance->dict);
+				WAC_FREE(state, wac_table_t, instance->dict);
+			}
 			WAC_FREE(state, wac_obj_instance_t, obj);
 			break;
+		}
 		case WAC_OBJ_BOUND:
 			WAC_FREE(state, wac_obj_bound_t, obj);
 			break;
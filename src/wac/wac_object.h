@@ -5,6 +5,7 @@
 #include "wac_page.h"
 #include "wac_value.h"
 #include "wac_table.h"
+#include "wac_shape.h"
 
 typedef enum wac_obj_type_e {
 	WAC_OBJ_STRING,
@@ -34,6 +35,14 @@ typedef struct wac_obj_fun_s {
 	wac_obj_t obj;
 	uint32_t arity;
 	size_t upvals_usize;
+	//stack slots from bp the function can use, computed by the compiler
+	size_t maxStack;
+	//some local is captured by reference, so returning has to close upvals
+	bool closesUpvals;
+	//calls left before wac_tier_optimize runs on it, 0 when it does not
+	uint32_t hotCalls;
+	//field returned by method that only does return this.field, kept in consts of page
+	wac_obj_string_t *getter;
 	wac_page_t page;
 	wac_obj_string_t *name;
 } wac_obj_fun_t;
@@ -65,12 +74,24 @@ typedef struct wac_obj_class_s {
 	wac_obj_t obj;
 	wac_obj_string_t *name;
 	wac_table_t methods;
+	//method named vm->initString, NULL when there is none
+	wac_obj_closure_t *init;
+	//changes with every change of methods, so caches of methods can tell
+	uint32_t version;
 } wac_obj_class_t;
 
+//fields of shape are in slots, the ones over WAC_OBJ_INSTANCE_INLINE in overflow
+//in dictionary mode shape is NULL and fields are in dict
+#define WAC_OBJ_INSTANCE_INLINE 4
+
 typedef struct wac_obj_instance_s {
 	wac_obj_t obj;
 	wac_obj_class_t *klass;
-	wac_table_t fields;
+	wac_shape_t *shape;
+	wac_value_t slots[WAC_OBJ_INSTANCE_INLINE];
+	size_t overflow_asize;
+	wac_value_t *overflow;
+	wac_table_t *dict;
 } wac_obj_instance_t;
 
 typedef struct wac_obj_bound_s {
@@ -100,6 +121,12 @@ typedef struct wac_obj_bound_s {
 static inline bool wac_obj_isType(wac_value_t value, wac_obj_type_t type) {
 	return WAC_VAL_IS_OBJ(value) && WAC_OBJ_TYPE(value) == type;
 }
+
+static inline wac_value_t* wac_obj_instance_slot(wac_obj_instance_t *instance, size_t slot) {
+	return slot < WAC_OBJ_INSTANCE_INLINE ? &instance->slots[slot] : &instance->overflow[slot - WAC_OBJ_INSTANCE_INLINE];
+}
+uint32_t wac_obj_string_hash(const char *string, size_t len);
+wac_obj_string_t* wac_obj_string_intern(wac_state_t *state, const char *src, size_t len, uint32_t hash);
 wac_obj_string_t* wac_obj_string_copy(wac_state_t *state, const char *src, size_t len);
 void wac_obj_print(wac_value_t value);
 wac_obj_string_t* wac_obj_string_take(wac_state_t *state, char *buf, size_t len);
@@ -109,6 +136,8 @@ wac_obj_closure_t* wac_obj_closure_init(wac_state_t *state, wac_obj_fun_t *fun);
 wac_obj_upval_t* wac_obj_upval_init(wac_state_t *state, wac_value_t *loc);
 wac_obj_class_t* wac_obj_class_init(wac_state_t *state, wac_obj_string_t *name);
 wac_obj_instance_t* wac_obj_instance_init(wac_state_t *state, wac_obj_class_t *klass);
+bool wac_obj_instance_get(wac_obj_instance_t *instance, wac_obj_string_t *key, wac_value_t *value);
+void wac_obj_instance_set(wac_state_t *state, wac_obj_instance_t *instance, wac_obj_string_t *key, wac_value_t value);
 wac_obj_bound_t* wac_obj_bound_init(wac_state_t *state, wac_value_t receiver, wac_obj_closure_t *method);
 void wac_obj_free(wac_state_t *state, wac_obj_t *obj);
 
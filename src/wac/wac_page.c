@@ -3,12 +3,19 @@
 #include "wac_state.h"
 #include "wac_page.h"
 #include "wac_memory.h"
+#include "wac_object.h"
 
 void wac_page_init(wac_state_t *state, wac_page_t *page) {
 	page->asize = WAC_ARRAY_DEFAULT_SIZE;
 	page->usize = 0;
 	//coz gc
 	page->consts.usize = 0;
+	page->props_asize = 0;
+	page->props_usize = 0;
+	page->props = NULL;
+	page->inlined_asize = 0;
+	page->inlined_usize = 0;
+	page->inlined = NULL;
 	page->code = WAC_ARRAY_INIT(state, uint8_t, page->asize);
 	page->lines = WAC_ARRAY_INIT(state, size_t, page->asize);
 	wac_valarr_init(state, &page->consts);
@@ -34,6 +41,11 @@ uint32_t wac_page_addConst(wac_state_t *state, wac_page_t *page, wac_value_t val
 	return page->consts.usize - 1;
 }
 
+void wac_page_write_2bytes(wac_state_t *state, wac_page_t *page, uint16_t bytes, size_t line) {
+	wac_page_write_byte(state, page, (bytes & 0xFF00) >> 8, line);
+	wac_page_write_byte(state, page, (bytes & 0x00FF), line);
+}
+
 void wac_page_write_4bytes(wac_state_t *state, wac_page_t *page, uint32_t bytes, size_t line) {
 	wac_page_write_byte(state, page, (bytes & 0xFF000000) >> 24, line);
 	wac_page_write_byte(state, page, (bytes & 0x00FF0000) >> 16, line);
@@ -41,11 +53,234 @@ void wac_page_write_4bytes(wac_state_t *state, wac_page_t *page, uint32_t bytes,
 	wac_page_write_byte(state, page, (bytes & 0x000000FF), line);
 }
 
+//number of operand bytes, ops not listed have none
+static const uint8_t wac_page_operandSize[] = {
+	[WAC_OP_CONST]			= 1,
+	[WAC_OP_CONST_LONG]		= 4,
+	[WAC_OP_CLASS]			= 1,
+	[WAC_OP_CLASS_LONG]		= 4,
+	[WAC_OP_METHOD]			= 1,
+	[WAC_OP_METHOD_LONG]		= 4,
+	[WAC_OP_POPN]			= 1,
+	[WAC_OP_POPN_LONG]		= 4,
+	[WAC_OP_GET_LOCAL]		= 1,
+	[WAC_OP_GET_LOCAL_LONG]		= 4,
+	[WAC_OP_SET_LOCAL]		= 1,
+	[WAC_OP_SET_LOCAL_LONG]		= 4,
+	[WAC_OP_GET_UPVAL]		= 1,
+	[WAC_OP_GET_UPVAL_LONG]		= 4,
+	[WAC_OP_SET_UPVAL]		= 1,
+	[WAC_OP_SET_UPVAL_LONG]		= 4,
+	[WAC_OP_GET_GLOBAL]		= 1,
+	[WAC_OP_GET_GLOBAL_LONG]	= 4,
+	[WAC_OP_SET_GLOBAL]		= 1,
+	[WAC_OP_SET_GLOBAL_LONG]	= 4,
+	[WAC_OP_GET_PROPERTY]		= 1,
+	[WAC_OP_GET_PROPERTY_LONG]	= 4,
+	[WAC_OP_SET_PROPERTY]		= 1,
+	[WAC_OP_SET_PROPERTY_LONG]	= 4,
+	[WAC_OP_GET_PROPERTY_CONST]	= 2,
+	[WAC_OP_GET_PROPERTY_CONST_LONG]	= 8,
+	[WAC_OP_SET_PROPERTY_CONST]	= 2,
+	[WAC_OP_SET_PROPERTY_CONST_LONG]	= 8,
+	[WAC_OP_GET_SUPER]		= 2,
+	[WAC_OP_GET_SUPER_LONG]		= 8,
+	[WAC_OP_DEFINE_GLOBAL]		= 1,
+	[WAC_OP_DEFINE_GLOBAL_LONG]	= 4,
+	[WAC_OP_JMP_BACK]		= 1,
+	[WAC_OP_JMP_BACK_LONG]		= 4,
+	[WAC_OP_CALL]			= 1,
+	[WAC_OP_CALL_LONG]		= 4,
+	[WAC_OP_INVOKE]			= 2,
+	[WAC_OP_INVOKE_LONG]		= 8,
+	[WAC_OP_TAIL_CALL]		= 1,
+	[WAC_OP_TAIL_CALL_LONG]		= 4,
+	[WAC_OP_SUPER_INVOKE]		= 3,
+	[WAC_OP_SUPER_INVOKE_LONG]	= 12,
+	[WAC_OP_CALL_INLINE]		= 4,
+	[WAC_OP_RET_INLINE]		= 1,
+	[WAC_OP_RET_INLINE_LONG]	= 4,
+	[WAC_OP_GET_SCALAR]		= 4,
+	[WAC_OP_GET_SCALAR_LONG]	= 16,
+	[WAC_OP_SET_SCALAR]		= 4,
+	[WAC_OP_SET_SCALAR_LONG]	= 16,
+	[WAC_OP_JMP_FORW]		= 2,
+	[WAC_OP_JMP_TRUE]		= 2,
+	[WAC_OP_JMP_FALSE]		= 2,
+	[WAC_OP_JMP_FORW_LONG]		= 4,
+	[WAC_OP_JMP_TRUE_LONG]		= 4,
+	[WAC_OP_JMP_FALSE_LONG]		= 4,
+	[WAC_OP_ADD_T]			= 3,
+	[WAC_OP_ADD_R]			= 3,
+	[WAC_OP_SUB_T]			= 3,
+	[WAC_OP_SUB_R]			= 3,
+	[WAC_OP_MUL_T]			= 3,
+	[WAC_OP_MUL_R]			= 3,
+	[WAC_OP_DIV_T]			= 3,
+	[WAC_OP_DIV_R]			= 3,
+	[WAC_OP_EQUAL_T]		= 3,
+	[WAC_OP_EQUAL_R]		= 3,
+	[WAC_OP_GREATER_T]		= 3,
+	[WAC_OP_GREATER_R]		= 3,
+	[WAC_OP_LESS_T]			= 3,
+	[WAC_OP_LESS_R]			= 3,
+	[WAC_OP_GET_LOCAL_2]		= 2,
+	[WAC_OP_GET_LOCAL_CONST]	= 2,
+	[WAC_OP_GET_LOCAL_PROPERTY]	= 3,
+	[WAC_OP_SET_LOCAL_POP]		= 1,
+	[WAC_OP_EQUAL_JMP_FALSE]	= 2,
+	[WAC_OP_NOT_EQUAL_JMP_FALSE]	= 2,
+	[WAC_OP_GREATER_JMP_FALSE]	= 2,
+	[WAC_OP_GREATER_EQUAL_JMP_FALSE]	= 2,
+	[WAC_OP_LESS_JMP_FALSE]		= 2,
+	[WAC_OP_LESS_EQUAL_JMP_FALSE]	= 2,
+	[WAC_OP_CALL_CLOSURE_EXACT_ARITY]	= 1,
+	[WAC_OP_CALL_CLOSURE_EXACT_ARITY_LONG]	= 4,
+	[WAC_OP_GREATER_II_JMP_FALSE]	= 2,
+	[WAC_OP_GREATER_EQUAL_II_JMP_FALSE]	= 2,
+	[WAC_OP_LESS_II_JMP_FALSE]	= 2,
+	[WAC_OP_LESS_EQUAL_II_JMP_FALSE]	= 2,
+	[WAC_OP_GREATER_DD_JMP_FALSE]	= 2,
+	[WAC_OP_GREATER_EQUAL_DD_JMP_FALSE]	= 2,
+	[WAC_OP_LESS_DD_JMP_FALSE]	= 2,
+	[WAC_OP_LESS_EQUAL_DD_JMP_FALSE]	= 2,
+};
+
+//size of instruction at address including operands
+//closure is followed by upval descriptors of variable size
+size_t wac_page_inst_size(wac_page_t *page, size_t address) {
+	uint8_t op = page->code[address];
+	size_t size, i;
+	wac_obj_fun_t *fun;
+
+	if (op != WAC_OP_CLOSURE && op != WAC_OP_CLOSURE_LONG) {
+		return 1 + (op < sizeof(wac_page_operandSize) ? wac_page_operandSize[op] : 0);
+	}
+
+	if (op == WAC_OP_CLOSURE) {
+		fun = WAC_OBJ_AS_FUN(page->consts.values[page->code[address + 1]]);
+		size = 2;
+	} else {
+		fun = WAC_OBJ_AS_FUN(page->consts.values[
+			((uint32_t)page->code[address + 1] << 24) | (page->code[address + 2] << 16) | (page->code[address + 3] << 8) | page->code[address + 4]
+		]);
+		size = 5;
+	}
+
+	for (i = 0; i < fun->upvals_usize; ++i) {
+		size += 1 + ((page->code[address + size] & WAC_UPVAL_LONG) ? 4 : 1);
+	}
+	return size;
+}
+
+//made empty by the compiler, instruction fills it when it runs
+uint32_t wac_page_addPropertyCache(wac_state_t *state, wac_page_t *page) {
+	if (page->props_asize <= page->props_usize) {
+		size_t oldSize = page->props_asize;
+		page->props_asize = oldSize ? oldSize * WAC_ARRAY_GROW_MUL : WAC_ARRAY_DEFAULT_SIZE;
+		page->props = WAC_ARRAY_GROW(state, wac_page_propertyCache_t, page->props, oldSize, page->props_asize);
+	}
+
+	page->props[page->props_usize].usize = 0;
+	return page->props_usize++;
+}
+
+//line for code inlined from fun, reuses the last entry when it is the same
+size_t wac_page_addInlined(wac_state_t *state, wac_page_t *page, struct wac_obj_fun_s *fun, size_t line, size_t at) {
+	wac_page_inlined_t *last = page->inlined_usize ? &page->inlined[page->inlined_usize - 1] : NULL;
+	if (last && last->fun == fun && last->line == line && last->at == at) return WAC_PAGE_LINE_INLINED | (page->inlined_usize - 1);
+
+	if (page->inlined_asize <= page->inlined_usize) {
+		size_t oldSize = page->inlined_asize;
+		page->inlined_asize = oldSize ? oldSize * WAC_ARRAY_GROW_MUL : WAC_ARRAY_DEFAULT_SIZE;
+		page->inlined = WAC_ARRAY_GROW(state, wac_page_inlined_t, page->inlined, oldSize, page->inlined_asize);
+	}
+
+	page->inlined[page->inlined_usize].fun = fun;
+	page->inlined[page->inlined_usize].line = line;
+	page->inlined[page->inlined_usize].at = at;
+	return WAC_PAGE_LINE_INLINED | page->inlined_usize++;
+}
+
+//source line of the instruction at address, for inlined code the line of the call
+size_t wac_page_line(wac_page_t *page, size_t address) {
+	size_t line = page->lines[address];
+	if (line & WAC_PAGE_LINE_INLINED) return page->inlined[line & ~WAC_PAGE_LINE_INLINED].at;
+	return line;
+}
+
+//where the jump at address lands, WAC_PAGE_NO_TARGET for other instructions
+size_t wac_page_inst_target(wac_page_t *page, size_t address) {
+	uint8_t *code = page->code + address;
+	switch (code[0]) {
+		case WAC_OP_JMP_FORW:
+		case WAC_OP_JMP_TRUE:
+		case WAC_OP_JMP_FALSE:
+		case WAC_OP_EQUAL_JMP_FALSE:
+		case WAC_OP_NOT_EQUAL_JMP_FALSE:
+		case WAC_OP_GREATER_JMP_FALSE:
+		case WAC_OP_GREATER_EQUAL_JMP_FALSE:
+		case WAC_OP_LESS_JMP_FALSE:
+		case WAC_OP_LESS_EQUAL_JMP_FALSE:
+		case WAC_OP_GREATER_II_JMP_FALSE:
+		case WAC_OP_GREATER_EQUAL_II_JMP_FALSE:
+		case WAC_OP_LESS_II_JMP_FALSE:
+		case WAC_OP_LESS_EQUAL_II_JMP_FALSE:
+		case WAC_OP_GREATER_DD_JMP_FALSE:
+		case WAC_OP_GREATER_EQUAL_DD_JMP_FALSE:
+		case WAC_OP_LESS_DD_JMP_FALSE:
+		case WAC_OP_LESS_EQUAL_DD_JMP_FALSE:
+			return address + 3 + ((code[1] << 8) | code[2]);
+		case WAC_OP_JMP_FORW_LONG:
+		case WAC_OP_JMP_TRUE_LONG:
+		case WAC_OP_JMP_FALSE_LONG:
+			return address + 5 + (((uint32_t)code[1] << 24) | (code[2] << 16) | (code[3] << 8) | code[4]);
+		case WAC_OP_CALL_INLINE:
+			return address + 5 + ((code[3] << 8) | code[4]);
+		case WAC_OP_JMP_BACK:
+			return address + 2 - code[1];
+		case WAC_OP_JMP_BACK_LONG:
+			return address + 5 - (((uint32_t)code[1] << 24) | (code[2] << 16) | (code[3] << 8) | code[4]);
+		default:
+			return WAC_PAGE_NO_TARGET;
+	}
+}
+
+//jumps that always jump and RET, nothing falls through them
+bool wac_page_isExit(uint8_t op) {
+	return op == WAC_OP_JMP_FORW || op == WAC_OP_JMP_FORW_LONG || op == WAC_OP_JMP_BACK || op == WAC_OP_JMP_BACK_LONG || op == WAC_OP_RET;
+}
+
+//jumps that do nothing else, fused compares and CALL_INLINE also change the stack
+bool wac_page_isJump(uint8_t op) {
+	switch (op) {
+		case WAC_OP_JMP_FORW:
+		case WAC_OP_JMP_BACK:
+		case WAC_OP_JMP_BACK_LONG:
+		case WAC_OP_JMP_TRUE:
+		case WAC_OP_JMP_FALSE:
+		case WAC_OP_JMP_FORW_LONG:
+		case WAC_OP_JMP_TRUE_LONG:
+		case WAC_OP_JMP_FALSE_LONG:
+			return true;
+		default:
+			return false;
+	}
+}
+
 void wac_page_free(wac_state_t *state, wac_page_t *page) {
 	WAC_ARRAY_FREE(state, uint8_t, page->code, page->asize);
 	WAC_ARRAY_FREE(state, size_t, page->lines, page->asize);
 	page->asize = 0;
 	page->usize = 0;
 	page->code = NULL;
+	WAC_ARRAY_FREE(state, wac_page_propertyCache_t, page->props, page->props_asize);
+	page->props_asize = 0;
+	page->props_usize = 0;
+	page->props = NULL;
+	WAC_ARRAY_FREE(state, wac_page_inlined_t, page->inlined, page->inlined_asize);
+	page->inlined_asize = 0;
+	page->inlined_usize = 0;
+	page->inlined = NULL;
 	wac_valarr_free(state, &page->consts);
 }
@@ -3,31 +3,61 @@
 
 #include "wac_common.h"
 #include "wac_value.h"
+#include "wac_shape.h"
 
 typedef struct wac_vm_s wac_vm_t;
 
+//opcodes with index/count operand have 1 byte operand
+//and are directly followed by their _LONG form with 4 byte operand
+//(with more operands, all are 1 byte or all are 4 bytes)
+//forward jumps have 2 byte operand
 typedef enum wac_opCode_e {
 	WAC_OP_CONST,
+	WAC_OP_CONST_LONG,
 	WAC_OP_NULL,
 	WAC_OP_TRUE,
 	WAC_OP_FALSE,
 	WAC_OP_CLOSURE,
+	WAC_OP_CLOSURE_LONG,
 	WAC_OP_CLASS,
+	WAC_OP_CLASS_LONG,
 	WAC_OP_METHOD,
+	WAC_OP_METHOD_LONG,
+	//subclass on top of superclass, copies methods of superclass down to subclass
+	WAC_OP_INHERIT,
 
 	WAC_OP_POP,
 	WAC_OP_POPN,
+	WAC_OP_POPN_LONG,
 
 	WAC_OP_GET_LOCAL,
+	WAC_OP_GET_LOCAL_LONG,
 	WAC_OP_SET_LOCAL,
+	WAC_OP_SET_LOCAL_LONG,
 	WAC_OP_GET_UPVAL,
+	WAC_OP_GET_UPVAL_LONG,
 	WAC_OP_SET_UPVAL,
+	WAC_OP_SET_UPVAL_LONG,
 	WAC_OP_GET_GLOBAL,
+	WAC_OP_GET_GLOBAL_LONG,
 	WAC_OP_SET_GLOBAL,
+	WAC_OP_SET_GLOBAL_LONG,
+	//operand is index into page->props, name is on the stack, for obj[expr]
 	WAC_OP_GET_PROPERTY,
+	WAC_OP_GET_PROPERTY_LONG,
 	WAC_OP_SET_PROPERTY,
+	WAC_OP_SET_PROPERTY_LONG,
+	//operands are name constant and index into page->props, for obj.name
+	WAC_OP_GET_PROPERTY_CONST,
+	WAC_OP_GET_PROPERTY_CONST_LONG,
+	WAC_OP_SET_PROPERTY_CONST,
+	WAC_OP_SET_PROPERTY_CONST_LONG,
+	//same operands, for super.name with superclass on top of this
+	WAC_OP_GET_SUPER,
+	WAC_OP_GET_SUPER_LONG,
 	WAC_OP_CLOSE_UPVAL,
 	WAC_OP_DEFINE_GLOBAL,
+	WAC_OP_DEFINE_GLOBAL_LONG,
 
 	WAC_OP_NOT,
 	WAC_OP_EQUAL,
@@ -38,29 +68,181 @@ typedef enum wac_opCode_e {
 	WAC_OP_SUB,
 	WAC_OP_MUL,
 	WAC_OP_DIV,
+	WAC_OP_MOD,
+	WAC_OP_IDIV,
+	WAC_OP_BAND,
+	WAC_OP_BOR,
+	WAC_OP_BXOR,
+	WAC_OP_SHL,
+	WAC_OP_SHR,
+	WAC_OP_BNOT,
 
 	WAC_OP_JMP_FORW,
 	WAC_OP_JMP_BACK,
+	WAC_OP_JMP_BACK_LONG,
 	WAC_OP_JMP_TRUE,
 	WAC_OP_JMP_FALSE,
+	//4 byte offset, the compiler writes these and wac_peephole_shrinkJumps
+	//turns every one that reaches its target into the 2 byte form above
+	WAC_OP_JMP_FORW_LONG,
+	WAC_OP_JMP_TRUE_LONG,
+	WAC_OP_JMP_FALSE_LONG,
 
 	WAC_OP_CALL,
+	WAC_OP_CALL_LONG,
+	//operands are name constant and argc
 	WAC_OP_INVOKE,
+	WAC_OP_INVOKE_LONG,
+	//CALL of return f(...), reuses the frame of the caller when f is a closure
+	WAC_OP_TAIL_CALL,
+	WAC_OP_TAIL_CALL_LONG,
+	//operands are name constant, argc and index into page->props, superclass is on top of args
+	WAC_OP_SUPER_INVOKE,
+	WAC_OP_SUPER_INVOKE_LONG,
+	//operands are closure constant, argc (1 byte each) and 2 byte forward jump
+	//falls into the inlined body of the closure when it is the callee, or a class with it as init
+	//otherwise calls and jumps over it
+	WAC_OP_CALL_INLINE,
+	//end of inlined body, result replaces the callee and operand is count of values dropped under it
+	WAC_OP_RET_INLINE,
+	WAC_OP_RET_INLINE_LONG,
+	//operands are slot of local, slot of field, name constant and index into page->props (1 byte each)
+	//field of a scalar replaced instance, kept in the slot until the local holds a real instance
+	WAC_OP_GET_SCALAR,
+	WAC_OP_GET_SCALAR_LONG,
+	WAC_OP_SET_SCALAR,
+	WAC_OP_SET_SCALAR_LONG,
 
 	WAC_OP_RET,
+
+	//register ops for the register backend, operands are 1 byte each
+	//_T: op A B C, bp[A] = RK(B) op RK(C) and bp[A] becomes top of the stack
+	//_R: op A B C, bp[A] = RK(B) op RK(C), stack is left as is
+	WAC_OP_ADD_T,
+	WAC_OP_SUB_T,
+	WAC_OP_MUL_T,
+	WAC_OP_DIV_T,
+	WAC_OP_EQUAL_T,
+	WAC_OP_GREATER_T,
+	WAC_OP_LESS_T,
+	WAC_OP_ADD_R,
+	WAC_OP_SUB_R,
+	WAC_OP_MUL_R,
+	WAC_OP_DIV_R,
+	WAC_OP_EQUAL_R,
+	WAC_OP_GREATER_R,
+	WAC_OP_LESS_R,
+
+	//superinstructions, only made by wac_peephole_superinst from short forms
+	//operands are the operands of the fused instructions in order
+	WAC_OP_GET_LOCAL_2,
+	WAC_OP_GET_LOCAL_CONST,
+	WAC_OP_GET_LOCAL_PROPERTY,
+	WAC_OP_SET_LOCAL_POP,
+	WAC_OP_NOT_EQUAL,
+	WAC_OP_GREATER_EQUAL,
+	WAC_OP_LESS_EQUAL,
+	//compare, JMP_FALSE, POP
+	WAC_OP_EQUAL_JMP_FALSE,
+	WAC_OP_NOT_EQUAL_JMP_FALSE,
+	WAC_OP_GREATER_JMP_FALSE,
+	WAC_OP_GREATER_EQUAL_JMP_FALSE,
+	WAC_OP_LESS_JMP_FALSE,
+	WAC_OP_LESS_EQUAL_JMP_FALSE,
+
+	//quickened ops, written over the generic op by wac_vm_run when it sees the operands
+	//each checks what it assumes and if it does not hold, rewrites itself back
+	WAC_OP_ADD_NUM_NUM,
+	WAC_OP_LESS_NUM,
+	WAC_OP_ADD_INT_INT,
+	WAC_OP_LESS_INT,
+	WAC_OP_CALL_CLOSURE_EXACT_ARITY,
+	WAC_OP_CALL_CLOSURE_EXACT_ARITY_LONG,
+
+	//typed ops, written by wac_infer_types where operands are proven
+	//ints (_II) or doubles (_DD), they do not check anything
+	WAC_OP_ADD_II,
+	WAC_OP_SUB_II,
+	WAC_OP_MUL_II,
+	WAC_OP_ADD_DD,
+	WAC_OP_SUB_DD,
+	WAC_OP_MUL_DD,
+	WAC_OP_DIV_DD,
+	WAC_OP_GREATER_II_JMP_FALSE,
+	WAC_OP_GREATER_EQUAL_II_JMP_FALSE,
+	WAC_OP_LESS_II_JMP_FALSE,
+	WAC_OP_LESS_EQUAL_II_JMP_FALSE,
+	WAC_OP_GREATER_DD_JMP_FALSE,
+	WAC_OP_GREATER_EQUAL_DD_JMP_FALSE,
+	WAC_OP_LESS_DD_JMP_FALSE,
+	WAC_OP_LESS_EQUAL_DD_JMP_FALSE,
 } wac_opCode_t;
 
+//RK operand of register op, either slot bp[x] or constant K[x & ~WAC_RK_CONST]
+#define WAC_RK_CONST		0x80
+#define WAC_RK_INDEX_MAX	0x7F
+
+#define WAC_PAGE_NO_TARGET ((size_t)(-1))
+
+//flags of upval descriptor after WAC_OP_CLOSURE
+#define WAC_UPVAL_LOCAL	0x01
+#define WAC_UPVAL_LONG	0x02
+//local is never assigned, so the closure gets a closed upval with its value
+#define WAC_UPVAL_COPY	0x04
+
+//entry of the cache of WAC_OP_GET_PROPERTY and WAC_OP_SET_PROPERTY for instances with shape
+//field entries have key in slot, for SET_PROPERTY next is the shape after the key is added
+//(NULL when it is already there), method entries have method of klass with its version
+typedef struct wac_page_propertyEntry_s {
+	wac_shape_t *shape, *next;
+	struct wac_obj_string_s *key;
+	struct wac_obj_class_s *klass;
+	struct wac_obj_closure_s *method;
+	uint32_t version;
+	size_t slot;
+} wac_page_propertyEntry_t;
+
+//polymorphic inline cache, once the instruction sees more than WAC_PAGE_PIC_SIZE
+//shapes, usize goes over it and the instruction does only the full lookup
+#define WAC_PAGE_PIC_SIZE 4
+
+typedef struct wac_page_propertyCache_s {
+	size_t usize;
+	wac_page_propertyEntry_t entries[WAC_PAGE_PIC_SIZE];
+} wac_page_propertyCache_t;
+
+//line of code inlined from fun, at is the line of the call
+typedef struct wac_page_inlined_s {
+	struct wac_obj_fun_s *fun;
+	size_t line, at;
+} wac_page_inlined_t;
+
+//lines of inlined code have this bit with index into page->inlined
+#define WAC_PAGE_LINE_INLINED ((size_t)1 << (sizeof(size_t) * 8 - 1))
+
 typedef struct wac_page_s {
 	size_t asize, usize;
 	uint8_t *code;
 	size_t *lines;
 	wac_valarr_t consts;
+	size_t props_asize, props_usize;
+	wac_page_propertyCache_t *props;
+	size_t inlined_asize, inlined_usize;
+	wac_page_inlined_t *inlined;
 } wac_page_t;
 
 void wac_page_init(wac_state_t *state, wac_page_t *page);
 void wac_page_write_byte(wac_state_t *state, wac_page_t *page, uint8_t byte, size_t line);
 uint32_t wac_page_addConst(wac_state_t *state, wac_page_t *page, wac_value_t value);
-void wac_page_write_4bytes(wac_state_t *state, wac_page_t *page, uint32_t constant, size_t line);
+void wac_page_write_2bytes(wac_state_t *state, wac_page_t *page, uint16_t bytes, size_t line);
+void wac_page_write_4bytes(wac_state_t *state, wac_page_t *page, uint32_t bytes, size_t line);
+size_t wac_page_inst_size(wac_page_t *page, size_t address);
+size_t wac_page_inst_target(wac_page_t *page, size_t address);
+bool wac_page_isExit(uint8_t op);
+bool wac_page_isJump(uint8_t op);
+uint32_t wac_page_addPropertyCache(wac_state_t *state, wac_page_t *page);
+size_t wac_page_addInlined(wac_state_t *state, wac_page_t *page, struct wac_obj_fun_s *fun, size_t line, size_t at);
+size_t wac_page_line(wac_page_t *page, size_t address);
 void wac_page_free(wac_state_t *state, wac_page_t *page);
 
 #endif //__WAC_PAGE_H
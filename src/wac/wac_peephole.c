@@ -0,0 +1,678 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "wac_state.h"
+#include "wac_peephole.h"
+#include "wac_object.h"
+#include "wac_memory.h"
+
+#define WAC_PEEPHOLE_RULE_MAX 4
+#define WAC_PEEPHOLE_INST_MAX 16
+//jumps followed when threading, so a jump to itself ends
+#define WAC_PEEPHOLE_THREAD_MAX 8
+
+typedef struct wac_peephole_rule_s {
+	uint8_t ops[WAC_PEEPHOLE_RULE_MAX];
+	size_t len;
+	uint8_t fused;
+} wac_peephole_rule_t;
+
+//first matching rule wins, so longer ones go first
+//picked by opcode n-gram counts, see WAC_DEBUG_PROFILE_OPS
+static const wac_peephole_rule_t wac_peephole_rules[] = {
+	{{WAC_OP_EQUAL, WAC_OP_NOT, WAC_OP_JMP_FALSE, WAC_OP_POP},	4, WAC_OP_NOT_EQUAL_JMP_FALSE},
+	{{WAC_OP_GREATER, WAC_OP_NOT, WAC_OP_JMP_FALSE, WAC_OP_POP},	4, WAC_OP_LESS_EQUAL_JMP_FALSE},
+	{{WAC_OP_LESS, WAC_OP_NOT, WAC_OP_JMP_FALSE, WAC_OP_POP},	4, WAC_OP_GREATER_EQUAL_JMP_FALSE},
+	{{WAC_OP_EQUAL, WAC_OP_JMP_FALSE, WAC_OP_POP},			3, WAC_OP_EQUAL_JMP_FALSE},
+	{{WAC_OP_GREATER, WAC_OP_JMP_FALSE, WAC_OP_POP},		3, WAC_OP_GREATER_JMP_FALSE},
+	{{WAC_OP_LESS, WAC_OP_JMP_FALSE, WAC_OP_POP},			3, WAC_OP_LESS_JMP_FALSE},
+	{{WAC_OP_EQUAL, WAC_OP_NOT},					2, WAC_OP_NOT_EQUAL},
+	{{WAC_OP_GREATER, WAC_OP_NOT},					2, WAC_OP_LESS_EQUAL},
+	{{WAC_OP_LESS, WAC_OP_NOT},					2, WAC_OP_GREATER_EQUAL},
+	{{WAC_OP_GET_LOCAL, WAC_OP_GET_PROPERTY_CONST},			2, WAC_OP_GET_LOCAL_PROPERTY},
+	{{WAC_OP_GET_LOCAL, WAC_OP_GET_LOCAL},				2, WAC_OP_GET_LOCAL_2},
+	{{WAC_OP_GET_LOCAL, WAC_OP_CONST},				2, WAC_OP_GET_LOCAL_CONST},
+	{{WAC_OP_CONST, WAC_OP_GET_PROPERTY},				2, WAC_OP_GET_PROPERTY_CONST},
+	{{WAC_OP_SET_LOCAL, WAC_OP_POP},				2, WAC_OP_SET_LOCAL_POP},
+};
+
+//only the first instruction of the sequence can be a jump target
+static bool wac_peephole_match(wac_page_t *page, const bool *labels, size_t address, const wac_peephole_rule_t *rule) {
+	size_t i;
+	for (i = 0; i < rule->len; ++i) {
+		if (address >= page->usize || page->code[address] != rule->ops[i]) return false;
+		if (i > 0 && labels[address]) return false;
+		//obj[1] has to stay, so GET_PROPERTY reports the error
+		if (rule->ops[i] == WAC_OP_CONST && i + 1 < rule->len && rule->ops[i + 1] == WAC_OP_GET_PROPERTY
+			&& !WAC_OBJ_IS_STRING(page->consts.values[page->code[address + 1]])
+		) return false;
+		address += wac_page_inst_size(page, address);
+	}
+	return true;
+}
+
+//points the jump at address to target, false when its encoding can't reach it
+bool wac_peephole_retarget(wac_page_t *page, size_t address, size_t target) {
+	uint8_t *inst = page->code + address;
+	if (inst[0] == WAC_OP_JMP_BACK) {
+		if (target > address + 2 || address + 2 - target > 0xFF) return false;
+		inst[1] = (uint8_t)(address + 2 - target);
+	} else if (inst[0] == WAC_OP_JMP_BACK_LONG) {
+		if (target > address + 5) return false;
+		uint32_t offset = (uint32_t)(address + 5 - target);
+		inst[1] = (offset & 0xFF000000) >> 24;
+		inst[2] = (offset & 0x00FF0000) >> 16;
+		inst[3] = (offset & 0x0000FF00) >> 8;
+		inst[4] = (offset & 0x000000FF);
+	} else if (inst[0] == WAC_OP_JMP_FORW_LONG || inst[0] == WAC_OP_JMP_TRUE_LONG || inst[0] == WAC_OP_JMP_FALSE_LONG) {
+		if (target < address + 5) return false;
+		uint32_t offset = (uint32_t)(target - address - 5);
+		inst[1] = (offset & 0xFF000000) >> 24;
+		inst[2] = (offset & 0x00FF0000) >> 16;
+		inst[3] = (offset & 0x0000FF00) >> 8;
+		inst[4] = (offset & 0x000000FF);
+	} else if (inst[0] == WAC_OP_CALL_INLINE) {
+		if (target < address + 5 || target - address - 5 > 0xFFFF) return false;
+		uint16_t offset = (uint16_t)(target - address - 5);
+		inst[3] = (offset & 0xFF00) >> 8;
+		inst[4] = (offset & 0x00FF);
+	} else {
+		if (target < address + 3 || target - address - 3 > 0xFFFF) return false;
+		uint16_t offset = (uint16_t)(target - address - 3);
+		inst[1] = (offset & 0xFF00) >> 8;
+		inst[2] = (offset & 0x00FF);
+	}
+	return true;
+}
+
+//rewrites sequences from wac_peephole_rules into single instructions
+//code only shrinks, so it is rewritten in place and jumps are patched after
+void wac_peephole_superinst(wac_page_t *page) {
+	size_t size = page->usize, from, to = 0, target, n, i, j, fixups_usize = 0;
+	bool *labels = WAC_ARRAY_INIT_NOGC(bool, size + 1);
+	size_t *map = WAC_ARRAY_INIT_NOGC(size_t, size + 1);
+	size_t *fixups = WAC_ARRAY_INIT_NOGC(size_t, size);
+	size_t *targets = WAC_ARRAY_INIT_NOGC(size_t, size);
+	uint8_t code[WAC_PEEPHOLE_INST_MAX];
+	size_t lines[WAC_PEEPHOLE_INST_MAX];
+	const wac_peephole_rule_t *rule;
+
+	if (!labels || !map || !fixups || !targets) {
+		fprintf(stderr, "[-] Failed to allocate memory for peephole\n");
+		exit(1);
+	}
+
+	memset(labels, 0, sizeof(bool) * (size + 1));
+	for (from = 0; from < size; from += wac_page_inst_size(page, from)) {
+		target = wac_page_inst_target(page, from);
+		if (target != WAC_PAGE_NO_TARGET) labels[target] = true;
+	}
+
+	for (from = 0; from < size; ) {
+		map[from] = to;
+
+		rule = NULL;
+		for (i = 0; i < sizeof(wac_peephole_rules) / sizeof(wac_peephole_rules[0]); ++i) {
+			if (wac_peephole_match(page, labels, from, &wac_peephole_rules[i])) {
+				rule = &wac_peephole_rules[i];
+				break;
+			}
+		}
+
+		if (!rule) {
+			n = wac_page_inst_size(page, from);
+			target = wac_page_inst_target(page, from);
+			if (target != WAC_PAGE_NO_TARGET) {
+				fixups[fixups_usize] = to;
+				targets[fixups_usize++] = target;
+			}
+			memmove(page->code + to, page->code + from, n);
+			memmove(page->lines + to, page->lines + from, sizeof(size_t) * n);
+			from += n;
+			to += n;
+			continue;
+		}
+
+		//built aside, coz it can overlap instructions it replaces
+		code[0] = rule->fused;
+		lines[0] = page->lines[from];
+		n = 1;
+		for (i = 0; i < rule->len; ++i) {
+			size_t instSize = wac_page_inst_size(page, from);
+			target = wac_page_inst_target(page, from);
+			if (target != WAC_PAGE_NO_TARGET) {
+				fixups[fixups_usize] = to;
+				targets[fixups_usize++] = target;
+			}
+			for (j = 1; j < instSize; ++j, ++n) {
+				code[n] = page->code[from + j];
+				lines[n] = page->lines[from + j];
+			}
+			from += instSize;
+		}
+		memcpy(page->code + to, code, n);
+		memcpy(page->lines + to, lines, sizeof(size_t) * n);
+		to += n;
+	}
+	map[size] = to;
+
+	for (i = 0; i < fixups_usize; ++i) {
+		wac_peephole_retarget(page, fixups[i], map[targets[i]]);
+	}
+
+	page->usize = to;
+
+	free(labels);
+	free(map);
+	free(fixups);
+	free(targets);
+}
+
+static bool wac_peephole_isPop(uint8_t op) {
+	return op == WAC_OP_POP || op == WAC_OP_POPN || op == WAC_OP_POPN_LONG;
+}
+
+//value loaded by the instruction at address, false if it is not a constant load
+static bool wac_peephole_constValue(wac_page_t *page, size_t address, wac_value_t *value) {
+	uint8_t *inst = page->code + address;
+	switch (inst[0]) {
+		case WAC_OP_CONST: *value = page->consts.values[inst[1]]; return true;
+		case WAC_OP_CONST_LONG: *value = page->consts.values[((uint32_t)inst[1] << 24) | (inst[2] << 16) | (inst[3] << 8) | inst[4]]; return true;
+		case WAC_OP_NULL: *value = WAC_VAL_NULL; return true;
+		case WAC_OP_TRUE: *value = WAC_VAL_BOOL(true); return true;
+		case WAC_OP_FALSE: *value = WAC_VAL_BOOL(false); return true;
+		default: return false;
+	}
+}
+
+//falsey of the value loaded by the instruction at address, false if it is not a constant load
+static bool wac_peephole_constLoad(wac_page_t *page, size_t address, bool *falsey) {
+	wac_value_t value;
+	if (!wac_peephole_constValue(page, address, &value)) return false;
+	*falsey = wac_value_falsey(value);
+	return true;
+}
+
+//result of unary op on constant a, false when the vm would report an error
+//folding has to give exactly what the vm computes, see wac_vm_run
+bool wac_peephole_fold_unary(uint8_t op, wac_value_t a, wac_value_t *result) {
+	int64_t x;
+	switch (op) {
+		case WAC_OP_NOT:
+			*result = WAC_VAL_BOOL(wac_value_falsey(a));
+			return true;
+		case WAC_OP_NEG:
+			if (WAC_VAL_IS_INT(a)) {
+				*result = WAC_VAL_INT(WAC_INT_WRAP(0, -, WAC_VAL_AS_INT(a)));
+				return true;
+			}
+			if (!WAC_VAL_IS_NUMBER(a)) return false;
+			*result = WAC_VAL_NUMBER(-WAC_VAL_AS_NUMBER(a));
+			return true;
+		case WAC_OP_BNOT:
+			if (!wac_value_toInt(a, &x)) return false;
+			*result = WAC_VAL_INT(~x);
+			return true;
+		default:
+			return false;
+	}
+}
+
+//same for binary op, a concat of strings is interned like wac_vm_concat does
+//a and b have to be reachable by gc, the result is only held by the caller
+bool wac_peephole_fold_binary(wac_state_t *state, uint8_t op, wac_value_t a, wac_value_t b, wac_value_t *result) {
+	int64_t i, j;
+
+	switch (op) {
+		case WAC_OP_EQUAL:
+			*result = WAC_VAL_BOOL(wac_value_equal(a, b));
+			return true;
+		case WAC_OP_BAND:
+		case WAC_OP_BOR:
+		case WAC_OP_BXOR:
+		case WAC_OP_SHL:
+		case WAC_OP_SHR:
+			if (!wac_value_toInt(a, &i) || !wac_value_toInt(b, &j)) return false;
+			switch (op) {
+				case WAC_OP_BAND: *result = WAC_VAL_INT(i & j); break;
+				case WAC_OP_BOR: *result = WAC_VAL_INT(i | j); break;
+				case WAC_OP_BXOR: *result = WAC_VAL_INT(i ^ j); break;
+				case WAC_OP_SHL: *result = WAC_VAL_INT(wac_vm_shl(i, j)); break;
+				default: *result = WAC_VAL_INT(wac_vm_shl(i, j <= -64 ? 64 : -j)); break;
+			}
+			return true;
+		case WAC_OP_ADD:
+			if (WAC_OBJ_IS_STRING(a) && WAC_OBJ_IS_STRING(b)) {
+				wac_obj_string_t *x = WAC_OBJ_AS_STRING(a), *y = WAC_OBJ_AS_STRING(b);
+				size_t len = x->len + y->len;
+				char *buf = WAC_ARRAY_INIT(state, char, len + 1);
+				memcpy(buf, x->buf, x->len);
+				memcpy(buf + x->len, y->buf, y->len);
+				buf[len] = '\0';
+				*result = WAC_VAL_OBJ(wac_obj_string_take(state, buf, len));
+				return true;
+			}
+			break;
+		default:
+			break;
+	}
+
+	if (WAC_VAL_IS_INT(a) && WAC_VAL_IS_INT(b)) {
+		int64_t x = WAC_VAL_AS_INT(a), y = WAC_VAL_AS_INT(b);
+		switch (op) {
+			case WAC_OP_ADD: *result = WAC_VAL_INT(WAC_INT_WRAP(x, +, y)); return true;
+			case WAC_OP_SUB: *result = WAC_VAL_INT(WAC_INT_WRAP(x, -, y)); return true;
+			case WAC_OP_MUL: *result = WAC_VAL_INT(WAC_INT_WRAP(x, *, y)); return true;
+			case WAC_OP_DIV: *result = WAC_VAL_NUMBER((double)x / (double)y); return true;
+			case WAC_OP_MOD:
+				if (y == 0) return false;
+				*result = WAC_VAL_INT(y == -1 ? 0 : x % y);
+				return true;
+			case WAC_OP_IDIV:
+				if (y == 0) return false;
+				*result = WAC_VAL_INT(y == -1 ? WAC_INT_WRAP(0, -, x) : x / y);
+				return true;
+			case WAC_OP_GREATER: *result = WAC_VAL_BOOL(x > y); return true;
+			case WAC_OP_LESS: *result = WAC_VAL_BOOL(x < y); return true;
+			default: return false;
+		}
+	}
+
+	if (WAC_VAL_IS_NUMERIC(a) && WAC_VAL_IS_NUMERIC(b)) {
+		double x = WAC_VAL_TO_NUMBER(a), y = WAC_VAL_TO_NUMBER(b);
+		switch (op) {
+			case WAC_OP_ADD: *result = WAC_VAL_NUMBER(x + y); return true;
+			case WAC_OP_SUB: *result = WAC_VAL_NUMBER(x - y); return true;
+			case WAC_OP_MUL: *result = WAC_VAL_NUMBER(x * y); return true;
+			case WAC_OP_DIV: *result = WAC_VAL_NUMBER(x / y); return true;
+			case WAC_OP_MOD: *result = WAC_VAL_NUMBER(fmod(x, y)); return true;
+			case WAC_OP_IDIV: *result = WAC_VAL_NUMBER(trunc(x / y)); return true;
+			case WAC_OP_GREATER: *result = WAC_VAL_BOOL(x > y); return true;
+			case WAC_OP_LESS: *result = WAC_VAL_BOOL(x < y); return true;
+			default: return false;
+		}
+	}
+
+	return false;
+}
+
+//stack op of register op with _T form
+static const uint8_t wac_peephole_regOps[] = {
+	[WAC_OP_ADD_T - WAC_OP_ADD_T]		= WAC_OP_ADD,
+	[WAC_OP_SUB_T - WAC_OP_ADD_T]		= WAC_OP_SUB,
+	[WAC_OP_MUL_T - WAC_OP_ADD_T]		= WAC_OP_MUL,
+	[WAC_OP_DIV_T - WAC_OP_ADD_T]		= WAC_OP_DIV,
+	[WAC_OP_EQUAL_T - WAC_OP_ADD_T]		= WAC_OP_EQUAL,
+	[WAC_OP_GREATER_T - WAC_OP_ADD_T]	= WAC_OP_GREATER,
+	[WAC_OP_LESS_T - WAC_OP_ADD_T]		= WAC_OP_LESS,
+};
+
+//writes load of value to code, 0 when it takes more than max bytes
+//value goes through the pool of wac_compiler_addConst, so folding the same value twice adds it once
+//a value added for a load that then does not fit just stays unused
+static size_t wac_peephole_fold_load(wac_state_t *state, wac_value_t value, uint8_t *code, size_t max) {
+	uint32_t k;
+
+	if (WAC_VAL_IS_NULL(value) || WAC_VAL_IS_BOOL(value)) {
+		code[0] = WAC_VAL_IS_NULL(value) ? WAC_OP_NULL : WAC_VAL_AS_BOOL(value) ? WAC_OP_TRUE : WAC_OP_FALSE;
+		return 1;
+	}
+
+	k = wac_compiler_addConst(state, value);
+	if (k > 0xFF ? max < 5 : max < 2) return 0;
+
+	if (k > 0xFF) {
+		code[0] = WAC_OP_CONST_LONG;
+		code[1] = (k & 0xFF000000) >> 24;
+		code[2] = (k & 0x00FF0000) >> 16;
+		code[3] = (k & 0x0000FF00) >> 8;
+		code[4] = (k & 0x000000FF);
+		return 5;
+	}
+	code[0] = WAC_OP_CONST;
+	code[1] = (uint8_t)k;
+	return 2;
+}
+
+//constant loads and the op using them become a load of the result, see wac_peephole_fold_binary
+//loads keeps where the run of constant loads at the end of the new code starts, so results fold again
+//like 1 + 2 * 3, code only shrinks and jumps are patched after like in wac_peephole_superinst
+static void wac_peephole_fold(wac_state_t *state, wac_page_t *page) {
+	size_t size = page->usize, from, to = 0, at, used, target, n, m, i, fixups_usize = 0, loads_usize = 0;
+	bool *labels = WAC_ARRAY_INIT_NOGC(bool, size + 1);
+	size_t *map = WAC_ARRAY_INIT_NOGC(size_t, size + 1);
+	size_t *fixups = WAC_ARRAY_INIT_NOGC(size_t, size);
+	size_t *targets = WAC_ARRAY_INIT_NOGC(size_t, size);
+	size_t *loads = WAC_ARRAY_INIT_NOGC(size_t, size);
+	uint8_t code[5], op;
+	wac_value_t a, b, result;
+	bool folded;
+
+	if (!labels || !map || !fixups || !targets || !loads) {
+		fprintf(stderr, "[-] Failed to allocate memory for peephole\n");
+		exit(1);
+	}
+
+	memset(labels, 0, sizeof(bool) * (size + 1));
+	for (from = 0; from < size; from += wac_page_inst_size(page, from)) {
+		target = wac_page_inst_target(page, from);
+		if (target != WAC_PAGE_NO_TARGET) labels[target] = true;
+	}
+
+	for (from = 0; from < size; from += n) {
+		map[from] = to;
+		n = wac_page_inst_size(page, from);
+		op = page->code[from];
+		//a jump target starts a new run, so only its first load can be one
+		if (labels[from]) loads_usize = 0;
+
+		folded = false;
+		at = to;
+		used = 0;
+		if (op >= WAC_OP_ADD_T && op <= WAC_OP_LESS_T) {
+			uint8_t x = page->code[from + 2], y = page->code[from + 3];
+			folded = (x & WAC_RK_CONST) && (y & WAC_RK_CONST)
+				&& wac_peephole_fold_binary(state, wac_peephole_regOps[op - WAC_OP_ADD_T], page->consts.values[x & WAC_RK_INDEX_MAX], page->consts.values[y & WAC_RK_INDEX_MAX], &result);
+		} else if (op == WAC_OP_NOT || op == WAC_OP_NEG || op == WAC_OP_BNOT) {
+			if (loads_usize >= 1) {
+				at = loads[loads_usize - 1];
+				used = 1;
+				folded = wac_peephole_constValue(page, at, &a) && wac_peephole_fold_unary(op, a, &result);
+			}
+		} else if (loads_usize >= 2) {
+			at = loads[loads_usize - 2];
+			used = 2;
+			folded = wac_peephole_constValue(page, at, &a)
+				&& wac_peephole_constValue(page, loads[loads_usize - 1], &b)
+				&& wac_peephole_fold_binary(state, op, a, b, &result);
+		}
+
+		m = folded ? wac_peephole_fold_load(state, result, code, to - at + n) : 0;
+		if (m) {
+			size_t line = at < to ? page->lines[at] : page->lines[from];
+			loads_usize -= used;
+			memcpy(page->code + at, code, m);
+			for (i = 0; i < m; ++i) page->lines[at + i] = line;
+			to = at + m;
+			loads[loads_usize++] = at;
+			continue;
+		}
+
+		target = wac_page_inst_target(page, from);
+		if (target != WAC_PAGE_NO_TARGET) {
+			fixups[fixups_usize] = to;
+			targets[fixups_usize++] = target;
+		}
+		if (wac_peephole_constValue(page, from, &a)) {
+			loads[loads_usize++] = to;
+		} else {
+			loads_usize = 0;
+		}
+		memmove(page->code + to, page->code + from, n);
+		memmove(page->lines + to, page->lines + from, sizeof(size_t) * n);
+		to += n;
+	}
+	map[size] = to;
+
+	for (i = 0; i < fixups_usize; ++i) {
+		wac_peephole_retarget(page, fixups[i], map[targets[i]]);
+	}
+
+	page->usize = to;
+
+	free(labels);
+	free(map);
+	free(fixups);
+	free(targets);
+	free(loads);
+}
+
+static size_t wac_peephole_popCount(wac_page_t *page, size_t address) {
+	uint8_t *inst = page->code + address;
+	if (inst[0] == WAC_OP_POP) return 1;
+	if (inst[0] == WAC_OP_POPN) return inst[1];
+	return ((uint32_t)inst[1] << 24) | (inst[2] << 16) | (inst[3] << 8) | inst[4];
+}
+
+//drops instructions marked in dead (indexed by address) and merges runs of POP and POPN
+//a jump to a dropped instruction lands on the next one that stays
+void wac_peephole_compact(wac_page_t *page, const bool *dead) {
+	size_t size = page->usize, from, to = 0, target, end, count, n, i, fixups_usize = 0;
+	bool *labels = WAC_ARRAY_INIT_NOGC(bool, size + 1);
+	size_t *map = WAC_ARRAY_INIT_NOGC(size_t, size + 1);
+	size_t *fixups = WAC_ARRAY_INIT_NOGC(size_t, size);
+	size_t *targets = WAC_ARRAY_INIT_NOGC(size_t, size);
+	bool isLong;
+
+	if (!labels || !map || !fixups || !targets) {
+		fprintf(stderr, "[-] Failed to allocate memory for peephole\n");
+		exit(1);
+	}
+
+	memset(labels, 0, sizeof(bool) * (size + 1));
+	for (from = 0; from < size; from += wac_page_inst_size(page, from)) {
+		target = dead[from] ? WAC_PAGE_NO_TARGET : wac_page_inst_target(page, from);
+		if (target != WAC_PAGE_NO_TARGET) labels[target] = true;
+	}
+
+	for (from = 0; from < size; ) {
+		map[from] = to;
+		n = wac_page_inst_size(page, from);
+
+		if (dead[from]) {
+			from += n;
+			continue;
+		}
+
+		//only the first one of the run can be a jump target
+		if (wac_peephole_isPop(page->code[from])) {
+			count = 0;
+			isLong = false;
+			for (end = from, i = 0; end < size && !dead[end] && wac_peephole_isPop(page->code[end]) && (end == from || !labels[end]); ++i) {
+				count += wac_peephole_popCount(page, end);
+				isLong = isLong || page->code[end] == WAC_OP_POPN_LONG;
+				end += wac_page_inst_size(page, end);
+			}
+
+			if (i > 1) {
+				//never longer than the run, POPN_LONG only when the run has one
+				size_t line = page->lines[from];
+				while (count > 0) {
+					if (isLong) {
+						page->code[to] = WAC_OP_POPN_LONG;
+						page->code[to + 1] = (count & 0xFF000000) >> 24;
+						page->code[to + 2] = (count & 0x00FF0000) >> 16;
+						page->code[to + 3] = (count & 0x0000FF00) >> 8;
+						page->code[to + 4] = (count & 0x000000FF);
+						n = 5;
+						count = 0;
+					} else if (count == 1) {
+						page->code[to] = WAC_OP_POP;
+						n = 1;
+						count = 0;
+					} else {
+						page->code[to] = WAC_OP_POPN;
+						page->code[to + 1] = (uint8_t)(count > 0xFF ? 0xFF : count);
+						count -= page->code[to + 1];
+						n = 2;
+					}
+					for (i = 0; i < n; ++i) page->lines[to + i] = line;
+					to += n;
+				}
+				from = end;
+				continue;
+			}
+		}
+
+		target = wac_page_inst_target(page, from);
+		if (target != WAC_PAGE_NO_TARGET) {
+			fixups[fixups_usize] = to;
+			targets[fixups_usize++] = target;
+		}
+		memmove(page->code + to, page->code + from, n);
+		memmove(page->lines + to, page->lines + from, sizeof(size_t) * n);
+		from += n;
+		to += n;
+	}
+	map[size] = to;
+
+	for (i = 0; i < fixups_usize; ++i) {
+		wac_peephole_retarget(page, fixups[i], map[targets[i]]);
+	}
+
+	page->usize = to;
+
+	free(labels);
+	free(map);
+	free(fixups);
+	free(targets);
+}
+
+//forward jumps come from the compiler with 4 byte offsets, each one that reaches with 2 bytes
+//gets the short form and its last 2 bytes become dead POPs for wac_peephole_compact to drop,
+//code only shrinks, so the short ones still reach after it
+void wac_peephole_shrinkJumps(wac_page_t *page) {
+	size_t size = page->usize, from, target;
+	bool *dead = WAC_ARRAY_INIT_NOGC(bool, size + 1);
+	bool shrunk = false;
+	uint8_t op;
+
+	if (!dead) {
+		fprintf(stderr, "[-] Failed to allocate memory for peephole\n");
+		exit(1);
+	}
+
+	memset(dead, 0, sizeof(bool) * (size + 1));
+	for (from = 0; from < size; from += wac_page_inst_size(page, from)) {
+		op = page->code[from];
+		if (op != WAC_OP_JMP_FORW_LONG && op != WAC_OP_JMP_TRUE_LONG && op != WAC_OP_JMP_FALSE_LONG) continue;
+		target = wac_page_inst_target(page, from);
+		if (target - from - 3 > UINT16_MAX) continue;
+
+		page->code[from] = op == WAC_OP_JMP_FORW_LONG ? WAC_OP_JMP_FORW : op == WAC_OP_JMP_TRUE_LONG ? WAC_OP_JMP_TRUE : WAC_OP_JMP_FALSE;
+		wac_peephole_retarget(page, from, target);
+		page->code[from + 3] = WAC_OP_POP;
+		page->code[from + 4] = WAC_OP_POP;
+		dead[from + 3] = true;
+		dead[from + 4] = true;
+		shrunk = true;
+	}
+
+	if (shrunk) wac_peephole_compact(page, dead);
+	free(dead);
+}
+
+//runs before wac_peephole_superinst, on code with no fused ops yet, page is the one state->compiler compiles
+//folds operators on constants, threads jumps to jumps, decides branches on constants,
+//drops code that can't be reached and merges runs of POP and POPN, code only shrinks like in wac_peephole_superinst
+void wac_peephole_optimize(wac_state_t *state, wac_page_t *page) {
+	size_t size, from, prev, next, target, i, work_usize = 0;
+	bool *labels, *dead;
+	size_t *work;
+	bool falsey;
+	uint8_t op;
+
+	wac_peephole_fold(state, page);
+	size = page->usize;
+	labels = WAC_ARRAY_INIT_NOGC(bool, size + 1);
+	dead = WAC_ARRAY_INIT_NOGC(bool, size + 1);
+	work = WAC_ARRAY_INIT_NOGC(size_t, size);
+
+	if (!labels || !dead || !work) {
+		fprintf(stderr, "[-] Failed to allocate memory for peephole\n");
+		exit(1);
+	}
+
+	//jump to an unconditional jump goes where that one goes, as far as the encoding reaches
+	for (from = 0; from < size; from += wac_page_inst_size(page, from)) {
+		target = wac_page_inst_target(page, from);
+		for (i = 0; target < size && i < WAC_PEEPHOLE_THREAD_MAX; ++i) {
+			op = page->code[target];
+			if (!wac_page_isExit(op) || op == WAC_OP_RET) break;
+			target = wac_page_inst_target(page, target);
+			if (!wac_peephole_retarget(page, from, target)) break;
+		}
+	}
+
+	memset(labels, 0, sizeof(bool) * (size + 1));
+	for (from = 0; from < size; from += wac_page_inst_size(page, from)) {
+		target = wac_page_inst_target(page, from);
+		if (target != WAC_PAGE_NO_TARGET) labels[target] = true;
+	}
+
+	//JMP_FALSE and JMP_TRUE right after a constant load either always jump or never do
+	//the jump does not pop, so when it never jumps the POP after it goes too
+	memset(dead, 0, sizeof(bool) * (size + 1));
+	for (prev = WAC_PAGE_NO_TARGET, from = 0; from < size; prev = from, from = next) {
+		next = from + wac_page_inst_size(page, from);
+		op = page->code[from];
+		if ((op != WAC_OP_JMP_FALSE && op != WAC_OP_JMP_TRUE && op != WAC_OP_JMP_FALSE_LONG && op != WAC_OP_JMP_TRUE_LONG) || labels[from]
+			|| prev == WAC_PAGE_NO_TARGET || !wac_peephole_constLoad(page, prev, &falsey)
+		) continue;
+
+		if (falsey == (op == WAC_OP_JMP_FALSE || op == WAC_OP_JMP_FALSE_LONG)) {
+			page->code[from] = op == WAC_OP_JMP_FALSE || op == WAC_OP_JMP_TRUE ? WAC_OP_JMP_FORW : WAC_OP_JMP_FORW_LONG;
+		} else {
+			dead[from] = true;
+			if (next < size && page->code[next] == WAC_OP_POP && !labels[next]) {
+				dead[prev] = true;
+				dead[next] = true;
+			}
+		}
+	}
+
+	//labels is reused for instructions reachable from the start
+	memset(labels, 0, sizeof(bool) * (size + 1));
+	labels[0] = true;
+	work[work_usize++] = 0;
+	while (work_usize > 0) {
+		from = work[--work_usize];
+		target = dead[from] ? WAC_PAGE_NO_TARGET : wac_page_inst_target(page, from);
+		if (target < size && !labels[target]) {
+			labels[target] = true;
+			work[work_usize++] = target;
+		}
+		next = from + wac_page_inst_size(page, from);
+		if ((dead[from] || !wac_page_isExit(page->code[from])) && next < size && !labels[next]) {
+			labels[next] = true;
+			work[work_usize++] = next;
+		}
+	}
+	for (from = 0; from < size; from += wac_page_inst_size(page, from)) {
+		if (!labels[from]) dead[from] = true;
+	}
+
+	//JMP_FORW over code that is all gone
+	for (from = 0; from < size; from += wac_page_inst_size(page, from)) {
+		if (dead[from] || (page->code[from] != WAC_OP_JMP_FORW && page->code[from] != WAC_OP_JMP_FORW_LONG)) continue;
+		target = wac_page_inst_target(page, from);
+		for (next = from + wac_page_inst_size(page, from); next < target && dead[next]; next += wac_page_inst_size(page, next));
+		if (next == target) dead[from] = true;
+	}
+
+	memset(labels, 0, sizeof(bool) * (size + 1));
+	for (from = 0; from < size; from += wac_page_inst_size(page, from)) {
+		target = dead[from] ? WAC_PAGE_NO_TARGET : wac_page_inst_target(page, from);
+		if (target != WAC_PAGE_NO_TARGET) labels[target] = true;
+	}
+
+	//constant load that is popped right away, left by the branches above
+	for (prev = WAC_PAGE_NO_TARGET, from = 0; from < size; from += wac_page_inst_size(page, from)) {
+		if (dead[from]) continue;
+		if (page->code[from] == WAC_OP_POP && !labels[from] && prev != WAC_PAGE_NO_TARGET && wac_peephole_constLoad(page, prev, &falsey)) {
+			dead[prev] = true;
+			dead[from] = true;
+			prev = WAC_PAGE_NO_TARGET;
+			continue;
+		}
+		prev = from;
+	}
+
+	wac_peephole_compact(page, dead);
+
+	free(labels);
+	free(dead);
+	free(work);
+}
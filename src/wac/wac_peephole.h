@@ -0,0 +1,14 @@
+#ifndef __WAC_PEEPHOLE_H
+#define __WAC_PEEPHOLE_H
+
+#include "wac_page.h"
+
+void wac_peephole_superinst(wac_page_t *page);
+void wac_peephole_compact(wac_page_t *page, const bool *dead);
+bool wac_peephole_retarget(wac_page_t *page, size_t address, size_t target);
+void wac_peephole_shrinkJumps(wac_page_t *page);
+void wac_peephole_optimize(wac_state_t *state, wac_page_t *page);
+bool wac_peephole_fold_unary(uint8_t op, wac_value_t a, wac_value_t *result);
+bool wac_peephole_fold_binary(wac_state_t *state, uint8_t op, wac_value_t a, wac_value_t b, wac_value_t *result);
+
+#endif //__WAC_PEEPHOLE_H
@@ -54,6 +54,10 @@ static bool wac_scanner_isDigit(char c) {
 	return c >= '0' && c <= '9';
 }
 
+static bool wac_scanner_isHexDigit(char c) {
+	return wac_scanner_isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
 static bool wac_scanner_isAlpha(char c) {
 	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
 }
@@ -64,6 +68,7 @@ static wac_token_t wac_scanner_token_make(wac_scanner_t *scanner, wac_token_type
 	token.start = scanner->start;
 	token.len = scanner->curr - scanner->start;
 	token.line = scanner->line;
+	token.hash = 0;
 	return token;
 }
 
@@ -73,6 +78,7 @@ static wac_token_t wac_scanner_token_error(wac_scanner_t *scanner, const char *m
 	token.start = msg;
 	token.len = strlen(msg);
 	token.line = scanner->line;
+	token.hash = 0;
 	return token;
 }
 
@@ -84,7 +90,14 @@ static wac_token_type_t wac_scanner_checkKeyword(wac_scanner_t *scanner, size_t
 static wac_token_type_t wac_scanner_id_type(wac_scanner_t *scanner) {
 	switch (*scanner->start) {
 		case 'v': return wac_scanner_checkKeyword(scanner, 1, 2, "ar", WAC_TOKEN_VAR);
-		case 'c': return wac_scanner_checkKeyword(scanner, 1, 4, "lass", WAC_TOKEN_CLASS);
+		case 'c':
+			if (scanner->curr - scanner->start > 1) {
+				switch (scanner->start[1]) {
+					case 'l': return wac_scanner_checkKeyword(scanner, 2, 3, "ass", WAC_TOKEN_CLASS);
+					case 'o': return wac_scanner_checkKeyword(scanner, 2, 3, "nst", WAC_TOKEN_CONST);
+				}
+			}
+			break;
 		case 't':
 			if (scanner->curr - scanner->start > 1) {
 				switch (scanner->start[1]) {
@@ -113,8 +126,11 @@ static wac_token_type_t wac_scanner_id_type(wac_scanner_t *scanner) {
 }
 
 static wac_token_t wac_scanner_id(wac_scanner_t *scanner) {
-	while (wac_scanner_isAlpha(*scanner->curr) || wac_scanner_isDigit(*scanner->curr)) wac_scanner_advance(scanner);
-	return wac_scanner_token_make(scanner, wac_scanner_id_type(scanner));
+	uint32_t hash = WAC_HASH_STEP(WAC_HASH_INIT, *scanner->start);
+	while (wac_scanner_isAlpha(*scanner->curr) || wac_scanner_isDigit(*scanner->curr)) hash = WAC_HASH_STEP(hash, wac_scanner_advance(scanner));
+	wac_token_t token = wac_scanner_token_make(scanner, wac_scanner_id_type(scanner));
+	token.hash = hash;
+	return token;
 }
 
 static wac_token_t wac_scanner_string(wac_scanner_t *scanner) {
@@ -129,7 +145,14 @@ static wac_token_t wac_scanner_string(wac_scanner_t *scanner) {
 	return wac_scanner_token_make(scanner, WAC_TOKEN_STRING);
 }
 
+//int if there is no fraction, see wac_parser_number
 static wac_token_t wac_scanner_number(wac_scanner_t *scanner) {
+	if (scanner->start[0] == '0' && (*scanner->curr == 'x' || *scanner->curr == 'X') && wac_scanner_isHexDigit(scanner->curr[1])) {
+		wac_scanner_advance(scanner);
+		while (wac_scanner_isHexDigit(*scanner->curr)) wac_scanner_advance(scanner);
+		return wac_scanner_token_make(scanner, WAC_TOKEN_NUMBER);
+	}
+
 	while (wac_scanner_isDigit(*scanner->curr)) wac_scanner_advance(scanner);
 
 	if (*scanner->curr == '.' && wac_scanner_isDigit(scanner->curr[1])) {
@@ -164,15 +187,22 @@ wac_token_t wac_scanner_token_next(wac_scanner_t *scanner) {
 		case '-': return wac_scanner_token_make(scanner, WAC_TOKEN_MINUS);
 		case '*': return wac_scanner_token_make(scanner, WAC_TOKEN_STAR);
 		case '/': return wac_scanner_token_make(scanner, WAC_TOKEN_SLASH);
+		case '%': return wac_scanner_token_make(scanner, WAC_TOKEN_PERCENT);
+		case '^': return wac_scanner_token_make(scanner, WAC_TOKEN_CARET);
+		case '~': return wac_scanner_token_make(scanner, wac_scanner_match(scanner, '/') ? WAC_TOKEN_TILDE_SLASH : WAC_TOKEN_TILDE);
 		case ';': return wac_scanner_token_make(scanner, WAC_TOKEN_SEMICOLON);
 
 		case '!': return wac_scanner_token_make(scanner, wac_scanner_match(scanner, '=') ? WAC_TOKEN_BANG_EQUAL : WAC_TOKEN_BANG);
 		case '=': return wac_scanner_token_make(scanner, wac_scanner_match(scanner, '=') ? WAC_TOKEN_EQUAL_EQUAL : WAC_TOKEN_EQUAL);
-		case '>': return wac_scanner_token_make(scanner, wac_scanner_match(scanner, '=') ? WAC_TOKEN_GREATER_EQUAL : WAC_TOKEN_GREATER);
-		case '<': return wac_scanner_token_make(scanner, wac_scanner_match(scanner, '=') ? WAC_TOKEN_LESS_EQUAL : WAC_TOKEN_LESS);
-
-		case '&': if (!wac_scanner_isAtEnd(scanner) && wac_scanner_advance(scanner) == '&') return wac_scanner_token_make(scanner, WAC_TOKEN_AMPER_AMPER);
-		case '|': if (!wac_scanner_isAtEnd(scanner) && wac_scanner_advance(scanner) == '|') return wac_scanner_token_make(scanner, WAC_TOKEN_BAR_BAR);
+		case '>':
+			if (wac_scanner_match(scanner, '>')) return wac_scanner_token_make(scanner, WAC_TOKEN_GREATER_GREATER);
+			return wac_scanner_token_make(scanner, wac_scanner_match(scanner, '=') ? WAC_TOKEN_GREATER_EQUAL : WAC_TOKEN_GREATER);
+		case '<':
+			if (wac_scanner_match(scanner, '<')) return wac_scanner_token_make(scanner, WAC_TOKEN_LESS_LESS);
+			return wac_scanner_token_make(scanner, wac_scanner_match(scanner, '=') ? WAC_TOKEN_LESS_EQUAL : WAC_TOKEN_LESS);
+
+		case '&': return wac_scanner_token_make(scanner, wac_scanner_match(scanner, '&') ? WAC_TOKEN_AMPER_AMPER : WAC_TOKEN_AMPER);
+		case '|': return wac_scanner_token_make(scanner, wac_scanner_match(scanner, '|') ? WAC_TOKEN_BAR_BAR : WAC_TOKEN_BAR);
 
 		case '"': return wac_scanner_string(scanner);
 
@@ -22,6 +22,9 @@ typedef enum wac_token_type_e {
 	WAC_TOKEN_MINUS,
 	WAC_TOKEN_STAR,
 	WAC_TOKEN_SLASH,
+	WAC_TOKEN_PERCENT,
+	WAC_TOKEN_CARET,
+	WAC_TOKEN_TILDE,
 	WAC_TOKEN_SEMICOLON, 
 
 	WAC_TOKEN_BANG,
@@ -32,8 +35,13 @@ typedef enum wac_token_type_e {
 	WAC_TOKEN_GREATER_EQUAL,
 	WAC_TOKEN_LESS,
 	WAC_TOKEN_LESS_EQUAL,
+	WAC_TOKEN_LESS_LESS,
+	WAC_TOKEN_GREATER_GREATER,
+	WAC_TOKEN_TILDE_SLASH,
 
+	WAC_TOKEN_AMPER,
 	WAC_TOKEN_AMPER_AMPER,
+	WAC_TOKEN_BAR,
 	WAC_TOKEN_BAR_BAR,
 
 	WAC_TOKEN_ID,
@@ -41,6 +49,7 @@ typedef enum wac_token_type_e {
 	WAC_TOKEN_NUMBER,
 
 	WAC_TOKEN_VAR,
+	WAC_TOKEN_CONST,
 	WAC_TOKEN_CLASS,
 	WAC_TOKEN_THIS,
 	WAC_TOKEN_SUPER,
@@ -63,6 +72,8 @@ typedef struct wac_token_s {
 	const char *start;
 	size_t len;
 	size_t line;
+	//hash of the text of ids, so names are hashed once while scanning
+	uint32_t hash;
 } wac_token_t;
 
 void wac_scanner_init(wac_scanner_t *scanner, const char *src);
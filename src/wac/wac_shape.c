@@ -0,0 +1,86 @@
+#include "wac_state.h"
+#include "wac_shape.h"
+#include "wac_object.h"
+#include "wac_memory.h"
+
+//key is NULL for the root shape
+wac_shape_t* wac_shape_init(wac_state_t *state, wac_shape_t *parent, wac_obj_string_t *key) {
+	size_t count = parent ? parent->count + 1 : 0, i;
+	wac_obj_string_t **keys = count ? WAC_ARRAY_INIT(state, wac_obj_string_t*, count) : NULL;
+	for (i = 0; i + 1 < count; ++i) keys[i] = parent->keys[i];
+	if (count) keys[count - 1] = key;
+
+	wac_shape_t *shape = WAC_ARRAY_INIT(state, wac_shape_t, 1);
+	shape->parent = parent;
+	shape->isMarked = false;
+	shape->count = count;
+	shape->keys = keys;
+	shape->transitions_asize = 0;
+	shape->transitions_usize = 0;
+	shape->transitions = NULL;
+	return shape;
+}
+
+bool wac_shape_find(wac_shape_t *shape, wac_obj_string_t *key, size_t *slot) {
+	size_t i;
+	for (i = 0; i < shape->count; ++i) {
+		if (shape->keys[i] == key) {
+			*slot = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+//shape with key added after fields of shape, NULL when over the limits
+wac_shape_t* wac_shape_add(wac_state_t *state, wac_shape_t *shape, wac_obj_string_t *key) {
+	size_t i;
+	wac_shape_t *child;
+
+	for (i = 0; i < shape->transitions_usize; ++i) {
+		child = shape->transitions[i];
+		if (child->keys[child->count - 1] == key) return child;
+	}
+
+	if (shape->count >= WAC_SHAPE_MAX_FIELDS || shape->transitions_usize >= WAC_SHAPE_MAX_TRANSITIONS) return NULL;
+
+	//child is linked only after it is complete, coz gc walks the tree
+	child = wac_shape_init(state, shape, key);
+	if (shape->transitions_asize <= shape->transitions_usize) {
+		size_t oldSize = shape->transitions_asize;
+		shape->transitions_asize = oldSize ? oldSize * WAC_ARRAY_GROW_MUL : 2;
+		shape->transitions = WAC_ARRAY_GROW(state, wac_shape_t*, shape->transitions, oldSize, shape->transitions_asize);
+	}
+	shape->transitions[shape->transitions_usize++] = child;
+	return child;
+}
+
+//frees the shapes under shape gc did not mark, marks of the rest are cleared
+//a marked shape has marked parents, so a shape that is not marked has nothing marked under it
+void wac_shape_sweep(wac_state_t *state, wac_shape_t *shape) {
+	size_t i, kept = 0;
+	wac_shape_t *child;
+
+	shape->isMarked = false;
+	for (i = 0; i < shape->transitions_usize; ++i) {
+		child = shape->transitions[i];
+		if (child->isMarked) {
+			wac_shape_sweep(state, child);
+			shape->transitions[kept++] = child;
+		} else {
+			wac_shape_free(state, child);
+		}
+	}
+	shape->transitions_usize = kept;
+}
+
+//frees the shape and all shapes under it
+void wac_shape_free(wac_state_t *state, wac_shape_t *shape) {
+	size_t i;
+	for (i = 0; i < shape->transitions_usize; ++i) {
+		wac_shape_free(state, shape->transitions[i]);
+	}
+	WAC_ARRAY_FREE(state, wac_shape_t*, shape->transitions, shape->transitions_asize);
+	WAC_ARRAY_FREE(state, wac_obj_string_t*, shape->keys, shape->count);
+	WAC_FREE(state, wac_shape_t, shape);
+}
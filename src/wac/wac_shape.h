@@ -0,0 +1,30 @@
+#ifndef __WAC_SHAPE_H
+#define __WAC_SHAPE_H
+
+#include "wac_common.h"
+
+//over these an instance leaves shapes and keeps its fields in a table
+#define WAC_SHAPE_MAX_FIELDS		64
+#define WAC_SHAPE_MAX_TRANSITIONS	32
+
+//field layout shared by instances that got the same fields in the same order
+//shapes form a tree from vm->shapeRoot, each child adds one field
+//transitions are weak, gc frees the shapes no instance or property cache reaches
+typedef struct wac_shape_s {
+	struct wac_shape_s *parent;
+	//set by gc on the shape and its parents, wac_shape_sweep clears it
+	bool isMarked;
+	//field keys[i] is in slot i, the last one was added by this shape
+	size_t count;
+	struct wac_obj_string_s **keys;
+	size_t transitions_asize, transitions_usize;
+	struct wac_shape_s **transitions;
+} wac_shape_t;
+
+wac_shape_t* wac_shape_init(wac_state_t *state, wac_shape_t *parent, struct wac_obj_string_s *key);
+bool wac_shape_find(wac_shape_t *shape, struct wac_obj_string_s *key, size_t *slot);
+wac_shape_t* wac_shape_add(wac_state_t *state, wac_shape_t *shape, struct wac_obj_string_s *key);
+void wac_shape_sweep(wac_state_t *state, wac_shape_t *shape);
+void wac_shape_free(wac_state_t *state, wac_shape_t *shape);
+
+#endif //__WAC_SHAPE_H
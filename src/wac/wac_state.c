@@ -18,6 +18,8 @@ wac_state_t* wac_state_init() {
 	}
 	state->compiler = NULL;
 	state->classCompiler = NULL;
+	state->backend = WAC_BACKEND_STACK;
+	state->optLevel = WAC_OPT_LEVEL_DEFAULT;
 
 	wac_vm_init(state);
 
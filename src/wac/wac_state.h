@@ -15,6 +15,8 @@ struct wac_state_s {
 	wac_parser_t parser;
 	wac_compiler_t *compiler;
 	wac_class_compiler_t *classCompiler;
+	wac_backend_t backend;
+	unsigned int optLevel;
 };
 
 wac_state_t* wac_state_init();
@@ -120,6 +120,14 @@ bool wac_table_get(wac_table_t *table, wac_obj_string_t *key, wac_value_t *value
 	return true;
 }
 
+//NULL if key is not there, entry is valid until table grows or key is deleted
+wac_table_entry_t* wac_table_get_entry(wac_table_t *table, wac_obj_string_t *key) {
+	if (!table->usize) return NULL;
+
+	wac_table_entry_t *entry = wac_table_find(table->entries, table->asize, key);
+	return entry->key ? entry : NULL;
+}
+
 bool wac_table_delete(wac_table_t *table, wac_obj_string_t *key) {
 	if (!table->usize) return false;
 
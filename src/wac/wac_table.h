@@ -25,6 +25,7 @@ wac_obj_string_t* wac_table_find_string(wac_table_t *table, const char *buf, siz
 bool wac_table_set(wac_state_t *state, wac_table_t *table, wac_obj_string_t *key, wac_value_t value);
 void wac_table_addAll(wac_state_t *state, wac_table_t *src, wac_table_t *dst);
 bool wac_table_get(wac_table_t *table, wac_obj_string_t *key, wac_value_t *value);
+wac_table_entry_t* wac_table_get_entry(wac_table_t *table, wac_obj_string_t *key);
 bool wac_table_delete(wac_table_t *table, wac_obj_string_t *key);
 void wac_table_free(wac_state_t *state, wac_table_t *table);
 
@@ -0,0 +1,1144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wac_state.h"
+#include "wac_tier.h"
+#include "wac_peephole.h"
+#include "wac_infer.h"
+#include "wac_object.h"
+#include "wac_memory.h"
+
+#define WAC_TIER_NO_SLOT ((uint32_t)(-1))
+#define WAC_TIER_NO_BLOCK ((size_t)(-1))
+#define WAC_TIER_WORD_BITS 64
+#define WAC_TIER_NO_VALUE ((uint32_t)(-1))
+#define WAC_TIER_NO_RANGE ((size_t)(-1))
+//values numbered at once in a block or loop, others are not moved nor shared
+#define WAC_TIER_VALUES_MAX 128
+//temp slots one round adds, later rounds see the temps of earlier ones as locals
+#define WAC_TIER_TEMPS_MAX 16
+#define WAC_TIER_ROUNDS 3
+
+//basic blocks of the function and local slots live at their starts and ends
+//sets are bitsets of words uint64_t per block
+typedef struct wac_tier_s {
+	wac_page_t *page;
+	size_t slots, words;
+	bool *dead;
+	bool *captured;
+	//index of the block starting at address, WAC_TIER_NO_BLOCK inside of blocks
+	size_t *blocks;
+	size_t blocks_usize;
+	//starts[blocks_usize] is the end of code
+	size_t *starts, *lasts;
+	uint64_t *gen, *kill, *in, *out;
+	bool failed;
+} wac_tier_t;
+
+//value numbered by wac_tier_step, leaves are CONST with index, GET_LOCAL with slot and its version,
+//NULL, TRUE and FALSE, the rest are ops with ids of their operands
+typedef struct wac_tier_value_s {
+	uint8_t op;
+	uint32_t a, b;
+	//first occurrence that is contiguous code, last is the address of its last instruction
+	size_t start, last;
+	uint32_t temp;
+} wac_tier_value_t;
+
+//value in a stack slot and the code computing it, start is WAC_TIER_NO_RANGE
+//when that code is not contiguous, end is the address after last
+typedef struct wac_tier_entry_s {
+	uint32_t value;
+	size_t start, last, end, insts;
+} wac_tier_entry_t;
+
+//code of a value computed before the header of the loop and stored in temp
+typedef struct wac_tier_hoist_s {
+	size_t header, start, last;
+	uint32_t temp;
+} wac_tier_hoist_t;
+
+//loop is the code from header to end, its last back jump
+typedef struct wac_tier_loop_s {
+	size_t header, end;
+} wac_tier_loop_t;
+
+//edits of one round over split code, NULLs at the start push temps slots after the params,
+//so slots from base up move up by temps
+typedef struct wac_tier_edit_s {
+	wac_obj_fun_t *fun;
+	uint32_t base, temps;
+	bool *skip;
+	//temp + 1 loaded in place of the instruction or stored after it, 0 for none
+	uint32_t *load, *store;
+	wac_tier_hoist_t hoists[WAC_TIER_TEMPS_MAX];
+	size_t hoists_usize;
+} wac_tier_edit_t;
+
+//value numbering of a block, or of the blocks of a loop when inv has its invariant slots
+//depths and tops are from wac_infer_facts, sym has the value in every stack slot
+typedef struct wac_tier_vn_s {
+	wac_page_t *page;
+	size_t slots;
+	size_t *depths;
+	uint8_t *tops;
+	bool *captured, *inv, *taken;
+	uint32_t *versions;
+	wac_tier_entry_t *sym;
+	wac_tier_value_t values[WAC_TIER_VALUES_MAX];
+	size_t values_usize;
+	wac_tier_entry_t *occs;
+	size_t occs_usize;
+} wac_tier_vn_t;
+
+static uint32_t wac_tier_read4(uint8_t *code) {
+	return ((uint32_t)code[0] << 24) | (code[1] << 16) | (code[2] << 8) | code[3];
+}
+
+static void wac_tier_write4(uint8_t *code, uint32_t value) {
+	code[0] = (value & 0xFF000000) >> 24;
+	code[1] = (value & 0x00FF0000) >> 16;
+	code[2] = (value & 0x0000FF00) >> 8;
+	code[3] = (value & 0x000000FF);
+}
+
+//local slots read and written by the instruction at address, reads has room for 2
+//other ops do not touch locals, captured ones are handled by wac_tier_t.captured
+static size_t wac_tier_access(wac_tier_t *t, size_t address, uint32_t *reads, uint32_t *write) {
+	uint8_t *code = t->page->code + address;
+	size_t reads_usize = 0, i;
+
+	*write = WAC_TIER_NO_SLOT;
+	switch (code[0]) {
+		case WAC_OP_GET_LOCAL:
+		case WAC_OP_GET_LOCAL_CONST:
+		case WAC_OP_GET_LOCAL_PROPERTY:
+			reads[reads_usize++] = code[1];
+			break;
+		case WAC_OP_GET_LOCAL_LONG:
+			reads[reads_usize++] = wac_tier_read4(code + 1);
+			break;
+		case WAC_OP_GET_LOCAL_2:
+			reads[reads_usize++] = code[1];
+			reads[reads_usize++] = code[2];
+			break;
+		//the field slot is only written on the scalar path, so it counts as read
+		case WAC_OP_GET_SCALAR:
+		case WAC_OP_SET_SCALAR:
+			reads[reads_usize++] = code[1];
+			reads[reads_usize++] = code[2];
+			break;
+		case WAC_OP_GET_SCALAR_LONG:
+		case WAC_OP_SET_SCALAR_LONG:
+			reads[reads_usize++] = wac_tier_read4(code + 1);
+			reads[reads_usize++] = wac_tier_read4(code + 5);
+			break;
+		case WAC_OP_SET_LOCAL:
+		case WAC_OP_SET_LOCAL_POP:
+			*write = code[1];
+			break;
+		case WAC_OP_SET_LOCAL_LONG:
+			*write = wac_tier_read4(code + 1);
+			break;
+		default:
+			//register ops, op A B C
+			if (code[0] >= WAC_OP_ADD_T && code[0] <= WAC_OP_LESS_R) {
+				if (!(code[2] & WAC_RK_CONST)) reads[reads_usize++] = code[2];
+				if (!(code[3] & WAC_RK_CONST)) reads[reads_usize++] = code[3];
+				*write = code[1];
+			}
+			break;
+	}
+
+	for (i = 0; i < reads_usize; ++i) {
+		if (reads[i] >= t->slots) t->failed = true;
+	}
+	if (*write != WAC_TIER_NO_SLOT && *write >= t->slots) t->failed = true;
+	return reads_usize;
+}
+
+static bool wac_tier_isLoad(uint8_t op) {
+	return op == WAC_OP_GET_LOCAL || op == WAC_OP_GET_LOCAL_2 || op == WAC_OP_GET_LOCAL_CONST || op == WAC_OP_GET_LOCAL_PROPERTY;
+}
+
+//store to a local followed by a load of it keeps the value on the stack instead
+//the load is cut off from the front of the instruction, a dead POP fills the gap
+static bool wac_tier_forward(wac_tier_t *t, const bool *labels) {
+	wac_page_t *page = t->page;
+	size_t size = page->usize, address, load;
+	uint8_t *code;
+	bool changed = false;
+
+	for (address = 0; address < size; address += wac_page_inst_size(page, address)) {
+		code = page->code + address;
+		if (code[0] == WAC_OP_SET_LOCAL_POP) {
+			load = address + 2;
+		} else if (code[0] == WAC_OP_SET_LOCAL && address + 2 < size && code[2] == WAC_OP_POP && !labels[address + 2]) {
+			load = address + 3;
+		} else {
+			continue;
+		}
+		if (load >= size || labels[load] || !wac_tier_isLoad(page->code[load]) || page->code[load + 1] != code[1]) continue;
+
+		code[0] = WAC_OP_SET_LOCAL;
+		if (load == address + 3) t->dead[address + 2] = true;
+		changed = true;
+		switch (page->code[load]) {
+			case WAC_OP_GET_LOCAL:
+				t->dead[load] = true;
+				break;
+			case WAC_OP_GET_LOCAL_2:
+				page->code[load] = WAC_OP_POP;
+				page->code[load + 1] = WAC_OP_GET_LOCAL;
+				t->dead[load] = true;
+				break;
+			case WAC_OP_GET_LOCAL_CONST:
+				page->code[load] = WAC_OP_POP;
+				page->code[load + 1] = WAC_OP_CONST;
+				t->dead[load] = true;
+				break;
+			case WAC_OP_GET_LOCAL_PROPERTY:
+				page->code[load] = WAC_OP_POP;
+				page->code[load + 1] = WAC_OP_GET_PROPERTY_CONST;
+				t->dead[load] = true;
+				break;
+		}
+	}
+	return changed;
+}
+
+//captured by reference or copied when the closure is made, both read the slot
+static void wac_tier_capture(wac_tier_t *t) {
+	wac_page_t *page = t->page;
+	size_t address, end, at;
+	uint32_t slot;
+	uint8_t op, flags;
+
+	memset(t->captured, 0, sizeof(bool) * t->slots);
+	for (address = 0; address < page->usize; address += wac_page_inst_size(page, address)) {
+		op = page->code[address];
+		if (op != WAC_OP_CLOSURE && op != WAC_OP_CLOSURE_LONG) continue;
+
+		end = address + wac_page_inst_size(page, address);
+		for (at = address + (op == WAC_OP_CLOSURE ? 2 : 5); at < end; at += (flags & WAC_UPVAL_LONG) ? 5 : 2) {
+			flags = page->code[at];
+			slot = (flags & WAC_UPVAL_LONG) ? wac_tier_read4(page->code + at + 1) : page->code[at + 1];
+			if (flags & WAC_UPVAL_LOCAL) {
+				if (slot < t->slots) t->captured[slot] = true;
+				else t->failed = true;
+			}
+		}
+	}
+}
+
+static void wac_tier_blocks(wac_tier_t *t) {
+	wac_page_t *page = t->page;
+	size_t size = page->usize, address, next, target, last = 0;
+
+	for (address = 0; address <= size; ++address) t->blocks[address] = WAC_TIER_NO_BLOCK;
+	t->blocks[0] = 0;
+	for (address = 0; address < size; address = next) {
+		next = address + wac_page_inst_size(page, address);
+		target = wac_page_inst_target(page, address);
+		if (target < size) t->blocks[target] = 0;
+		if ((target != WAC_PAGE_NO_TARGET || wac_page_isExit(page->code[address])) && next < size) t->blocks[next] = 0;
+	}
+
+	t->blocks_usize = 0;
+	for (address = 0; address < size; address += wac_page_inst_size(page, address)) {
+		if (t->blocks[address] != WAC_TIER_NO_BLOCK) {
+			if (t->blocks_usize > 0) t->lasts[t->blocks_usize - 1] = last;
+			t->blocks[address] = t->blocks_usize;
+			t->starts[t->blocks_usize++] = address;
+		}
+		last = address;
+	}
+	t->lasts[t->blocks_usize - 1] = last;
+	t->starts[t->blocks_usize] = size;
+}
+
+#define WAC_TIER_BIT(set, slot) ((set)[(slot) / WAC_TIER_WORD_BITS] & ((uint64_t)1 << ((slot) % WAC_TIER_WORD_BITS)))
+#define WAC_TIER_SET(set, slot) ((set)[(slot) / WAC_TIER_WORD_BITS] |= ((uint64_t)1 << ((slot) % WAC_TIER_WORD_BITS)))
+#define WAC_TIER_CLEAR(set, slot) ((set)[(slot) / WAC_TIER_WORD_BITS] &= ~((uint64_t)1 << ((slot) % WAC_TIER_WORD_BITS)))
+
+//backward dataflow, slot is live where it can be read before it is written again
+static void wac_tier_liveness(wac_tier_t *t) {
+	wac_page_t *page = t->page;
+	size_t b, address, target, i, j;
+	uint32_t reads[2], write;
+	uint64_t *gen, *kill, *in, *out, word;
+	bool changed;
+
+	for (b = 0; b < t->blocks_usize; ++b) {
+		gen = t->gen + b * t->words;
+		kill = t->kill + b * t->words;
+		for (address = t->starts[b]; address < t->starts[b + 1]; address += wac_page_inst_size(page, address)) {
+			if (t->dead[address]) continue;
+			j = wac_tier_access(t, address, reads, &write);
+			if (t->failed) return;
+			for (i = 0; i < j; ++i) {
+				if (!WAC_TIER_BIT(kill, reads[i])) WAC_TIER_SET(gen, reads[i]);
+			}
+			if (write != WAC_TIER_NO_SLOT) WAC_TIER_SET(kill, write);
+		}
+	}
+
+	do {
+		changed = false;
+		for (b = t->blocks_usize - 1; b != WAC_TIER_NO_BLOCK; --b) {
+			in = t->in + b * t->words;
+			out = t->out + b * t->words;
+			address = t->lasts[b];
+			target = wac_page_inst_target(page, address);
+			for (i = 0; i < t->words; ++i) {
+				word = 0;
+				if (target < page->usize) word |= t->in[t->blocks[target] * t->words + i];
+				if (!wac_page_isExit(page->code[address]) && b + 1 < t->blocks_usize) word |= t->in[(b + 1) * t->words + i];
+				out[i] = word;
+				word = t->gen[b * t->words + i] | (word & ~t->kill[b * t->words + i]);
+				if (word != in[i]) {
+					in[i] = word;
+					changed = true;
+				}
+			}
+		}
+	} while (changed);
+}
+
+//stores to slots that are not live after them are dropped
+//SET_LOCAL_POP becomes POPN 1, so wac_peephole_compact merges it with pops around
+static bool wac_tier_deadStores(wac_tier_t *t) {
+	wac_page_t *page = t->page;
+	size_t b, address, insts_usize, i, j;
+	size_t *insts = WAC_ARRAY_INIT_NOGC(size_t, page->usize);
+	uint64_t *live = WAC_ARRAY_INIT_NOGC(uint64_t, t->words);
+	uint32_t reads[2], write;
+	uint8_t op;
+	bool changed = false;
+
+	if (!insts || !live) {
+		fprintf(stderr, "[-] Failed to allocate memory for tier\n");
+		exit(1);
+	}
+
+	for (b = 0; b < t->blocks_usize; ++b) {
+		insts_usize = 0;
+		for (address = t->starts[b]; address < t->starts[b + 1]; address += wac_page_inst_size(page, address)) {
+			if (!t->dead[address]) insts[insts_usize++] = address;
+		}
+		memcpy(live, t->out + b * t->words, sizeof(uint64_t) * t->words);
+
+		for (i = insts_usize - 1; i != (size_t)(-1); --i) {
+			address = insts[i];
+			op = page->code[address];
+			j = wac_tier_access(t, address, reads, &write);
+			if (write != WAC_TIER_NO_SLOT) {
+				if ((op == WAC_OP_SET_LOCAL || op == WAC_OP_SET_LOCAL_LONG || op == WAC_OP_SET_LOCAL_POP)
+					&& !WAC_TIER_BIT(live, write) && !t->captured[write]
+				) {
+					if (op == WAC_OP_SET_LOCAL_POP) {
+						page->code[address] = WAC_OP_POPN;
+						page->code[address + 1] = 1;
+					} else {
+						t->dead[address] = true;
+					}
+					changed = true;
+					continue;
+				}
+				WAC_TIER_CLEAR(live, write);
+			}
+			while (j-- > 0) WAC_TIER_SET(live, reads[j]);
+		}
+	}
+
+	free(insts);
+	free(live);
+	return changed;
+}
+
+//nothing is pushed by these, other ops push one value
+static bool wac_tier_pushes(uint8_t op) {
+	if (op >= WAC_OP_ADD_R && op <= WAC_OP_LESS_R) return false;
+	if (op >= WAC_OP_EQUAL_JMP_FALSE && op <= WAC_OP_LESS_EQUAL_JMP_FALSE) return false;
+	if (op >= WAC_OP_GREATER_II_JMP_FALSE && op <= WAC_OP_LESS_EQUAL_DD_JMP_FALSE) return false;
+	switch (op) {
+		case WAC_OP_METHOD:
+		case WAC_OP_METHOD_LONG:
+		case WAC_OP_INHERIT:
+		case WAC_OP_POP:
+		case WAC_OP_POPN:
+		case WAC_OP_POPN_LONG:
+		case WAC_OP_SET_LOCAL:
+		case WAC_OP_SET_LOCAL_LONG:
+		case WAC_OP_SET_LOCAL_POP:
+		case WAC_OP_SET_UPVAL:
+		case WAC_OP_SET_UPVAL_LONG:
+		case WAC_OP_SET_GLOBAL:
+		case WAC_OP_SET_GLOBAL_LONG:
+		case WAC_OP_CLOSE_UPVAL:
+		case WAC_OP_DEFINE_GLOBAL:
+		case WAC_OP_DEFINE_GLOBAL_LONG:
+		case WAC_OP_JMP_FORW:
+		case WAC_OP_JMP_BACK:
+		case WAC_OP_JMP_BACK_LONG:
+		case WAC_OP_JMP_TRUE:
+		case WAC_OP_JMP_FALSE:
+		case WAC_OP_JMP_FORW_LONG:
+		case WAC_OP_JMP_TRUE_LONG:
+		case WAC_OP_JMP_FALSE_LONG:
+		case WAC_OP_CALL_INLINE:
+		case WAC_OP_SET_SCALAR:
+		case WAC_OP_SET_SCALAR_LONG:
+		case WAC_OP_RET:
+			return false;
+		default:
+			return true;
+	}
+}
+
+//slot the instruction writes other than by pushing, WAC_TIER_NO_SLOT for none
+static uint32_t wac_tier_written(wac_page_t *page, size_t address) {
+	uint8_t *code = page->code + address;
+	switch (code[0]) {
+		case WAC_OP_SET_LOCAL:
+		case WAC_OP_SET_LOCAL_POP:
+			return code[1];
+		case WAC_OP_SET_LOCAL_LONG:
+			return wac_tier_read4(code + 1);
+		case WAC_OP_SET_SCALAR:
+			return code[2];
+		case WAC_OP_SET_SCALAR_LONG:
+			return wac_tier_read4(code + 5);
+		default:
+			if (code[0] >= WAC_OP_ADD_T && code[0] <= WAC_OP_LESS_R) return code[1];
+			return WAC_TIER_NO_SLOT;
+	}
+}
+
+static bool wac_tier_isNumber(uint8_t type) {
+	return type == WAC_INFER_INT || type == WAC_INFER_NUM;
+}
+
+//count of operands of op when it can't fail nor change anything, by the types wac_infer_facts
+//proved for the two values on top, 0 for other ops
+//typed ops were proven when they were written, on numbers the generic ones do not check either
+//in blocks a repeat only runs once the first one passed its checks, so types do not matter there
+static size_t wac_tier_operands(uint8_t op, const uint8_t *tops, bool checked) {
+	switch (op) {
+		case WAC_OP_NOT:
+			return 1;
+		case WAC_OP_NEG:
+			return checked || wac_tier_isNumber(tops[1]) ? 1 : 0;
+		case WAC_OP_EQUAL:
+		case WAC_OP_NOT_EQUAL:
+		case WAC_OP_ADD_II:
+		case WAC_OP_SUB_II:
+		case WAC_OP_MUL_II:
+		case WAC_OP_ADD_DD:
+		case WAC_OP_SUB_DD:
+		case WAC_OP_MUL_DD:
+		case WAC_OP_DIV_DD:
+			return 2;
+		case WAC_OP_MOD:
+		case WAC_OP_IDIV:
+			return checked ? 2 : 0;
+		case WAC_OP_ADD:
+		case WAC_OP_SUB:
+		case WAC_OP_MUL:
+		case WAC_OP_DIV:
+		case WAC_OP_GREATER:
+		case WAC_OP_LESS:
+		case WAC_OP_GREATER_EQUAL:
+		case WAC_OP_LESS_EQUAL:
+		case WAC_OP_ADD_NUM_NUM:
+		case WAC_OP_ADD_INT_INT:
+		case WAC_OP_LESS_NUM:
+		case WAC_OP_LESS_INT:
+			return checked || (wac_tier_isNumber(tops[0]) && wac_tier_isNumber(tops[1])) ? 2 : 0;
+		default:
+			return 0;
+	}
+}
+
+//typed and quickened ops compute the same as the generic one
+static uint8_t wac_tier_key(uint8_t op) {
+	switch (op) {
+		case WAC_OP_ADD_II:
+		case WAC_OP_ADD_DD:
+		case WAC_OP_ADD_NUM_NUM:
+		case WAC_OP_ADD_INT_INT:
+			return WAC_OP_ADD;
+		case WAC_OP_SUB_II:
+		case WAC_OP_SUB_DD:
+			return WAC_OP_SUB;
+		case WAC_OP_MUL_II:
+		case WAC_OP_MUL_DD:
+			return WAC_OP_MUL;
+		case WAC_OP_DIV_DD:
+			return WAC_OP_DIV;
+		case WAC_OP_LESS_NUM:
+		case WAC_OP_LESS_INT:
+			return WAC_OP_LESS;
+		default:
+			return op;
+	}
+}
+
+//id of the value, WAC_TIER_NO_VALUE when there is no room for a new one
+static uint32_t wac_tier_number(wac_tier_vn_t *v, uint8_t op, uint32_t a, uint32_t b) {
+	wac_tier_value_t *value;
+	size_t i;
+
+	for (i = 0; i < v->values_usize; ++i) {
+		value = &v->values[i];
+		if (value->op == op && value->a == a && value->b == b) return (uint32_t)i;
+	}
+	if (v->values_usize == WAC_TIER_VALUES_MAX) return WAC_TIER_NO_VALUE;
+
+	value = &v->values[v->values_usize];
+	value->op = op;
+	value->a = a;
+	value->b = b;
+	value->start = WAC_TIER_NO_RANGE;
+	value->last = WAC_TIER_NO_RANGE;
+	value->temp = WAC_TIER_NO_VALUE;
+	return (uint32_t)v->values_usize++;
+}
+
+//values of stack slots from before the block are not known
+static void wac_tier_clear(wac_tier_vn_t *v) {
+	size_t i;
+	for (i = 0; i < v->slots; ++i) {
+		v->sym[i].value = WAC_TIER_NO_VALUE;
+		v->sym[i].start = WAC_TIER_NO_RANGE;
+	}
+}
+
+//occurrences nested in the new one are part of it
+static void wac_tier_occur(wac_tier_vn_t *v, const wac_tier_entry_t *entry) {
+	while (v->occs_usize > 0 && v->occs[v->occs_usize - 1].start >= entry->start) --v->occs_usize;
+	v->occs[v->occs_usize++] = *entry;
+}
+
+//value numbering of the instruction at address, next is the address after it
+//op values with contiguous code go to occs, in blocks when they were computed before,
+//in loops (with inv) when they only use constants and invariant slots
+static void wac_tier_step(wac_tier_vn_t *v, size_t address, size_t next) {
+	wac_page_t *page = v->page;
+	uint8_t *code = page->code + address;
+	size_t depth = v->depths[address], after, n;
+	wac_tier_entry_t entry, *ops;
+	wac_tier_value_t *value;
+	uint32_t slot;
+
+	entry.value = WAC_TIER_NO_VALUE;
+	entry.start = v->taken[address] ? WAC_TIER_NO_RANGE : address;
+	entry.last = address;
+	entry.end = next;
+	entry.insts = 1;
+	n = 0;
+
+	switch (code[0]) {
+		case WAC_OP_CONST:
+			entry.value = wac_tier_number(v, WAC_OP_CONST, code[1], 0);
+			break;
+		case WAC_OP_CONST_LONG:
+			entry.value = wac_tier_number(v, WAC_OP_CONST, wac_tier_read4(code + 1), 0);
+			break;
+		case WAC_OP_NULL:
+		case WAC_OP_TRUE:
+		case WAC_OP_FALSE:
+			entry.value = wac_tier_number(v, code[0], 0, 0);
+			break;
+		case WAC_OP_GET_LOCAL:
+		case WAC_OP_GET_LOCAL_LONG:
+			slot = code[0] == WAC_OP_GET_LOCAL ? code[1] : wac_tier_read4(code + 1);
+			if (slot < v->slots && !v->captured[slot] && (!v->inv || v->inv[slot])) {
+				entry.value = wac_tier_number(v, WAC_OP_GET_LOCAL, slot, v->inv ? 0 : v->versions[slot]);
+			}
+			break;
+		default:
+			n = wac_tier_operands(code[0], v->tops + address * 2, !v->inv);
+			if (n == 0 || depth < n) {
+				n = 0;
+				break;
+			}
+			ops = v->sym + depth - n;
+			if (ops[0].value == WAC_TIER_NO_VALUE || (n == 2 && ops[1].value == WAC_TIER_NO_VALUE)) {
+				n = 0;
+				break;
+			}
+			entry.value = wac_tier_number(v, wac_tier_key(code[0]), ops[0].value, n == 2 ? ops[1].value : WAC_TIER_NO_VALUE);
+
+			//operands are computed right before it, with nothing in between
+			if (entry.start == WAC_TIER_NO_RANGE || ops[0].start == WAC_TIER_NO_RANGE || ops[n - 1].end != address
+				|| (n == 2 && (ops[1].start == WAC_TIER_NO_RANGE || ops[0].end != ops[1].start))
+			) {
+				entry.start = WAC_TIER_NO_RANGE;
+			} else {
+				entry.start = ops[0].start;
+				entry.insts = 1 + ops[0].insts + (n == 2 ? ops[1].insts : 0);
+			}
+			break;
+	}
+
+	if (n > 0 && entry.value != WAC_TIER_NO_VALUE && entry.start != WAC_TIER_NO_RANGE) {
+		value = &v->values[entry.value];
+		//in blocks it only pays off when more than the load is cut out
+		if (v->inv ? entry.insts >= 2 : (value->start != WAC_TIER_NO_RANGE && entry.insts >= 3)) wac_tier_occur(v, &entry);
+		if (value->start == WAC_TIER_NO_RANGE) {
+			value->start = entry.start;
+			value->last = address;
+		}
+	}
+
+	slot = wac_tier_written(page, address);
+	if (slot < v->slots) {
+		++v->versions[slot];
+		v->sym[slot].value = WAC_TIER_NO_VALUE;
+		v->sym[slot].start = WAC_TIER_NO_RANGE;
+	}
+	after = next < page->usize ? v->depths[next] : WAC_INFER_NO_DEPTH;
+	if (after != WAC_INFER_NO_DEPTH && after > 0 && after <= v->slots && wac_tier_pushes(code[0])) {
+		++v->versions[after - 1];
+		v->sym[after - 1] = entry;
+	}
+}
+
+//occurrence is loaded from temp, the rest of its code is dropped
+static void wac_tier_replace(wac_tier_edit_t *e, const wac_tier_entry_t *occ, uint32_t temp, bool *taken) {
+	wac_page_t *page = &e->fun->page;
+	size_t address;
+
+	e->load[occ->start] = temp + 1;
+	for (address = occ->start; address <= occ->last; address += wac_page_inst_size(page, address)) {
+		if (address != occ->start) e->skip[address] = true;
+		if (taken) taken[address] = true;
+	}
+}
+
+//ranges of back jumps, ones that cross are merged, so a for loop with its increment is one
+//the rest are nested or apart, sorted so outer ones go first
+static size_t wac_tier_loops(wac_page_t *page, const size_t *depths, wac_tier_loop_t *loops) {
+	size_t address, loops_usize = 0, i, j;
+	wac_tier_loop_t loop;
+	bool merged;
+
+	for (address = 0; address < page->usize; address += wac_page_inst_size(page, address)) {
+		uint8_t op = page->code[address];
+		if ((op != WAC_OP_JMP_BACK && op != WAC_OP_JMP_BACK_LONG) || depths[address] == WAC_INFER_NO_DEPTH) continue;
+		loops[loops_usize].header = wac_page_inst_target(page, address);
+		loops[loops_usize++].end = address;
+	}
+
+	do {
+		merged = false;
+		for (i = 0; i < loops_usize && !merged; ++i) {
+			for (j = 0; j < loops_usize && !merged; ++j) {
+				if (!(loops[i].header < loops[j].header && loops[j].header <= loops[i].end && loops[i].end < loops[j].end)) continue;
+				loops[i].end = loops[j].end;
+				loops[j] = loops[--loops_usize];
+				merged = true;
+			}
+		}
+	} while (merged);
+
+	for (i = 1; i < loops_usize; ++i) {
+		loop = loops[i];
+		for (j = i; j > 0 && loops[j - 1].end - loops[j - 1].header < loop.end - loop.header; --j) loops[j] = loops[j - 1];
+		loops[j] = loop;
+	}
+	return loops_usize;
+}
+
+//values the loop computes only from constants and slots it does not write are computed before
+//its header into temps, it has to be entered only by falling into the header, so that code runs
+static void wac_tier_hoist(wac_tier_vn_t *v, wac_tier_edit_t *e, wac_tier_t *t, const wac_tier_loop_t *loop, bool *inv) {
+	wac_page_t *page = v->page;
+	size_t depth = v->depths[loop->header], address, next, after, i;
+	wac_tier_value_t *value;
+	uint32_t slot;
+
+	if (depth == WAC_INFER_NO_DEPTH) return;
+	for (address = 0; address < page->usize; address += wac_page_inst_size(page, address)) {
+		size_t target = wac_page_inst_target(page, address);
+		if (target >= loop->header && target <= loop->end && (address < loop->header || address > loop->end)) return;
+	}
+
+	for (i = 0; i < v->slots; ++i) inv[i] = i < depth && !v->captured[i];
+	for (address = loop->header; address <= loop->end; address = next) {
+		next = address + wac_page_inst_size(page, address);
+		if (v->depths[address] == WAC_INFER_NO_DEPTH) continue;
+		if (v->depths[address] < depth) return;
+		slot = wac_tier_written(page, address);
+		if (slot < v->slots) inv[slot] = false;
+		after = next < page->usize ? v->depths[next] : WAC_INFER_NO_DEPTH;
+		if (after != WAC_INFER_NO_DEPTH && after > 0 && after <= v->slots && wac_tier_pushes(page->code[address])) inv[after - 1] = false;
+	}
+
+	v->inv = inv;
+	v->values_usize = 0;
+	v->occs_usize = 0;
+	for (address = loop->header; address <= loop->end; address = next) {
+		next = address + wac_page_inst_size(page, address);
+		if (t->blocks[address] != WAC_TIER_NO_BLOCK) wac_tier_clear(v);
+		if (v->depths[address] != WAC_INFER_NO_DEPTH) wac_tier_step(v, address, next);
+	}
+	v->inv = NULL;
+
+	for (i = 0; i < v->occs_usize; ++i) {
+		value = &v->values[v->occs[i].value];
+		if (value->temp == WAC_TIER_NO_VALUE) {
+			if (e->temps == WAC_TIER_TEMPS_MAX) continue;
+			value->temp = e->temps++;
+			e->hoists[e->hoists_usize].header = loop->header;
+			e->hoists[e->hoists_usize].start = v->occs[i].start;
+			e->hoists[e->hoists_usize].last = v->occs[i].last;
+			e->hoists[e->hoists_usize++].temp = value->temp;
+		}
+		wac_tier_replace(e, &v->occs[i], value->temp, v->taken);
+	}
+}
+
+//finds values to hoist out of loops, outer ones first, and to share in blocks,
+//what loops took is left out of the rest, false when there is nothing
+static bool wac_tier_plan(wac_obj_fun_t *fun, wac_tier_edit_t *e) {
+	wac_page_t *page = &fun->page;
+	size_t size = page->usize, address, next, b, i, loops_usize;
+	uint32_t first, temps, most = 0;
+	wac_tier_loop_t *loops;
+	wac_tier_value_t *value;
+	wac_tier_vn_t v;
+	wac_tier_t t;
+	bool *inv;
+	bool ok;
+
+	t.page = page;
+	t.slots = fun->maxStack + 1;
+	t.failed = false;
+	t.captured = WAC_ARRAY_INIT_NOGC(bool, t.slots);
+	t.blocks = WAC_ARRAY_INIT_NOGC(size_t, size + 1);
+	t.starts = WAC_ARRAY_INIT_NOGC(size_t, size + 1);
+	t.lasts = WAC_ARRAY_INIT_NOGC(size_t, size);
+	v.page = page;
+	v.slots = t.slots;
+	v.depths = WAC_ARRAY_INIT_NOGC(size_t, size + 1);
+	v.tops = WAC_ARRAY_INIT_NOGC(uint8_t, (size + 1) * 2);
+	v.captured = t.captured;
+	v.inv = NULL;
+	v.taken = WAC_ARRAY_INIT_NOGC(bool, size + 1);
+	v.versions = WAC_ARRAY_INIT_NOGC(uint32_t, v.slots);
+	v.sym = WAC_ARRAY_INIT_NOGC(wac_tier_entry_t, v.slots);
+	v.occs = WAC_ARRAY_INIT_NOGC(wac_tier_entry_t, size + 1);
+	inv = WAC_ARRAY_INIT_NOGC(bool, v.slots);
+	loops = WAC_ARRAY_INIT_NOGC(wac_tier_loop_t, size);
+	if (!t.captured || !t.blocks || !t.starts || !t.lasts || !v.depths || !v.tops || !v.taken
+		|| !v.versions || !v.sym || !v.occs || !inv || !loops
+	) {
+		fprintf(stderr, "[-] Failed to allocate memory for tier\n");
+		exit(1);
+	}
+	memset(v.taken, 0, sizeof(bool) * (size + 1));
+
+	ok = wac_infer_facts(fun, v.depths, v.tops);
+	if (ok) {
+		wac_tier_capture(&t);
+		ok = !t.failed;
+	}
+
+	if (ok) {
+		wac_tier_blocks(&t);
+		loops_usize = wac_tier_loops(page, v.depths, loops);
+		for (i = 0; i < loops_usize; ++i) wac_tier_hoist(&v, e, &t, &loops[i], inv);
+
+		//values of one block do not outlive it, so blocks share the temps after the hoisted ones
+		first = e->temps;
+		for (b = 0; b < t.blocks_usize; ++b) {
+			if (v.depths[t.starts[b]] == WAC_INFER_NO_DEPTH) continue;
+			v.values_usize = 0;
+			v.occs_usize = 0;
+			memset(v.versions, 0, sizeof(uint32_t) * v.slots);
+			wac_tier_clear(&v);
+			for (address = t.starts[b]; address < t.starts[b + 1]; address = next) {
+				next = address + wac_page_inst_size(page, address);
+				if (v.depths[address] != WAC_INFER_NO_DEPTH) wac_tier_step(&v, address, next);
+			}
+
+			temps = 0;
+			for (i = 0; i < v.occs_usize; ++i) {
+				value = &v.values[v.occs[i].value];
+				if (value->temp == WAC_TIER_NO_VALUE) {
+					if (first + temps == WAC_TIER_TEMPS_MAX) continue;
+					value->temp = first + temps++;
+					e->store[value->last] = value->temp + 1;
+				}
+				wac_tier_replace(e, &v.occs[i], value->temp, NULL);
+			}
+			if (temps > most) most = temps;
+		}
+		e->temps = first + most;
+	}
+
+	free(t.captured);
+	free(t.blocks);
+	free(t.starts);
+	free(t.lasts);
+	free(v.depths);
+	free(v.tops);
+	free(v.taken);
+	free(v.versions);
+	free(v.sym);
+	free(v.occs);
+	free(inv);
+	free(loops);
+	return ok && e->temps > 0;
+}
+
+//slot moved up by temps when it is at base or above, false when it gets over max
+static bool wac_tier_shift(const wac_tier_edit_t *e, uint8_t *slot, uint32_t max) {
+	if (*slot < e->base) return true;
+	if (*slot + e->temps > max) return false;
+	*slot += e->temps;
+	return true;
+}
+
+static void wac_tier_shift4(const wac_tier_edit_t *e, uint8_t *slot) {
+	uint32_t value = wac_tier_read4(slot);
+	if (value >= e->base) wac_tier_write4(slot, value + e->temps);
+}
+
+//instruction at address written to code, fused ops split into the ones they were made of
+//and a plain jump in _LONG form with longJump, returns its size or 0 when a slot does not fit
+static size_t wac_tier_copy(const wac_tier_edit_t *e, size_t address, uint8_t *code, bool longJump) {
+	wac_page_t *page = &e->fun->page;
+	uint8_t *inst = page->code + address, flags;
+	size_t n = wac_page_inst_size(page, address), at;
+	bool ok = true;
+
+	switch (inst[0]) {
+		case WAC_OP_GET_LOCAL_2:
+			code[0] = WAC_OP_GET_LOCAL;
+			code[1] = inst[1];
+			code[2] = WAC_OP_GET_LOCAL;
+			code[3] = inst[2];
+			ok = wac_tier_shift(e, code + 1, 0xFF) && wac_tier_shift(e, code + 3, 0xFF);
+			return ok ? 4 : 0;
+		case WAC_OP_GET_LOCAL_CONST:
+			code[0] = WAC_OP_GET_LOCAL;
+			code[1] = inst[1];
+			code[2] = WAC_OP_CONST;
+			code[3] = inst[2];
+			return wac_tier_shift(e, code + 1, 0xFF) ? 4 : 0;
+		case WAC_OP_GET_LOCAL_PROPERTY:
+			code[0] = WAC_OP_GET_LOCAL;
+			code[1] = inst[1];
+			code[2] = WAC_OP_GET_PROPERTY_CONST;
+			code[3] = inst[2];
+			code[4] = inst[3];
+			return wac_tier_shift(e, code + 1, 0xFF) ? 5 : 0;
+		case WAC_OP_SET_LOCAL_POP:
+			code[0] = WAC_OP_SET_LOCAL;
+			code[1] = inst[1];
+			code[2] = WAC_OP_POP;
+			return wac_tier_shift(e, code + 1, 0xFF) ? 3 : 0;
+		case WAC_OP_JMP_BACK:
+		case WAC_OP_JMP_FORW:
+		case WAC_OP_JMP_TRUE:
+		case WAC_OP_JMP_FALSE:
+			if (!longJump) break;
+			//offset is written by wac_tier_rewrite
+			code[0] = inst[0] == WAC_OP_JMP_BACK ? WAC_OP_JMP_BACK_LONG : inst[0] == WAC_OP_JMP_FORW ? WAC_OP_JMP_FORW_LONG
+				: inst[0] == WAC_OP_JMP_TRUE ? WAC_OP_JMP_TRUE_LONG : WAC_OP_JMP_FALSE_LONG;
+			wac_tier_write4(code + 1, 0);
+			return 5;
+	}
+
+	memcpy(code, inst, n);
+	switch (code[0]) {
+		case WAC_OP_GET_LOCAL:
+		case WAC_OP_SET_LOCAL:
+			ok = wac_tier_shift(e, code + 1, 0xFF);
+			break;
+		case WAC_OP_GET_LOCAL_LONG:
+		case WAC_OP_SET_LOCAL_LONG:
+			wac_tier_shift4(e, code + 1);
+			break;
+		case WAC_OP_GET_SCALAR:
+		case WAC_OP_SET_SCALAR:
+			ok = wac_tier_shift(e, code + 1, 0xFF) && wac_tier_shift(e, code + 2, 0xFF);
+			break;
+		case WAC_OP_GET_SCALAR_LONG:
+		case WAC_OP_SET_SCALAR_LONG:
+			wac_tier_shift4(e, code + 1);
+			wac_tier_shift4(e, code + 5);
+			break;
+		case WAC_OP_CLOSURE:
+		case WAC_OP_CLOSURE_LONG:
+			for (at = code[0] == WAC_OP_CLOSURE ? 2 : 5; at < n; at += (flags & WAC_UPVAL_LONG) ? 5 : 2) {
+				flags = code[at];
+				if (!(flags & WAC_UPVAL_LOCAL)) continue;
+				if (flags & WAC_UPVAL_LONG) wac_tier_shift4(e, code + at + 1);
+				else if (!wac_tier_shift(e, code + at + 1, 0xFF)) ok = false;
+			}
+			break;
+		default:
+			//register ops, op A B C
+			if (code[0] >= WAC_OP_ADD_T && code[0] <= WAC_OP_LESS_R) {
+				ok = wac_tier_shift(e, code + 1, 0xFF)
+					&& ((code[2] & WAC_RK_CONST) || wac_tier_shift(e, code + 2, WAC_RK_INDEX_MAX))
+					&& ((code[3] & WAC_RK_CONST) || wac_tier_shift(e, code + 3, WAC_RK_INDEX_MAX));
+			}
+			break;
+	}
+	return ok ? n : 0;
+}
+
+//op with the slot of temp, 0 when the slot does not fit in a byte
+static size_t wac_tier_temp(const wac_tier_edit_t *e, uint8_t op, uint32_t temp, uint8_t *code) {
+	if (e->base + temp > 0xFF) return 0;
+	code[0] = op;
+	code[1] = (uint8_t)(e->base + temp);
+	return 2;
+}
+
+//writes the code of the round, map gets the new address of every old one
+//hoisted code goes before the header, so jumps to the header go past it
+//jumps are recorded in fixups with their old addresses in froms, returns the size or 0 on failure
+static size_t wac_tier_emit(const wac_tier_edit_t *e, uint8_t *code, size_t *lines, size_t *map, const bool *longJumps, size_t *fixups, size_t *froms, size_t *fixups_usize) {
+	wac_page_t *page = &e->fun->page;
+	size_t size = page->usize, from, to = 0, at, line, n, i, j;
+	const wac_tier_hoist_t *hoist;
+
+	*fixups_usize = 0;
+	for (from = 0; from < size; from += wac_page_inst_size(page, from)) {
+		line = page->lines[from];
+		if (from == 0) {
+			for (i = 0; i < e->temps; ++i, ++to) {
+				code[to] = WAC_OP_NULL;
+				lines[to] = line;
+			}
+		}
+
+		for (i = 0; i < e->hoists_usize; ++i) {
+			hoist = &e->hoists[i];
+			if (hoist->header != from) continue;
+			for (at = hoist->start; at <= hoist->last; at += wac_page_inst_size(page, at)) {
+				n = wac_tier_copy(e, at, code + to, false);
+				if (n == 0) return 0;
+				for (j = 0; j < n; ++j) lines[to++] = page->lines[at];
+			}
+			if (!wac_tier_temp(e, WAC_OP_SET_LOCAL, hoist->temp, code + to)) return 0;
+			code[to + 2] = WAC_OP_POP;
+			for (j = 0; j < 3; ++j) lines[to++] = line;
+		}
+
+		map[from] = to;
+		if (e->skip[from]) continue;
+
+		if (e->load[from]) {
+			n = wac_tier_temp(e, WAC_OP_GET_LOCAL, e->load[from] - 1, code + to);
+		} else {
+			n = wac_tier_copy(e, from, code + to, longJumps[from]);
+			if (wac_page_inst_target(page, from) != WAC_PAGE_NO_TARGET) {
+				fixups[*fixups_usize] = to;
+				froms[(*fixups_usize)++] = from;
+			}
+		}
+		if (n == 0) return 0;
+		for (j = 0; j < n; ++j) lines[to++] = line;
+
+		if (e->store[from]) {
+			if (!wac_tier_temp(e, WAC_OP_SET_LOCAL, e->store[from] - 1, code + to)) return 0;
+			lines[to++] = line;
+			lines[to++] = line;
+		}
+	}
+	map[size] = to;
+	return to;
+}
+
+//writes the code with the edits in place of the page, false when a slot or jump does not fit
+//plain jumps that can't reach any more take the _LONG form, which moves the code after them
+static bool wac_tier_rewrite(wac_state_t *state, wac_tier_edit_t *e) {
+	wac_page_t *page = &e->fun->page, out;
+	size_t size = page->usize, cap = 6 * size + e->temps + 1, to = 0, fixups_usize, i;
+	size_t *lines, *map, *fixups, *froms;
+	uint8_t *code;
+	bool *longJumps;
+	bool ok, retry;
+
+	for (i = 0; i < e->hoists_usize; ++i) {
+		cap += e->hoists[i].last + wac_page_inst_size(page, e->hoists[i].last) - e->hoists[i].start + 3;
+	}
+	code = WAC_ARRAY_INIT_NOGC(uint8_t, cap);
+	lines = WAC_ARRAY_INIT_NOGC(size_t, cap);
+	map = WAC_ARRAY_INIT_NOGC(size_t, size + 1);
+	fixups = WAC_ARRAY_INIT_NOGC(size_t, size);
+	froms = WAC_ARRAY_INIT_NOGC(size_t, size);
+	longJumps = WAC_ARRAY_INIT_NOGC(bool, size + 1);
+	if (!code || !lines || !map || !fixups || !froms || !longJumps) {
+		fprintf(stderr, "[-] Failed to allocate memory for tier\n");
+		exit(1);
+	}
+	memset(longJumps, 0, sizeof(bool) * (size + 1));
+
+	do {
+		to = wac_tier_emit(e, code, lines, map, longJumps, fixups, froms, &fixups_usize);
+		ok = to > 0;
+		retry = false;
+		out = *page;
+		out.code = code;
+		for (i = 0; ok && i < fixups_usize; ++i) {
+			if (wac_peephole_retarget(&out, fixups[i], map[wac_page_inst_target(page, froms[i])])) continue;
+			if (wac_page_isJump(code[fixups[i]]) && wac_page_inst_size(&out, fixups[i]) < 5) {
+				longJumps[froms[i]] = true;
+				retry = true;
+			} else {
+				ok = false;
+			}
+		}
+	} while (ok && retry);
+
+	if (ok) {
+		if (page->asize < to) {
+			page->code = WAC_ARRAY_GROW(state, uint8_t, page->code, page->asize, to);
+			page->lines = WAC_ARRAY_GROW(state, size_t, page->lines, page->asize, to);
+			page->asize = to;
+		}
+		memcpy(page->code, code, to);
+		memcpy(page->lines, lines, sizeof(size_t) * to);
+		page->usize = to;
+		e->fun->maxStack += e->temps;
+	}
+
+	free(code);
+	free(lines);
+	free(map);
+	free(fixups);
+	free(froms);
+	free(longJumps);
+	return ok;
+}
+
+static void wac_tier_edit_init(wac_tier_edit_t *e, wac_obj_fun_t *fun) {
+	size_t size = fun->page.usize + 1;
+
+	e->fun = fun;
+	e->base = fun->arity + 1;
+	e->temps = 0;
+	e->hoists_usize = 0;
+	e->skip = WAC_ARRAY_INIT_NOGC(bool, size);
+	e->load = WAC_ARRAY_INIT_NOGC(uint32_t, size);
+	e->store = WAC_ARRAY_INIT_NOGC(uint32_t, size);
+	if (!e->skip || !e->load || !e->store) {
+		fprintf(stderr, "[-] Failed to allocate memory for tier\n");
+		exit(1);
+	}
+	memset(e->skip, 0, sizeof(bool) * size);
+	memset(e->load, 0, sizeof(uint32_t) * size);
+	memset(e->store, 0, sizeof(uint32_t) * size);
+}
+
+static void wac_tier_edit_free(wac_tier_edit_t *e) {
+	free(e->skip);
+	free(e->load);
+	free(e->store);
+}
+
+//the code is split, rounds of wac_tier_plan and wac_tier_rewrite move and share values,
+//then it is fused and typed again, wac_infer_types now also types quickened ops it proves
+static void wac_tier_values(wac_state_t *state, wac_obj_fun_t *fun) {
+	wac_tier_edit_t e;
+	size_t round;
+	bool ok;
+
+	wac_tier_edit_init(&e, fun);
+	ok = wac_tier_rewrite(state, &e);
+	wac_tier_edit_free(&e);
+	if (!ok) return;
+
+	for (round = 0; round < WAC_TIER_ROUNDS; ++round) {
+		wac_tier_edit_init(&e, fun);
+		ok = wac_tier_plan(fun, &e) && wac_tier_rewrite(state, &e);
+		wac_tier_edit_free(&e);
+		if (!ok) break;
+	}
+
+	wac_peephole_superinst(&fun->page);
+	wac_infer_types(fun);
+}
+
+//optimizing tier, run by the vm on a hot function when no frame runs its code
+//forwards stored values to loads right after them and drops dead stores found by liveness
+//over basic blocks, then wac_tier_values hoists values out of loops and shares them in blocks
+//the code can grow and maxStack gets the temps, coz no frame has its stack yet
+void wac_tier_optimize(wac_state_t *state, wac_obj_fun_t *fun) {
+	wac_page_t *page = &fun->page;
+	size_t size = page->usize, address, target, n;
+	bool *labels;
+	bool changed;
+	wac_tier_t t;
+
+	t.page = page;
+	t.slots = fun->maxStack + 1;
+	t.words = (t.slots + WAC_TIER_WORD_BITS - 1) / WAC_TIER_WORD_BITS;
+	t.failed = false;
+	t.dead = WAC_ARRAY_INIT_NOGC(bool, size + 1);
+	t.captured = WAC_ARRAY_INIT_NOGC(bool, t.slots);
+	t.blocks = WAC_ARRAY_INIT_NOGC(size_t, size + 1);
+	t.starts = WAC_ARRAY_INIT_NOGC(size_t, size + 1);
+	t.lasts = WAC_ARRAY_INIT_NOGC(size_t, size);
+	labels = WAC_ARRAY_INIT_NOGC(bool, size + 1);
+	if (!t.dead || !t.captured || !t.blocks || !t.starts || !t.lasts || !labels) {
+		fprintf(stderr, "[-] Failed to allocate memory for tier\n");
+		exit(1);
+	}
+
+	memset(t.dead, 0, sizeof(bool) * (size + 1));
+	memset(labels, 0, sizeof(bool) * (size + 1));
+	for (address = 0; address < size; address += wac_page_inst_size(page, address)) {
+		target = wac_page_inst_target(page, address);
+		if (target != WAC_PAGE_NO_TARGET) labels[target] = true;
+	}
+	wac_tier_capture(&t);
+
+	changed = !t.failed && wac_tier_forward(&t, labels);
+
+	if (!t.failed) {
+		wac_tier_blocks(&t);
+		n = t.blocks_usize * t.words;
+		t.gen = WAC_ARRAY_INIT_NOGC(uint64_t, n);
+		t.kill = WAC_ARRAY_INIT_NOGC(uint64_t, n);
+		t.in = WAC_ARRAY_INIT_NOGC(uint64_t, n);
+		t.out = WAC_ARRAY_INIT_NOGC(uint64_t, n);
+		if (!t.gen || !t.kill || !t.in || !t.out) {
+			fprintf(stderr, "[-] Failed to allocate memory for tier\n");
+			exit(1);
+		}
+		memset(t.gen, 0, sizeof(uint64_t) * n);
+		memset(t.kill, 0, sizeof(uint64_t) * n);
+		memset(t.in, 0, sizeof(uint64_t) * n);
+		memset(t.out, 0, sizeof(uint64_t) * n);
+
+		wac_tier_liveness(&t);
+		if (!t.failed && wac_tier_deadStores(&t)) changed = true;
+
+		free(t.gen);
+		free(t.kill);
+		free(t.in);
+		free(t.out);
+	}
+
+	//forwarding alone is safe to keep even when liveness gave up
+	if (changed) wac_peephole_compact(page, t.dead);
+
+	free(t.dead);
+	free(t.captured);
+	free(t.blocks);
+	free(t.starts);
+	free(t.lasts);
+	free(labels);
+
+	if (!t.failed) wac_tier_values(state, fun);
+}
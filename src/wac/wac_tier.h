@@ -0,0 +1,11 @@
+#ifndef __WAC_TIER_H
+#define __WAC_TIER_H
+
+#include "wac_object.h"
+
+//calls of a function before wac_tier_optimize runs on it, with optLevel 3
+#define WAC_TIER_HOT_CALLS 1000
+
+void wac_tier_optimize(wac_state_t *state, wac_obj_fun_t *fun);
+
+#endif //__WAC_TIER_H
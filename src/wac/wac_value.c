@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <string.h>
+#include <inttypes.h>
 
 #include "wac_state.h"
 #include "wac_value.h"
@@ -7,11 +8,16 @@
 #include "wac_memory.h"
 
 void wac_value_print(wac_value_t value) {
-	switch (value.type) {
-		case WAC_VAL_TYPE_NULL: printf("null"); break;
-		case WAC_VAL_TYPE_BOOL: printf(WAC_VAL_AS_BOOL(value) ? "true" : "false"); break;
-		case WAC_VAL_TYPE_NUMBER: printf("%g", WAC_VAL_AS_NUMBER(value)); break;
-		case WAC_VAL_TYPE_OBJ: wac_obj_print(value); break;
+	if (WAC_VAL_IS_NULL(value)) {
+		printf("null");
+	} else if (WAC_VAL_IS_BOOL(value)) {
+		printf(WAC_VAL_AS_BOOL(value) ? "true" : "false");
+	} else if (WAC_VAL_IS_NUMBER(value)) {
+		printf("%g", WAC_VAL_AS_NUMBER(value));
+	} else if (WAC_VAL_IS_INT(value)) {
+		printf("%" PRId64, WAC_VAL_AS_INT(value));
+	} else if (WAC_VAL_IS_OBJ(value)) {
+		wac_obj_print(value);
 	}
 }
 
@@ -20,15 +26,67 @@ bool wac_value_falsey(wac_value_t value) {
 }
 
 bool wac_value_equal(wac_value_t a, wac_value_t b) {
+	//1 == 1.0
+	if (WAC_VAL_IS_INT(a) != WAC_VAL_IS_INT(b)) {
+		return WAC_VAL_IS_NUMERIC(a) && WAC_VAL_IS_NUMERIC(b) && WAC_VAL_TO_NUMBER(a) == WAC_VAL_TO_NUMBER(b);
+	}
+#ifdef WAC_NAN_BOXING
+	//coz nan != nan
+	if (WAC_VAL_IS_NUMBER(a) && WAC_VAL_IS_NUMBER(b)) return WAC_VAL_AS_NUMBER(a) == WAC_VAL_AS_NUMBER(b);
+	return a == b;
+#else
 	if (a.type != b.type) return false;
 
 	switch (a.type) {
 		case WAC_VAL_TYPE_NULL: return true;
 		case WAC_VAL_TYPE_BOOL: return WAC_VAL_AS_BOOL(a) == WAC_VAL_AS_BOOL(b);
 		case WAC_VAL_TYPE_NUMBER: return WAC_VAL_AS_NUMBER(a) == WAC_VAL_AS_NUMBER(b);
+		case WAC_VAL_TYPE_INT: return WAC_VAL_AS_INT(a) == WAC_VAL_AS_INT(b);
 		case WAC_VAL_TYPE_OBJ: return WAC_VAL_AS_OBJ(a) == WAC_VAL_AS_OBJ(b);
 		default: return false;
 	}
+#endif
+}
+
+//bits of the value, 1 and 1.0 or 0.0 and -0.0 differ unlike with wac_value_equal
+uint64_t wac_value_bits(wac_value_t value) {
+#ifdef WAC_NAN_BOXING
+	return value;
+#else
+	uint64_t bits = 0;
+	switch (value.type) {
+		case WAC_VAL_TYPE_BOOL: bits = value.as.b; break;
+		case WAC_VAL_TYPE_NUMBER: memcpy(&bits, &value.as.n, sizeof(bits)); break;
+		case WAC_VAL_TYPE_INT: bits = (uint64_t)value.as.i; break;
+		case WAC_VAL_TYPE_OBJ: bits = (uintptr_t)value.as.o; break;
+		default: break;
+	}
+	return bits;
+#endif
+}
+
+//same representation, so one can stand for the other as a constant
+bool wac_value_same(wac_value_t a, wac_value_t b) {
+#ifndef WAC_NAN_BOXING
+	if (a.type != b.type) return false;
+#endif
+	return wac_value_bits(a) == wac_value_bits(b);
+}
+
+//ints and doubles with integral value that fit, for bitwise ops
+bool wac_value_toInt(wac_value_t value, int64_t *i) {
+	double n;
+	if (WAC_VAL_IS_INT(value)) {
+		*i = WAC_VAL_AS_INT(value);
+		return true;
+	}
+	if (!WAC_VAL_IS_NUMBER(value)) return false;
+
+	n = WAC_VAL_AS_NUMBER(value);
+	//2^63 is exact as double, so the range check is too
+	if (!(n >= -9223372036854775808.0 && n < 9223372036854775808.0) || n != (double)(int64_t)n) return false;
+	*i = (int64_t)n;
+	return true;
 }
 
 void wac_valarr_init(wac_state_t *state, wac_valarr_t *valarr) {
@@ -5,11 +5,76 @@
 
 typedef struct wac_obj_s wac_obj_t;
 
+#ifdef WAC_NAN_BOXING
+
+#include <string.h>
+
+//every double that isnt a quiet nan is stored as is
+//everything else lives in the unused bits of quiet nan
+//obj pointers have sign bit set, singletons use the low bits
+//ints have WAC_VAL_INT_TAG and keep only low 48 bits, so int ops wrap around at 48 bits
+typedef uint64_t wac_value_t;
+
+#define WAC_VAL_SIGN_BIT	((uint64_t)0x8000000000000000)
+#define WAC_VAL_QNAN		((uint64_t)0x7ffc000000000000)
+#define WAC_VAL_INT_TAG		((uint64_t)0x0002000000000000)
+#define WAC_VAL_INT_MASK	((uint64_t)0x0000ffffffffffff)
+#define WAC_VAL_INT_SIGN	((uint64_t)0x0000800000000000)
+#define WAC_VAL_INT_MIN		(-(int64_t)WAC_VAL_INT_SIGN)
+#define WAC_VAL_INT_MAX		((int64_t)WAC_VAL_INT_SIGN - 1)
+
+#define WAC_VAL_TAG_NULL	1
+#define WAC_VAL_TAG_FALSE	2
+#define WAC_VAL_TAG_TRUE	3
+#define WAC_VAL_TAG_UNDEF	4
+
+#define WAC_VAL_NULL ((wac_value_t)(WAC_VAL_QNAN | WAC_VAL_TAG_NULL))
+#define WAC_VAL_FALSE ((wac_value_t)(WAC_VAL_QNAN | WAC_VAL_TAG_FALSE))
+#define WAC_VAL_TRUE ((wac_value_t)(WAC_VAL_QNAN | WAC_VAL_TAG_TRUE))
+#define WAC_VAL_UNDEF ((wac_value_t)(WAC_VAL_QNAN | WAC_VAL_TAG_UNDEF))
+#define WAC_VAL_BOOL(value) ((value) ? WAC_VAL_TRUE : WAC_VAL_FALSE)
+#define WAC_VAL_NUMBER(value) wac_value_fromNumber(value)
+#define WAC_VAL_INT(value) ((wac_value_t)(WAC_VAL_QNAN | WAC_VAL_INT_TAG | ((uint64_t)(value) & WAC_VAL_INT_MASK)))
+#define WAC_VAL_OBJ(value) ((wac_value_t)(WAC_VAL_SIGN_BIT | WAC_VAL_QNAN | (uint64_t)(uintptr_t)(value)))
+
+#define WAC_VAL_AS_BOOL(value) ((value) == WAC_VAL_TRUE)
+#define WAC_VAL_AS_NUMBER(value) wac_value_toNumber(value)
+//sign extended from bit 47
+#define WAC_VAL_AS_INT(value) ((int64_t)(((value) & WAC_VAL_INT_MASK) ^ WAC_VAL_INT_SIGN) - (int64_t)WAC_VAL_INT_SIGN)
+#define WAC_VAL_AS_OBJ(value) ((wac_obj_t*)(uintptr_t)((value) & ~(WAC_VAL_SIGN_BIT | WAC_VAL_QNAN)))
+
+#define WAC_VAL_SET_NUMBER(slot, value) ((slot) = wac_value_fromNumber(value))
+#define WAC_VAL_SET_INT(slot, value) ((slot) = WAC_VAL_INT(value))
+
+#define WAC_VAL_IS_NULL(value) ((value) == WAC_VAL_NULL)
+#define WAC_VAL_IS_UNDEF(value) ((value) == WAC_VAL_UNDEF)
+#define WAC_VAL_IS_BOOL(value) (((value) | 1) == WAC_VAL_TRUE)
+#define WAC_VAL_IS_NUMBER(value) (((value) & WAC_VAL_QNAN) != WAC_VAL_QNAN)
+#define WAC_VAL_IS_INT(value) (((value) & (WAC_VAL_SIGN_BIT | WAC_VAL_QNAN | WAC_VAL_INT_TAG)) == (WAC_VAL_QNAN | WAC_VAL_INT_TAG))
+#define WAC_VAL_IS_OBJ(value) (((value) & (WAC_VAL_SIGN_BIT | WAC_VAL_QNAN)) == (WAC_VAL_SIGN_BIT | WAC_VAL_QNAN))
+
+//memcpy coz type punning through pointer cast breaks strict aliasing
+static inline wac_value_t wac_value_fromNumber(double n) {
+	wac_value_t value;
+	memcpy(&value, &n, sizeof(double));
+	return value;
+}
+
+static inline double wac_value_toNumber(wac_value_t value) {
+	double n;
+	memcpy(&n, &value, sizeof(wac_value_t));
+	return n;
+}
+
+#else
+
 typedef enum wac_value_type_e {
 	WAC_VAL_TYPE_NULL,
 	WAC_VAL_TYPE_BOOL,
 	WAC_VAL_TYPE_NUMBER,
+	WAC_VAL_TYPE_INT,
 	WAC_VAL_TYPE_OBJ,
+	WAC_VAL_TYPE_UNDEF,
 } wac_value_type_t;
 
 typedef struct wac_value_s {
@@ -17,6 +82,7 @@ typedef struct wac_value_s {
 	union {
 		bool b;
 		double n;
+		int64_t i;
 		wac_obj_t *o;
 	} as;
 } wac_value_t;
@@ -24,16 +90,38 @@ typedef struct wac_value_s {
 #define WAC_VAL_NULL ((wac_value_t){WAC_VAL_TYPE_NULL, {.n = 0}})
 #define WAC_VAL_BOOL(value) ((wac_value_t){WAC_VAL_TYPE_BOOL, {.b = (value)}})
 #define WAC_VAL_NUMBER(value) ((wac_value_t){WAC_VAL_TYPE_NUMBER, {.n = (value)}})
+#define WAC_VAL_INT(value) ((wac_value_t){WAC_VAL_TYPE_INT, {.i = (value)}})
 #define WAC_VAL_OBJ(value) ((wac_value_t){WAC_VAL_TYPE_OBJ, {.o = (wac_obj_t*)(value)}})
+#define WAC_VAL_UNDEF ((wac_value_t){WAC_VAL_TYPE_UNDEF, {.n = 0}})
+
+#define WAC_VAL_INT_MIN INT64_MIN
+#define WAC_VAL_INT_MAX INT64_MAX
 
 #define WAC_VAL_AS_BOOL(value) ((value).as.b)
 #define WAC_VAL_AS_NUMBER(value) ((value).as.n)
+#define WAC_VAL_AS_INT(value) ((value).as.i)
 #define WAC_VAL_AS_OBJ(value) ((value).as.o)
 
+//slot has to hold value of the same type, only the payload is written
+#define WAC_VAL_SET_NUMBER(slot, value) ((slot).as.n = (value))
+#define WAC_VAL_SET_INT(slot, value) ((slot).as.i = (value))
+
 #define WAC_VAL_IS_NULL(value) ((value).type == WAC_VAL_TYPE_NULL)
 #define WAC_VAL_IS_BOOL(value) ((value).type == WAC_VAL_TYPE_BOOL)
 #define WAC_VAL_IS_NUMBER(value) ((value).type == WAC_VAL_TYPE_NUMBER)
+#define WAC_VAL_IS_INT(value) ((value).type == WAC_VAL_TYPE_INT)
 #define WAC_VAL_IS_OBJ(value) ((value).type == WAC_VAL_TYPE_OBJ)
+#define WAC_VAL_IS_UNDEF(value) ((value).type == WAC_VAL_TYPE_UNDEF)
+
+#endif //WAC_NAN_BOXING
+
+//WAC_VAL_UNDEF is never seen by programs, it marks slots of vm->globals that are not defined yet
+//WAC_VAL_NUMBER is double, WAC_VAL_INT is int64_t (48 bits with nan boxing, from WAC_VAL_INT_MIN to WAC_VAL_INT_MAX)
+//int op int stays int and wraps around, if one side is double both are doubles
+#define WAC_VAL_IS_NUMERIC(value) (WAC_VAL_IS_NUMBER(value) || WAC_VAL_IS_INT(value))
+#define WAC_VAL_TO_NUMBER(value) (WAC_VAL_IS_INT(value) ? (double)WAC_VAL_AS_INT(value) : WAC_VAL_AS_NUMBER(value))
+//(int64_t)(x op y) without signed overflow
+#define WAC_INT_WRAP(x, op, y) ((int64_t)((uint64_t)(x) op (uint64_t)(y)))
 
 typedef struct wac_valarr_s {
 	size_t asize, usize;
@@ -43,6 +131,9 @@ typedef struct wac_valarr_s {
 void wac_value_print(wac_value_t value);
 bool wac_value_falsey(wac_value_t value);
 bool wac_value_equal(wac_value_t a, wac_value_t b);
+uint64_t wac_value_bits(wac_value_t value);
+bool wac_value_same(wac_value_t a, wac_value_t b);
+bool wac_value_toInt(wac_value_t value, int64_t *i);
 void wac_valarr_init(wac_state_t *state, wac_valarr_t *valarr);
 void wac_valarr_write(wac_state_t *state, wac_valarr_t *valarr, wac_value_t value);
 void wac_valarr_free(wac_state_t *state, wac_valarr_t *valarr);
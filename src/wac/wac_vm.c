@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <math.h>
 
 #include "wac_state.h"
 #include "wac_vm.h"
@@ -10,8 +11,9 @@
 #include "wac_value.h"
 #include "wac_object.h"
 #include "wac_compiler.h"
+#include "wac_tier.h"
 
-#ifdef WAC_DEBUG_TRACE_EXEC
+#if defined(WAC_DEBUG_TRACE_EXEC) || defined(WAC_DEBUG_PROFILE_OPS) || defined(WAC_DEBUG_PRINT_CODE)
 #include "wac_debug.h"
 #endif
 
@@ -21,21 +23,58 @@ void wac_defineNativeFun(wac_state_t *state, uint32_t arity, const char *name, w
 	wac_vm_t *vm = &state->vm;
 	wac_vm_push(vm, WAC_VAL_OBJ(wac_obj_string_copy(state, name, strlen(name))));
 	wac_vm_push(vm, WAC_VAL_OBJ(wac_obj_native_init(state, arity, WAC_OBJ_AS_STRING(vm->stack[0]), fun)));
-	wac_table_set(state, &vm->globals, WAC_OBJ_AS_STRING(vm->stack[0]), vm->stack[1]);
+	//index first, coz it can move vm->globals
+	uint32_t index = wac_vm_global_index(state, WAC_OBJ_AS_STRING(vm->stack[0]));
+	vm->globals[index] = vm->stack[1];
+	wac_vm_pop(vm);
 	wac_vm_pop(vm);
+}
+
+//index of global name, new globals stay undefined till WAC_OP_DEFINE_GLOBAL
+uint32_t wac_vm_global_index(wac_state_t *state, wac_obj_string_t *name) {
+	wac_vm_t *vm = &state->vm;
+	wac_value_t index;
+
+	if (wac_table_get(&vm->globalNames, name, &index)) return (uint32_t)WAC_VAL_AS_INT(index);
+
+	wac_vm_push(vm, WAC_VAL_OBJ(name));
+	if (vm->globals_asize <= vm->globals_usize) {
+		size_t oldSize = vm->globals_asize;
+		vm->globals_asize = oldSize ? oldSize * WAC_ARRAY_GROW_MUL : WAC_ARRAY_DEFAULT_SIZE;
+		vm->globals = WAC_ARRAY_GROW(state, wac_value_t, vm->globals, oldSize, vm->globals_asize);
+	}
+	vm->globals[vm->globals_usize] = WAC_VAL_UNDEF;
+	wac_table_set(state, &vm->globalNames, name, WAC_VAL_INT(vm->globals_usize));
 	wac_vm_pop(vm);
+	return (uint32_t)vm->globals_usize++;
+}
+
+//only for errors, so it just walks globalNames
+static wac_obj_string_t* wac_vm_global_name(wac_vm_t *vm, uint32_t index) {
+	size_t i;
+	wac_table_entry_t *entry;
+	for (i = 0; i < vm->globalNames.asize; ++i) {
+		entry = &vm->globalNames.entries[i];
+		if (entry->key && WAC_VAL_AS_INT(entry->value) == index) return entry->key;
+	}
+	return NULL;
 }
 
 static void wac_vm_stack_reset(wac_vm_t *vm) {
+	wac_obj_upval_t *upval;
+	for (upval = vm->openUpvals; upval; upval = upval->next) {
+		vm->upvalSlots[upval->loc - vm->stack] = NULL;
+	}
 	vm->sp = vm->stack;
 	vm->frames_usize = 0;
 	vm->openUpvals = NULL;
 }
 
 static void wac_vm_error(wac_vm_t *vm, const char *fmt, ...) {
-	size_t i;
+	size_t i, line;
 	wac_obj_fun_t *fun;
 	wac_frame_t *frame;
+	wac_page_inlined_t *inlined;
 
 	va_list args;
 	va_start(args, fmt);
@@ -47,7 +86,14 @@ static void wac_vm_error(wac_vm_t *vm, const char *fmt, ...) {
 	for (i = vm->frames_usize - 1; i != ((size_t)-1); --i) {
 		frame = &vm->frames[i];
 		fun = frame->closure->fun;
-		fprintf(stderr, "[%u] ", fun->page.lines[frame->ip - fun->page.code - 1]);
+		line = fun->page.lines[frame->ip - fun->page.code - 1];
+		//inlined function is shown as if it had its own frame
+		if (line & WAC_PAGE_LINE_INLINED) {
+			inlined = &fun->page.inlined[line & ~WAC_PAGE_LINE_INLINED];
+			fprintf(stderr, "[%zu] %s()\n", inlined->line, inlined->fun->name->buf);
+			line = inlined->at;
+		}
+		fprintf(stderr, "[%u] ", line);
 
 		if (fun->name) {
 			fprintf(stderr, "%s()\n", fun->name->buf);
@@ -62,8 +108,33 @@ static void wac_vm_error(wac_vm_t *vm, const char *fmt, ...) {
 void wac_vm_init(wac_state_t *state) {
 	wac_vm_t *vm = &state->vm;
 
-	vm->stack_asize = WAC_ARRAY_DEFAULT_SIZE;
-	vm->stack = WAC_ARRAY_INIT_NOGC(wac_value_t, vm->stack_asize);
+	if (!wac_vmem_reserve(&vm->stack_vmem, sizeof(wac_value_t) * WAC_STACK_MAX)
+		|| !wac_vmem_commit(&vm->stack_vmem, sizeof(wac_value_t) * WAC_ARRAY_DEFAULT_SIZE)
+	) {
+		fprintf(stderr, "[-] Failed to reserve memory for vm->stack\n");
+		exit(1);
+	}
+	vm->stack = (wac_value_t*)vm->stack_vmem.base;
+	vm->stack_asize = vm->stack_vmem.committed / sizeof(wac_value_t);
+
+	//committed pages are zeroed, so all slots start with no upval
+	if (!wac_vmem_reserve(&vm->upvalSlots_vmem, sizeof(wac_obj_upval_t*) * WAC_STACK_MAX)
+		|| !wac_vmem_commit(&vm->upvalSlots_vmem, sizeof(wac_obj_upval_t*) * vm->stack_asize)
+	) {
+		fprintf(stderr, "[-] Failed to reserve memory for vm->upvalSlots\n");
+		exit(1);
+	}
+	vm->upvalSlots = (wac_obj_upval_t**)vm->upvalSlots_vmem.base;
+	vm->openUpvals = NULL;
+
+	if (!wac_vmem_reserve(&vm->frames_vmem, sizeof(wac_frame_t) * WAC_FRAMES_MAX)
+		|| !wac_vmem_commit(&vm->frames_vmem, sizeof(wac_frame_t) * WAC_ARRAY_DEFAULT_SIZE)
+	) {
+		fprintf(stderr, "[-] Failed to reserve memory for vm->frames\n");
+		exit(1);
+	}
+	vm->frames = (wac_frame_t*)vm->frames_vmem.base;
+	vm->frames_asize = vm->frames_vmem.committed / sizeof(wac_frame_t);
 
 	wac_vm_stack_reset(vm);
 
@@ -71,6 +142,10 @@ void wac_vm_init(wac_state_t *state) {
 	vm->grays_asize = WAC_ARRAY_DEFAULT_SIZE;
 	vm->grays = WAC_ARRAY_INIT_NOGC(wac_obj_t*, vm->grays_asize);
 
+#ifdef WAC_DEBUG_PROFILE_OPS
+	wac_profile_init(&vm->profile);
+#endif
+
 	vm->objs = NULL;
 
 	vm->mem_total = 0;
@@ -80,56 +155,76 @@ void wac_vm_init(wac_state_t *state) {
 
 	//coz the gc loops over vm->strings
 	vm->strings.asize = 0;
+	vm->globalNames.asize = 0;
+	vm->globalConsts.asize = 0;
+	vm->globals_asize = 0;
+	vm->globals_usize = 0;
+	vm->globals = NULL;
 	vm->initString = NULL;
+	vm->shapeRoot = NULL;
+	wac_vm_methods_clear(vm);
 
-	wac_table_init(state, &vm->globals);
+	wac_table_init(state, &vm->globalNames);
+	wac_table_init(state, &vm->globalConsts);
 	wac_table_init(state, &vm->strings);
 	vm->initString = wac_obj_string_copy(state, "init", 4);
-
-	vm->frames_asize = WAC_ARRAY_DEFAULT_SIZE;
-	vm->frames = WAC_ARRAY_INIT(state, wac_frame_t, vm->frames_asize);
+	vm->shapeRoot = wac_shape_init(state, NULL, NULL);
 }
 
-static wac_frame_t* wac_vm_newFrame(wac_state_t *state) {
-	wac_vm_t *vm = &state->vm;
-
+//wac_vm_call checked WAC_FRAMES_MAX, so commit can only fail if os is out of memory
+static wac_frame_t* wac_vm_newFrame(wac_vm_t *vm) {
 	if (vm->frames_asize <= vm->frames_usize) {
-		size_t oldSize = vm->frames_asize;
-		vm->frames_asize *= WAC_ARRAY_GROW_MUL;
-		vm->frames = WAC_ARRAY_GROW(state, wac_frame_t, vm->frames, oldSize, vm->frames_asize);
+		if (!wac_vmem_commit(&vm->frames_vmem, sizeof(wac_frame_t) * (vm->frames_usize + 1))) {
+			fprintf(stderr, "[-] Failed to commit memory for vm->frames\n");
+			exit(1);
+		}
+		vm->frames_asize = vm->frames_vmem.committed / sizeof(wac_frame_t);
 	}
 	return &vm->frames[vm->frames_usize++];
 }
 
+//stack never moves, so bp of frames and open upvals stay valid
+static void wac_vm_stack_commit(wac_vm_t *vm, size_t minSize) {
+	if (!wac_vmem_commit(&vm->stack_vmem, sizeof(wac_value_t) * minSize)) {
+		fprintf(stderr, "[-] Failed to commit memory for vm->stack\n");
+		exit(1);
+	}
+	vm->stack_asize = vm->stack_vmem.committed / sizeof(wac_value_t);
+	if (!wac_vmem_commit(&vm->upvalSlots_vmem, sizeof(wac_obj_upval_t*) * vm->stack_asize)) {
+		fprintf(stderr, "[-] Failed to commit memory for vm->upvalSlots\n");
+		exit(1);
+	}
+}
 
+//space is reserved for the whole frame in wac_vm_call, so no check here
 void wac_vm_push(wac_vm_t *vm, wac_value_t value) {
-	size_t stackIndex = vm->sp - vm->stack;
-	if (vm->stack_asize <= stackIndex) {
-		size_t newSize = vm->stack_asize * WAC_ARRAY_GROW_MUL, i, j;
-		wac_obj_upval_t *upval;
-		wac_value_t *newStack = WAC_ARRAY_INIT_NOGC(wac_value_t, newSize);
-
-		for (i = 0; i < stackIndex; ++i) {
-			newStack[i] = vm->stack[i];
-		}
+#ifdef WAC_DEBUG_STACK_CHECK
+	if (vm->sp >= vm->stack + vm->stack_asize) {
+		fprintf(stderr, "[-] Error: stack overflow, max stack depth is wrong\n");
+		exit(1);
+	}
+#endif
+	*vm->sp++ = value;
+}
 
-		for (i = 0; i < vm->frames_usize; ++i) {
-			for (j = 0; j < vm->frames[i].closure->upvals_usize; ++j) {
-				upval = vm->frames[i].closure->upvals[j];
-				if (upval->loc != &upval->closed) {
-					upval->loc = &newStack[upval->loc - vm->stack];
-				}
-			}
-			vm->frames[i].bp = &newStack[vm->frames[i].bp - vm->stack];
-		}
+void wac_vm_methods_clear(wac_vm_t *vm) {
+	memset(vm->methods, 0, sizeof(vm->methods));
+}
 
-		free(vm->stack);
-		vm->stack = newStack;
-		vm->stack_asize = newSize;
+static inline wac_vm_methodEntry_t* wac_vm_methods_entry(wac_vm_t *vm, wac_obj_class_t *klass, wac_obj_string_t *name) {
+	return &vm->methods[(((uintptr_t)klass >> 4) ^ name->hash) & (WAC_VM_METHOD_CACHE_SIZE - 1)];
+}
 
-		vm->sp = &vm->stack[stackIndex];
-	}
-	*vm->sp++ = value;
+//method of klass, NULL when it has none
+static wac_obj_closure_t* wac_vm_methods_get(wac_vm_t *vm, wac_obj_class_t *klass, wac_obj_string_t *name) {
+	wac_vm_methodEntry_t *entry = wac_vm_methods_entry(vm, klass, name);
+	wac_value_t method;
+	if (entry->klass == klass && entry->name == name) return entry->method;
+	if (!wac_table_get(&klass->methods, name, &method)) return NULL;
+	entry->klass = klass;
+	entry->name = name;
+	entry->method = WAC_OBJ_AS_CLOSURE(method);
+	return entry->method;
 }
 
 wac_value_t wac_vm_pop(wac_vm_t *vm) {
@@ -163,18 +258,58 @@ static void wac_vm_concat(wac_state_t *state) {
 	wac_vm_push(vm, WAC_VAL_OBJ(result));
 }
 
-static bool wac_vm_call(wac_state_t *state, wac_obj_closure_t *closure, uint32_t argc) {
-	if (closure->fun->arity != argc) {
-		wac_vm_error(&state->vm, "Expected %u arguments, but got %u", closure->fun->arity, argc);
+//arity has to be checked already
+//code of fun is rewritten only when none of the first frames_usize frames runs it,
+//otherwise it is tried again after another WAC_TIER_HOT_CALLS calls
+static void wac_vm_tierUp(wac_state_t *state, wac_obj_fun_t *fun, size_t frames_usize) {
+	size_t i;
+	for (i = 0; i < frames_usize; ++i) {
+		if (state->vm.frames[i].closure->fun == fun) {
+			fun->hotCalls = WAC_TIER_HOT_CALLS;
+			return;
+		}
+	}
+	wac_tier_optimize(state, fun);
+#ifdef WAC_DEBUG_PRINT_CODE
+	wac_page_disass(&fun->page, fun->name ? fun->name->buf : "<script>");
+#endif
+}
+
+static bool wac_vm_call_exact(wac_state_t *state, wac_obj_closure_t *closure, uint32_t argc) {
+	wac_vm_t *vm = &state->vm;
+	size_t base = vm->sp - vm->stack - argc - 1, top;
+
+	//the tier can give the function more stack, so it runs first
+	if (closure->fun->hotCalls && --closure->fun->hotCalls == 0) wac_vm_tierUp(state, closure->fun, vm->frames_usize);
+
+	top = base + closure->fun->maxStack + WAC_STACK_SLACK;
+	if (vm->stack_asize < top) {
+		if (top > WAC_STACK_MAX) {
+			wac_vm_error(vm, "Stack overflow");
+			return false;
+		}
+		wac_vm_stack_commit(vm, top);
+	}
+	if (vm->frames_usize == WAC_FRAMES_MAX) {
+		wac_vm_error(vm, "Stack overflow");
 		return false;
 	}
-	wac_frame_t *newFrame = wac_vm_newFrame(state);
+
+	wac_frame_t *newFrame = wac_vm_newFrame(vm);
 	newFrame->closure = closure;
 	newFrame->ip = closure->fun->page.code;
-	newFrame->bp = state->vm.sp - argc - 1;
+	newFrame->bp = vm->stack + base;
 	return true;
 }
 
+static bool wac_vm_call(wac_state_t *state, wac_obj_closure_t *closure, uint32_t argc) {
+	if (closure->fun->arity != argc) {
+		wac_vm_error(&state->vm, "Expected %u arguments, but got %u", closure->fun->arity, argc);
+		return false;
+	}
+	return wac_vm_call_exact(state, closure, argc);
+}
+
 static bool wac_vm_call_value(wac_state_t *state, wac_value_t callee, uint32_t argc) {
 	wac_vm_t *vm = &state->vm;
 	if (WAC_VAL_IS_OBJ(callee)) {
@@ -194,10 +329,9 @@ static bool wac_vm_call_value(wac_state_t *state, wac_value_t callee, uint32_t a
 				return wac_vm_call(state, WAC_OBJ_AS_CLOSURE(callee), argc);
 			case WAC_OBJ_CLASS: {
 				wac_obj_class_t *klass = WAC_OBJ_AS_CLASS(callee);
-				vm->sp[-argc - 1] = WAC_VAL_OBJ(wac_obj_instance_init(state, klass));
-				wac_value_t init;
-				if (wac_table_get(&klass->methods, vm->initString, &init)) {
-					return wac_vm_call(state, WAC_OBJ_AS_CLOSURE(init), argc);
+				vm->sp[-(ptrdiff_t)argc - 1] = WAC_VAL_OBJ(wac_obj_instance_init(state, klass));
+				if (klass->init) {
+					return wac_vm_call(state, klass->init, argc);
 				} else if (argc) {
 					wac_vm_error(vm, "Expected 0 arguments, but got %u", argc);
 					return false;
@@ -206,7 +340,7 @@ static bool wac_vm_call_value(wac_state_t *state, wac_value_t callee, uint32_t a
 			}
 			case WAC_OBJ_BOUND: {
 				wac_obj_bound_t *bound = WAC_OBJ_AS_BOUND(callee);
-				vm->sp[-argc - 1] = bound->receiver;
+				vm->sp[-(ptrdiff_t)argc - 1] = bound->receiver;
 				return wac_vm_call(state, bound->method, argc);
 			}
 			default:
@@ -218,20 +352,21 @@ static bool wac_vm_call_value(wac_state_t *state, wac_value_t callee, uint32_t a
 }
 
 static wac_obj_upval_t* wac_vm_captureUpval(wac_state_t *state, wac_value_t *local) {
-	wac_obj_upval_t *prev = NULL, *curr = state->vm.openUpvals;
+	wac_obj_upval_t **slot = &state->vm.upvalSlots[local - state->vm.stack];
+	wac_obj_upval_t *prev = NULL, *curr;
+
+	if (*slot) return *slot;
 
+	wac_obj_upval_t *upval = wac_obj_upval_init(state, local);
+
+	//list is sorted for closing, captured locals are mostly in the top frame, near its head
+	curr = state->vm.openUpvals;
 	while (curr && curr->loc > local) {
 		prev = curr;
 		curr = curr->next;
 	}
 
-	if (curr && curr->loc == local) {
-		return curr;
-	}
-
-
-	wac_obj_upval_t *upval = wac_obj_upval_init(state, local);
-
+	*slot = upval;
 	upval->next = curr;
 	if (prev) {
 		prev->next = upval;
@@ -241,70 +376,218 @@ static wac_obj_upval_t* wac_vm_captureUpval(wac_state_t *state, wac_value_t *loc
 	return upval;
 }
 
+//upval that is closed from the start, for locals that are never assigned
+static wac_obj_upval_t* wac_vm_copyUpval(wac_state_t *state, wac_value_t value) {
+	wac_obj_upval_t *upval = wac_obj_upval_init(state, NULL);
+	upval->closed = value;
+	upval->loc = &upval->closed;
+	return upval;
+}
+
 static void wac_vm_closeUpvals(wac_vm_t *vm, wac_value_t *last) {
 	wac_obj_upval_t *upval;
 	while (vm->openUpvals && vm->openUpvals->loc >= last) {
 		upval = vm->openUpvals;
+		vm->upvalSlots[upval->loc - vm->stack] = NULL;
 		upval->closed = *upval->loc;
 		upval->loc = &upval->closed;
 		vm->openUpvals = upval->next;
 	}
 }
 
-//nameStack is set to true when we call from WAC_OP_GET_PROPERTY
-static bool wac_vm_bindMethod(wac_state_t *state, wac_obj_class_t *klass, wac_obj_string_t *name, bool nameStack) {
+//callee and args slide down to bp of the current frame, which then runs closure from the start
+static bool wac_vm_tailCall(wac_state_t *state, wac_obj_closure_t *closure, uint32_t argc) {
 	wac_vm_t *vm = &state->vm;
-	wac_value_t method;
-	wac_obj_bound_t *bound;
+	wac_frame_t *frame = &vm->frames[vm->frames_usize - 1];
+	size_t top;
 
-	if (!wac_table_get(&klass->methods, name, &method)) {
-		wac_vm_error(vm, "Undefined property '%s'", name->buf);
+	if (closure->fun->arity != argc) {
+		wac_vm_error(vm, "Expected %u arguments, but got %u", closure->fun->arity, argc);
 		return false;
 	}
+	//the current frame is replaced, so it does not hold the code
+	if (closure->fun->hotCalls && --closure->fun->hotCalls == 0) wac_vm_tierUp(state, closure->fun, vm->frames_usize - 1);
+
+	top = frame->bp - vm->stack + closure->fun->maxStack + WAC_STACK_SLACK;
+	if (vm->stack_asize < top) {
+		if (top > WAC_STACK_MAX) {
+			wac_vm_error(vm, "Stack overflow");
+			return false;
+		}
+		wac_vm_stack_commit(vm, top);
+	}
 
-	bound = wac_obj_bound_init(state, wac_vm_peek(vm, nameStack ? 1 : 0), WAC_OBJ_AS_CLOSURE(method));
+	if (frame->closure->fun->closesUpvals) wac_vm_closeUpvals(vm, frame->bp);
+	memmove(frame->bp, vm->sp - argc - 1, sizeof(wac_value_t) * (argc + 1));
+	vm->sp = frame->bp + argc + 1;
+	frame->closure = closure;
+	frame->ip = closure->fun->page.code;
+	return true;
+}
+
+//nameStack is set to true when we call from WAC_OP_GET_PROPERTY
+static void wac_vm_bindClosure(wac_state_t *state, wac_obj_closure_t *method, bool nameStack) {
+	wac_vm_t *vm = &state->vm;
+	wac_obj_bound_t *bound = wac_obj_bound_init(state, wac_vm_peek(vm, nameStack ? 1 : 0), method);
 	if (nameStack) wac_vm_pop(vm);
 	wac_vm_pop(vm);
 	wac_vm_push(vm, WAC_VAL_OBJ(bound));
-	return true;
 }
 
-static bool wac_vm_invokeFromClass(wac_state_t *state, wac_obj_class_t *klass, uint32_t argc) {
+//instance cached by shape, field entries also by key, method entries by class and its version
+static wac_page_propertyEntry_t* wac_vm_property_find(wac_page_propertyCache_t *cache, wac_obj_instance_t *instance, wac_obj_string_t *key) {
+	size_t i;
+	wac_page_propertyEntry_t *entry;
+	if (cache->usize > WAC_PAGE_PIC_SIZE) return NULL;
+	for (i = 0; i < cache->usize; ++i) {
+		entry = &cache->entries[i];
+		if (entry->shape == instance->shape && entry->key == key
+			&& (!entry->method || (entry->klass == instance->klass && entry->version == instance->klass->version))
+		) return entry;
+	}
+	return NULL;
+}
+
+//new entry for instances with shape, NULL when the instruction is megamorphic
+static wac_page_propertyEntry_t* wac_vm_property_add(wac_page_propertyCache_t *cache, wac_shape_t *shape, wac_obj_string_t *key) {
+	wac_page_propertyEntry_t *entry;
+	if (!shape || cache->usize > WAC_PAGE_PIC_SIZE) return NULL;
+	if (cache->usize == WAC_PAGE_PIC_SIZE) {
+		++cache->usize;
+		return NULL;
+	}
+	entry = &cache->entries[cache->usize++];
+	entry->shape = shape;
+	entry->next = NULL;
+	entry->key = key;
+	entry->klass = NULL;
+	entry->method = NULL;
+	entry->version = 0;
+	entry->slot = 0;
+	return entry;
+}
+
+//replaces instance (and name with nameStack) on the stack with its property
+static bool wac_vm_getProperty(wac_state_t *state, wac_page_propertyCache_t *cache, wac_obj_string_t *name, bool nameStack) {
 	wac_vm_t *vm = &state->vm;
-	wac_obj_string_t *name = WAC_OBJ_AS_STRING(wac_vm_peek(vm, argc));
-	wac_value_t method;
-	if (!wac_table_get(&klass->methods, name, &method)) {
-		wac_vm_error(vm, "Undefined property '%s'", name->buf);
-		return false;
+	wac_obj_instance_t *instance = WAC_OBJ_AS_INSTANCE(wac_vm_peek(vm, nameStack ? 1 : 0));
+	wac_page_propertyEntry_t *entry = wac_vm_property_find(cache, instance, name);
+	wac_value_t value;
+	size_t slot;
+
+	if (entry) {
+		if (entry->method) {
+			wac_vm_bindClosure(state, entry->method, nameStack);
+			return true;
+		}
+		value = *wac_obj_instance_slot(instance, entry->slot);
+	} else if (instance->dict ? wac_table_get(instance->dict, name, &value) : wac_shape_find(instance->shape, name, &slot)) {
+		if (!instance->dict) {
+			value = *wac_obj_instance_slot(instance, slot);
+			if ((entry = wac_vm_property_add(cache, instance->shape, name))) entry->slot = slot;
+		}
+	} else {
+		wac_obj_closure_t *method = wac_vm_methods_get(vm, instance->klass, name);
+		if (!method) {
+			wac_vm_error(vm, "Undefined property '%s'", name->buf);
+			return false;
+		}
+		if ((entry = wac_vm_property_add(cache, instance->shape, name))) {
+			entry->klass = instance->klass;
+			entry->method = method;
+			entry->version = instance->klass->version;
+		}
+		wac_vm_bindClosure(state, method, nameStack);
+		return true;
 	}
-	for (wac_value_t *value = vm->sp - (argc + 1); value < (vm->sp - 1); ++value) {
-		*value = value[1];
+
+	if (nameStack) wac_vm_pop(vm);
+	vm->sp[-1] = value;
+	return true;
+}
+
+//instance, (name with nameStack,) value on the stack, leaves the value
+static void wac_vm_setProperty(wac_state_t *state, wac_page_propertyCache_t *cache, wac_obj_string_t *name, bool nameStack) {
+	wac_vm_t *vm = &state->vm;
+	wac_obj_instance_t *instance = WAC_OBJ_AS_INSTANCE(wac_vm_peek(vm, nameStack ? 2 : 1));
+	wac_value_t value = wac_vm_peek(vm, 0);
+	wac_page_propertyEntry_t *entry = wac_vm_property_find(cache, instance, name);
+	wac_shape_t *shape = instance->shape;
+	size_t slot;
+
+	//adding the field needs room in overflow, growing it is left to wac_obj_instance_set
+	if (entry && (!entry->next || entry->slot < WAC_OBJ_INSTANCE_INLINE
+		|| entry->slot - WAC_OBJ_INSTANCE_INLINE < instance->overflow_asize)
+	) {
+		*wac_obj_instance_slot(instance, entry->slot) = value;
+		if (entry->next) instance->shape = entry->next;
+	} else if (!entry && shape && wac_shape_find(shape, name, &slot)) {
+		*wac_obj_instance_slot(instance, slot) = value;
+		if ((entry = wac_vm_property_add(cache, shape, name))) entry->slot = slot;
+	} else {
+		wac_obj_instance_set(state, instance, name, value);
+		if (!entry && shape && instance->shape && instance->shape->parent == shape
+			&& (entry = wac_vm_property_add(cache, shape, name))
+		) {
+			entry->next = instance->shape;
+			entry->slot = shape->count;
+		}
 	}
-	--vm->sp;
 
-	return wac_vm_call(state, WAC_OBJ_AS_CLOSURE(method), argc);
+	vm->sp -= nameStack ? 2 : 1;
+	vm->sp[-1] = value;
+}
+
+//method of superclass for super.name, kept in the cache of the instruction
+//superclass is the same on every run, unless the class declaration itself runs again
+static wac_obj_closure_t* wac_vm_superMethod(wac_state_t *state, wac_page_propertyCache_t *cache, wac_obj_class_t *superclass, wac_obj_string_t *name) {
+	wac_page_propertyEntry_t *entry = &cache->entries[0];
+	wac_obj_closure_t *method;
+
+	if (cache->usize && entry->klass == superclass && entry->version == superclass->version) return entry->method;
+
+	method = wac_vm_methods_get(&state->vm, superclass, name);
+	if (!method) {
+		wac_vm_error(&state->vm, "Undefined property '%s'", name->buf);
+		return NULL;
+	}
+	entry->shape = NULL;
+	entry->next = NULL;
+	entry->klass = superclass;
+	entry->method = method;
+	entry->version = superclass->version;
+	cache->usize = 1;
+	return method;
 }
 
-static bool wac_vm_invoke(wac_state_t *state, uint32_t argc) {
+static bool wac_vm_invoke(wac_state_t *state, wac_obj_string_t *name, uint32_t argc) {
 	wac_vm_t *vm = &state->vm;
 	wac_value_t field;
-	if (!WAC_OBJ_IS_INSTANCE(wac_vm_peek(vm, argc + 1))) {
+	if (!WAC_OBJ_IS_INSTANCE(wac_vm_peek(vm, argc))) {
 		wac_vm_error(vm, "Only instances have methods");
 		return false;
 	}
 
-	wac_obj_instance_t *instance = WAC_OBJ_AS_INSTANCE(wac_vm_peek(vm, argc + 1));
+	wac_obj_instance_t *instance = WAC_OBJ_AS_INSTANCE(wac_vm_peek(vm, argc));
 
-	if (wac_table_get(&instance->fields, WAC_OBJ_AS_STRING(wac_vm_peek(vm, argc)), &field)) {
-		vm->sp[-argc - 2] = field;
-		for (wac_value_t *value = vm->sp - (argc + 1); value < (vm->sp - 1); ++value) {
-			*value = value[1];
-		}
-		--vm->sp;
+	//field holding something callable replaces the receiver
+	if (wac_obj_instance_get(instance, name, &field)) {
+		vm->sp[-(ptrdiff_t)argc - 1] = field;
 		return wac_vm_call_value(state, field, argc);
 	}
 
-	return wac_vm_invokeFromClass(state, instance->klass, argc);
+	//receiver and args are already where the method wants them
+	wac_obj_closure_t *method = wac_vm_methods_get(vm, instance->klass, name);
+	if (!method) {
+		wac_vm_error(vm, "Undefined property '%s'", name->buf);
+		return false;
+	}
+	//accessor gives its field without a frame, when the field is not there it runs to report that
+	if (method->fun->getter && !argc && wac_obj_instance_get(instance, method->fun->getter, &field)) {
+		vm->sp[-1] = field;
+		return true;
+	}
+	return wac_vm_call(state, method, argc);
 }
 
 wac_interpretResult_t wac_interpret(wac_state_t *state, const char *src) {
@@ -321,125 +604,496 @@ wac_interpretResult_t wac_interpret(wac_state_t *state, const char *src) {
 	return wac_vm_run(state);
 }
 
+//negative count shifts right, which keeps the sign, so ints with and without nan boxing agree
+//64 and more gives 0 to the left, 0 or -1 to the right
+int64_t wac_vm_shl(int64_t x, int64_t y) {
+	if (y >= 64) return 0;
+	if (y >= 0) return (int64_t)((uint64_t)x << y);
+	if (y <= -64) return x < 0 ? -1 : 0;
+	return x < 0 ? ~(int64_t)(~(uint64_t)x >> -y) : (int64_t)((uint64_t)x >> -y);
+}
+
+#ifdef WAC_DEBUG_TRACE_EXEC
+static void wac_vm_trace(wac_vm_t *vm, wac_frame_t *frame) {
+	for (wac_value_t *value = vm->stack; value < vm->sp; ++value) {
+		printf("[ ");
+		wac_value_print(*value);
+		printf(" ]");
+	}
+	printf("\n");
+	wac_inst_disass(&frame->closure->fun->page, frame->ip - frame->closure->fun->page.code);
+}
+#endif
+
+#ifdef WAC_DEBUG_STACK_CHECK
+//between instructions the stack has to be within what compiler computed
+static void wac_vm_stack_check(wac_vm_t *vm, wac_frame_t *frame) {
+	wac_obj_fun_t *fun = frame->closure->fun;
+	if (vm->sp > frame->bp + fun->maxStack) {
+		fprintf(stderr, "[-] Error: stack depth %td is over max %zu of %s\n", vm->sp - frame->bp, fun->maxStack, fun->name ? fun->name->buf : "<script>");
+		exit(1);
+	}
+}
+#endif
+
 static wac_interpretResult_t wac_vm_run(wac_state_t *state) {
 #define WAC_READ_BYTE() (*frame->ip++)
-#define WAC_READ_4_BYTES() ((WAC_READ_BYTE() << 24) | (WAC_READ_BYTE() << 16) | (WAC_READ_BYTE() << 8) | WAC_READ_BYTE())
-#define WAC_READ_CONST() (frame->closure->fun->page.consts.values[WAC_READ_4_BYTES()])
+#define WAC_READ_2_BYTES() (frame->ip += 2, (uint16_t)((frame->ip[-2] << 8) | frame->ip[-1]))
+#define WAC_READ_4_BYTES() (frame->ip += 4, (uint32_t)((frame->ip[-4] << 24) | (frame->ip[-3] << 16) | (frame->ip[-2] << 8) | frame->ip[-1]))
+#define WAC_READ_CONST() (frame->closure->fun->page.consts.values[arg])
 #define WAC_READ_STRING() (WAC_OBJ_AS_STRING(WAC_READ_CONST()))
-#define WAC_BIN_OP(valueType, op) \
+//x and y are int64_t if both operands are ints, otherwise doubles
+#define WAC_NUM_OP(intValue, numValue) \
+	do {\
+		a = wac_vm_peek(vm, 1);\
+		b = wac_vm_peek(vm, 0);\
+		if (WAC_VAL_IS_INT(a) && WAC_VAL_IS_INT(b)) {\
+			int64_t x = WAC_VAL_AS_INT(a), y = WAC_VAL_AS_INT(b);\
+			result = (intValue);\
+		} else if (WAC_VAL_IS_NUMERIC(a) && WAC_VAL_IS_NUMERIC(b)) {\
+			double x = WAC_VAL_TO_NUMBER(a), y = WAC_VAL_TO_NUMBER(b);\
+			result = (numValue);\
+		} else {\
+			wac_vm_error(vm, "Operands must be numbers");\
+			return WAC_INTERPRET_RUNTIME_ERROR;\
+		}\
+		--vm->sp;\
+		vm->sp[-1] = result;\
+	} while (false)
+#define WAC_BIN_OP(op) WAC_NUM_OP(WAC_VAL_INT(WAC_INT_WRAP(x, op, y)), WAC_VAL_NUMBER(x op y))
+#define WAC_CMP_OP(valueType, op) WAC_NUM_OP(valueType(x op y), valueType(x op y))
+//int division and modulo truncate like in c
+#define WAC_INT_DIV_OP(intValue, numValue) \
+	do {\
+		if (WAC_VAL_IS_INT(wac_vm_peek(vm, 0)) && WAC_VAL_AS_INT(wac_vm_peek(vm, 0)) == 0 && WAC_VAL_IS_INT(wac_vm_peek(vm, 1))) {\
+			wac_vm_error(vm, "Division by zero");\
+			return WAC_INTERPRET_RUNTIME_ERROR;\
+		}\
+		WAC_NUM_OP(intValue, numValue);\
+	} while (false)
+//bitwise ops take ints and doubles with integral value
+#define WAC_BIT_OP(intValue) \
+	do {\
+		int64_t x, y;\
+		if (!wac_value_toInt(wac_vm_peek(vm, 1), &x) || !wac_value_toInt(wac_vm_peek(vm, 0), &y)) {\
+			wac_vm_error(vm, "Operands must be integers");\
+			return WAC_INTERPRET_RUNTIME_ERROR;\
+		}\
+		--vm->sp;\
+		vm->sp[-1] = WAC_VAL_INT(intValue);\
+	} while (false)
+//compare of numeric a and b
+#define WAC_NUM_CMP(op) \
+	((WAC_VAL_IS_INT(a) && WAC_VAL_IS_INT(b)) ? WAC_VAL_AS_INT(a) op WAC_VAL_AS_INT(b) : WAC_VAL_TO_NUMBER(a) op WAC_VAL_TO_NUMBER(b))
+
+#ifdef WAC_DEBUG_TRACE_EXEC
+#define WAC_VM_TRACE() wac_vm_trace(vm, frame)
+#else
+#define WAC_VM_TRACE() do {} while (false)
+#endif
+
+#ifdef WAC_DEBUG_PROFILE_OPS
+#define WAC_VM_PROFILE() wac_profile_record(&vm->profile, *frame->ip)
+#else
+#define WAC_VM_PROFILE() do {} while (false)
+#endif
+
+#ifdef WAC_DEBUG_STACK_CHECK
+#define WAC_VM_STACK_CHECK() wac_vm_stack_check(vm, frame)
+#else
+#define WAC_VM_STACK_CHECK() do {} while (false)
+#endif
+
+//both the label and the case are emitted, so the switch is still
+//used for the first dispatch (and whole time without computed goto)
+#ifdef WAC_COMPUTED_GOTO
+#define WAC_VM_CASE(op) wac_vm_label_##op: case op
+#define WAC_VM_TARGET(op) [op] = __extension__ &&wac_vm_label_##op
+#define WAC_VM_NEXT() \
 	do {\
-		if (!WAC_VAL_IS_NUMBER(wac_vm_peek(vm, 0)) || !WAC_VAL_IS_NUMBER(wac_vm_peek(vm, 1))) {\
+		WAC_VM_TRACE();\
+		WAC_VM_PROFILE();\
+		WAC_VM_STACK_CHECK();\
+		__extension__ ({ goto *wac_vm_dispatch[WAC_READ_BYTE()]; });\
+	} while (false)
+
+	static void *wac_vm_dispatch[] = {
+		WAC_VM_TARGET(WAC_OP_CONST),
+		WAC_VM_TARGET(WAC_OP_CONST_LONG),
+		WAC_VM_TARGET(WAC_OP_NULL),
+		WAC_VM_TARGET(WAC_OP_TRUE),
+		WAC_VM_TARGET(WAC_OP_FALSE),
+		WAC_VM_TARGET(WAC_OP_CLOSURE),
+		WAC_VM_TARGET(WAC_OP_CLOSURE_LONG),
+		WAC_VM_TARGET(WAC_OP_CLASS),
+		WAC_VM_TARGET(WAC_OP_CLASS_LONG),
+		WAC_VM_TARGET(WAC_OP_METHOD),
+		WAC_VM_TARGET(WAC_OP_METHOD_LONG),
+		WAC_VM_TARGET(WAC_OP_INHERIT),
+		WAC_VM_TARGET(WAC_OP_POP),
+		WAC_VM_TARGET(WAC_OP_POPN),
+		WAC_VM_TARGET(WAC_OP_POPN_LONG),
+		WAC_VM_TARGET(WAC_OP_GET_LOCAL),
+		WAC_VM_TARGET(WAC_OP_GET_LOCAL_LONG),
+		WAC_VM_TARGET(WAC_OP_SET_LOCAL),
+		WAC_VM_TARGET(WAC_OP_SET_LOCAL_LONG),
+		WAC_VM_TARGET(WAC_OP_GET_UPVAL),
+		WAC_VM_TARGET(WAC_OP_GET_UPVAL_LONG),
+		WAC_VM_TARGET(WAC_OP_SET_UPVAL),
+		WAC_VM_TARGET(WAC_OP_SET_UPVAL_LONG),
+		WAC_VM_TARGET(WAC_OP_GET_GLOBAL),
+		WAC_VM_TARGET(WAC_OP_GET_GLOBAL_LONG),
+		WAC_VM_TARGET(WAC_OP_SET_GLOBAL),
+		WAC_VM_TARGET(WAC_OP_SET_GLOBAL_LONG),
+		WAC_VM_TARGET(WAC_OP_GET_PROPERTY),
+		WAC_VM_TARGET(WAC_OP_GET_PROPERTY_LONG),
+		WAC_VM_TARGET(WAC_OP_SET_PROPERTY),
+		WAC_VM_TARGET(WAC_OP_SET_PROPERTY_LONG),
+		WAC_VM_TARGET(WAC_OP_GET_PROPERTY_CONST),
+		WAC_VM_TARGET(WAC_OP_GET_PROPERTY_CONST_LONG),
+		WAC_VM_TARGET(WAC_OP_SET_PROPERTY_CONST),
+		WAC_VM_TARGET(WAC_OP_SET_PROPERTY_CONST_LONG),
+		WAC_VM_TARGET(WAC_OP_GET_SUPER),
+		WAC_VM_TARGET(WAC_OP_GET_SUPER_LONG),
+		WAC_VM_TARGET(WAC_OP_CLOSE_UPVAL),
+		WAC_VM_TARGET(WAC_OP_DEFINE_GLOBAL),
+		WAC_VM_TARGET(WAC_OP_DEFINE_GLOBAL_LONG),
+		WAC_VM_TARGET(WAC_OP_NOT),
+		WAC_VM_TARGET(WAC_OP_EQUAL),
+		WAC_VM_TARGET(WAC_OP_GREATER),
+		WAC_VM_TARGET(WAC_OP_LESS),
+		WAC_VM_TARGET(WAC_OP_NEG),
+		WAC_VM_TARGET(WAC_OP_ADD),
+		WAC_VM_TARGET(WAC_OP_SUB),
+		WAC_VM_TARGET(WAC_OP_MUL),
+		WAC_VM_TARGET(WAC_OP_DIV),
+		WAC_VM_TARGET(WAC_OP_MOD),
+		WAC_VM_TARGET(WAC_OP_IDIV),
+		WAC_VM_TARGET(WAC_OP_BAND),
+		WAC_VM_TARGET(WAC_OP_BOR),
+		WAC_VM_TARGET(WAC_OP_BXOR),
+		WAC_VM_TARGET(WAC_OP_SHL),
+		WAC_VM_TARGET(WAC_OP_SHR),
+		WAC_VM_TARGET(WAC_OP_BNOT),
+		WAC_VM_TARGET(WAC_OP_JMP_FORW),
+		WAC_VM_TARGET(WAC_OP_JMP_BACK),
+		WAC_VM_TARGET(WAC_OP_JMP_BACK_LONG),
+		WAC_VM_TARGET(WAC_OP_JMP_TRUE),
+		WAC_VM_TARGET(WAC_OP_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_JMP_FORW_LONG),
+		WAC_VM_TARGET(WAC_OP_JMP_TRUE_LONG),
+		WAC_VM_TARGET(WAC_OP_JMP_FALSE_LONG),
+		WAC_VM_TARGET(WAC_OP_CALL),
+		WAC_VM_TARGET(WAC_OP_CALL_LONG),
+		WAC_VM_TARGET(WAC_OP_INVOKE),
+		WAC_VM_TARGET(WAC_OP_INVOKE_LONG),
+		WAC_VM_TARGET(WAC_OP_TAIL_CALL),
+		WAC_VM_TARGET(WAC_OP_TAIL_CALL_LONG),
+		WAC_VM_TARGET(WAC_OP_SUPER_INVOKE),
+		WAC_VM_TARGET(WAC_OP_SUPER_INVOKE_LONG),
+		WAC_VM_TARGET(WAC_OP_CALL_INLINE),
+		WAC_VM_TARGET(WAC_OP_RET_INLINE),
+		WAC_VM_TARGET(WAC_OP_RET_INLINE_LONG),
+		WAC_VM_TARGET(WAC_OP_GET_SCALAR),
+		WAC_VM_TARGET(WAC_OP_GET_SCALAR_LONG),
+		WAC_VM_TARGET(WAC_OP_SET_SCALAR),
+		WAC_VM_TARGET(WAC_OP_SET_SCALAR_LONG),
+		WAC_VM_TARGET(WAC_OP_RET),
+		WAC_VM_TARGET(WAC_OP_ADD_T),
+		WAC_VM_TARGET(WAC_OP_SUB_T),
+		WAC_VM_TARGET(WAC_OP_MUL_T),
+		WAC_VM_TARGET(WAC_OP_DIV_T),
+		WAC_VM_TARGET(WAC_OP_EQUAL_T),
+		WAC_VM_TARGET(WAC_OP_GREATER_T),
+		WAC_VM_TARGET(WAC_OP_LESS_T),
+		WAC_VM_TARGET(WAC_OP_ADD_R),
+		WAC_VM_TARGET(WAC_OP_SUB_R),
+		WAC_VM_TARGET(WAC_OP_MUL_R),
+		WAC_VM_TARGET(WAC_OP_DIV_R),
+		WAC_VM_TARGET(WAC_OP_EQUAL_R),
+		WAC_VM_TARGET(WAC_OP_GREATER_R),
+		WAC_VM_TARGET(WAC_OP_LESS_R),
+		WAC_VM_TARGET(WAC_OP_GET_LOCAL_2),
+		WAC_VM_TARGET(WAC_OP_GET_LOCAL_CONST),
+		WAC_VM_TARGET(WAC_OP_GET_LOCAL_PROPERTY),
+		WAC_VM_TARGET(WAC_OP_SET_LOCAL_POP),
+		WAC_VM_TARGET(WAC_OP_NOT_EQUAL),
+		WAC_VM_TARGET(WAC_OP_GREATER_EQUAL),
+		WAC_VM_TARGET(WAC_OP_LESS_EQUAL),
+		WAC_VM_TARGET(WAC_OP_EQUAL_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_NOT_EQUAL_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_GREATER_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_GREATER_EQUAL_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_LESS_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_LESS_EQUAL_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_ADD_NUM_NUM),
+		WAC_VM_TARGET(WAC_OP_LESS_NUM),
+		WAC_VM_TARGET(WAC_OP_ADD_INT_INT),
+		WAC_VM_TARGET(WAC_OP_LESS_INT),
+		WAC_VM_TARGET(WAC_OP_CALL_CLOSURE_EXACT_ARITY),
+		WAC_VM_TARGET(WAC_OP_CALL_CLOSURE_EXACT_ARITY_LONG),
+		WAC_VM_TARGET(WAC_OP_ADD_II),
+		WAC_VM_TARGET(WAC_OP_SUB_II),
+		WAC_VM_TARGET(WAC_OP_MUL_II),
+		WAC_VM_TARGET(WAC_OP_ADD_DD),
+		WAC_VM_TARGET(WAC_OP_SUB_DD),
+		WAC_VM_TARGET(WAC_OP_MUL_DD),
+		WAC_VM_TARGET(WAC_OP_DIV_DD),
+		WAC_VM_TARGET(WAC_OP_GREATER_II_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_GREATER_EQUAL_II_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_LESS_II_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_LESS_EQUAL_II_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_GREATER_DD_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_GREATER_EQUAL_DD_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_LESS_DD_JMP_FALSE),
+		WAC_VM_TARGET(WAC_OP_LESS_EQUAL_DD_JMP_FALSE),
+	};
+#else
+#define WAC_VM_CASE(op) case op
+#define WAC_VM_NEXT() continue
+#endif
+
+//short form reads 1 byte operand, long form 4 bytes, both into arg
+#define WAC_VM_CASE_ARG(op) \
+	WAC_VM_CASE(op##_LONG):\
+		arg = WAC_READ_4_BYTES();\
+		goto wac_vm_arg_##op;\
+	WAC_VM_CASE(op):\
+		arg = WAC_READ_BYTE();\
+	wac_vm_arg_##op:
+
+//two operands into arg and arg2, both 1 byte or both 4 bytes
+#define WAC_VM_CASE_ARG2(op) \
+	WAC_VM_CASE(op##_LONG):\
+		arg = WAC_READ_4_BYTES();\
+		arg2 = WAC_READ_4_BYTES();\
+		goto wac_vm_arg_##op;\
+	WAC_VM_CASE(op):\
+		arg = WAC_READ_BYTE();\
+		arg2 = WAC_READ_BYTE();\
+	wac_vm_arg_##op:
+
+//three operands into arg, arg2 and arg3
+#define WAC_VM_CASE_ARG3(op) \
+	WAC_VM_CASE(op##_LONG):\
+		arg = WAC_READ_4_BYTES();\
+		arg2 = WAC_READ_4_BYTES();\
+		arg3 = WAC_READ_4_BYTES();\
+		goto wac_vm_arg_##op;\
+	WAC_VM_CASE(op):\
+		arg = WAC_READ_BYTE();\
+		arg2 = WAC_READ_BYTE();\
+		arg3 = WAC_READ_BYTE();\
+	wac_vm_arg_##op:
+
+//same with at pointing to the opcode, so the instruction can be quickened
+#define WAC_VM_CASE_ARG_AT(op) \
+	WAC_VM_CASE(op##_LONG):\
+		at = frame->ip - 1;\
+		arg = WAC_READ_4_BYTES();\
+		goto wac_vm_arg_##op;\
+	WAC_VM_CASE(op):\
+		at = frame->ip - 1;\
+		arg = WAC_READ_BYTE();\
+	wac_vm_arg_##op:
+
+//rewrites instruction at to other op keeping its operand size, _LONG is always op + 1
+#define WAC_VM_QUICKEN(from, to) (*at = (to) + (*at - (from)))
+
+//register ops, operands are read from the slots or constants
+//result is stored at wac_vm_reg_store, _T form also makes it top of the stack
+#define WAC_READ_RK(x) (((x) & WAC_RK_CONST) ? frame->closure->fun->page.consts.values[(x) & WAC_RK_INDEX_MAX] : frame->bp[x])
+#define WAC_VM_CASE_REG(op) \
+	WAC_VM_CASE(op##_R):\
+		reg = true;\
+		goto wac_vm_reg_##op;\
+	WAC_VM_CASE(op##_T):\
+		reg = false;\
+	wac_vm_reg_##op:\
+		a = WAC_READ_RK(frame->ip[1]);\
+		b = WAC_READ_RK(frame->ip[2]);
+#define WAC_REG_NUM_OP(intValue, numValue) \
+	do {\
+		if (WAC_VAL_IS_INT(a) && WAC_VAL_IS_INT(b)) {\
+			int64_t x = WAC_VAL_AS_INT(a), y = WAC_VAL_AS_INT(b);\
+			result = (intValue);\
+		} else if (WAC_VAL_IS_NUMERIC(a) && WAC_VAL_IS_NUMERIC(b)) {\
+			double x = WAC_VAL_TO_NUMBER(a), y = WAC_VAL_TO_NUMBER(b);\
+			result = (numValue);\
+		} else {\
 			wac_vm_error(vm, "Operands must be numbers");\
 			return WAC_INTERPRET_RUNTIME_ERROR;\
 		}\
-		double b = WAC_VAL_AS_NUMBER(wac_vm_pop(vm));\
-		double a = WAC_VAL_AS_NUMBER(wac_vm_pop(vm));\
-		wac_vm_push(vm, valueType(a op b));\
+		goto wac_vm_reg_store;\
+	} while (false)
+#define WAC_REG_OP(op) WAC_REG_NUM_OP(WAC_VAL_INT(WAC_INT_WRAP(x, op, y)), WAC_VAL_NUMBER(x op y))
+#define WAC_REG_CMP(op) WAC_REG_NUM_OP(WAC_VAL_BOOL(x op y), WAC_VAL_BOOL(x op y))
+
+//compare, JMP_FALSE, POP in one
+//when it jumps, false is left on the stack like JMP_FALSE does
+#define WAC_CMP_JMP_FALSE(numbers, cond) \
+	do {\
+		uint16_t address = WAC_READ_2_BYTES();\
+		a = wac_vm_peek(vm, 1);\
+		b = wac_vm_peek(vm, 0);\
+		if ((numbers) && (!WAC_VAL_IS_NUMERIC(a) || !WAC_VAL_IS_NUMERIC(b))) {\
+			wac_vm_error(vm, "Operands must be numbers");\
+			return WAC_INTERPRET_RUNTIME_ERROR;\
+		}\
+		if (cond) {\
+			vm->sp -= 2;\
+		} else {\
+			--vm->sp;\
+			vm->sp[-1] = WAC_VAL_BOOL(false);\
+			frame->ip += address;\
+		}\
+	} while (false)
+#define WAC_VAL_BOOL_NOT(x) WAC_VAL_BOOL(!(x))
+
+//typed ops, wac_infer_types proved the operands, so only the payload is written
+#ifdef WAC_DEBUG_STACK_CHECK
+#define WAC_TYPED_CHECK(isType) \
+	do {\
+		if (!isType(vm->sp[-2]) || !isType(vm->sp[-1])) {\
+			fprintf(stderr, "[-] Error: inferred type of operands is wrong\n");\
+			exit(1);\
+		}\
+	} while (false)
+#else
+#define WAC_TYPED_CHECK(isType) do {} while (false)
+#endif
+#define WAC_TYPED_INT_OP(op) \
+	do {\
+		WAC_TYPED_CHECK(WAC_VAL_IS_INT);\
+		--vm->sp;\
+		WAC_VAL_SET_INT(vm->sp[-1], WAC_INT_WRAP(WAC_VAL_AS_INT(vm->sp[-1]), op, WAC_VAL_AS_INT(vm->sp[0])));\
+	} while (false)
+#define WAC_TYPED_NUM_OP(op) \
+	do {\
+		WAC_TYPED_CHECK(WAC_VAL_IS_NUMBER);\
+		--vm->sp;\
+		WAC_VAL_SET_NUMBER(vm->sp[-1], WAC_VAL_AS_NUMBER(vm->sp[-1]) op WAC_VAL_AS_NUMBER(vm->sp[0]));\
+	} while (false)
+#define WAC_TYPED_JMP_FALSE(isType, cond) \
+	do {\
+		WAC_TYPED_CHECK(isType);\
+		WAC_CMP_JMP_FALSE(false, cond);\
 	} while (false)
 
 	wac_vm_t *vm = &state->vm;
 	wac_frame_t *frame = &vm->frames[vm->frames_usize - 1];
 
-	uint8_t inst;
+	uint8_t inst, *at;
+	uint32_t arg, arg2, arg3;
+	wac_value_t a, b, result;
+	bool reg;
 	for (;;) {
-#ifdef WAC_DEBUG_TRACE_EXEC
-		for (wac_value_t *value = vm->stack; value < vm->sp; ++value) {
-			printf("[ ");
-			wac_value_print(*value);
-			printf(" ]");
-		}
-		printf("\n");
-		wac_inst_disass(&frame->closure->fun->page, frame->ip - frame->closure->fun->page.code);
-#endif
+		WAC_VM_TRACE();
+		WAC_VM_PROFILE();
+		WAC_VM_STACK_CHECK();
 		switch (inst = WAC_READ_BYTE()) {
-			case WAC_OP_CONST:
+			WAC_VM_CASE_ARG(WAC_OP_CONST)
 				wac_vm_push(vm, WAC_READ_CONST());
-				break;
-			case WAC_OP_NULL:
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_NULL):
 				wac_vm_push(vm, WAC_VAL_NULL);
-				break;
-			case WAC_OP_TRUE:
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_TRUE):
 				wac_vm_push(vm, WAC_VAL_BOOL(true));
-				break;
-			case WAC_OP_FALSE:
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_FALSE):
 				wac_vm_push(vm, WAC_VAL_BOOL(false));
-				break;
-			case WAC_OP_CLOSURE: {
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_CLOSURE) {
 				size_t i;
-				uint8_t isLocal;
+				uint8_t flags;
 				uint32_t index;
 				wac_obj_closure_t *closure = wac_obj_closure_init(state, WAC_OBJ_AS_FUN(WAC_READ_CONST()));
 				wac_vm_push(vm, WAC_VAL_OBJ(closure));
 
 				for (i = 0; i < closure->upvals_usize; ++i) {
-					isLocal = WAC_READ_BYTE();
-					index = WAC_READ_4_BYTES();
+					flags = WAC_READ_BYTE();
+					index = (flags & WAC_UPVAL_LONG) ? WAC_READ_4_BYTES() : WAC_READ_BYTE();
 
-					if (isLocal) {
+					if (flags & WAC_UPVAL_COPY) {
+						closure->upvals[i] = wac_vm_copyUpval(state, frame->bp[index]);
+					} else if (flags & WAC_UPVAL_LOCAL) {
 						closure->upvals[i] = wac_vm_captureUpval(state, frame->bp + index);
 					} else {
 						closure->upvals[i] = frame->closure->upvals[index];
 					}
 				}
-				break;
+				WAC_VM_NEXT();
 			}
-			case WAC_OP_CLASS:
+			WAC_VM_CASE_ARG(WAC_OP_CLASS)
 				wac_vm_push(vm, WAC_VAL_OBJ(wac_obj_class_init(state, WAC_READ_STRING())));
-				break;
-			case WAC_OP_METHOD:
-				wac_table_set(state, &WAC_OBJ_AS_CLASS(wac_vm_peek(vm, 1))->methods, WAC_READ_STRING(), wac_vm_peek(vm, 0));
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_METHOD) {
+				wac_obj_class_t *klass = WAC_OBJ_AS_CLASS(wac_vm_peek(vm, 1));
+				wac_obj_string_t *name = WAC_READ_STRING();
+				wac_obj_closure_t *method = WAC_OBJ_AS_CLOSURE(wac_vm_peek(vm, 0));
+				wac_vm_methodEntry_t *entry = wac_vm_methods_entry(vm, klass, name);
+				wac_table_set(state, &klass->methods, name, WAC_VAL_OBJ(method));
+				++klass->version;
+				//(klass, name) can only be in this one entry
+				if (entry->klass == klass && entry->name == name) entry->klass = NULL;
+				if (name == vm->initString) klass->init = method;
 				wac_vm_pop(vm);
-				break;
-			case WAC_OP_POP:
+				WAC_VM_NEXT();
+			}
+			WAC_VM_CASE(WAC_OP_INHERIT): {
+				wac_obj_class_t *klass = WAC_OBJ_AS_CLASS(wac_vm_peek(vm, 0));
+				wac_obj_class_t *superclass;
+				if (!WAC_OBJ_IS_CLASS(wac_vm_peek(vm, 1))) {
+					wac_vm_error(vm, "Superclass must be a class");
+					return WAC_INTERPRET_RUNTIME_ERROR;
+				}
+				//methods of the body come after this and override copied ones
+				superclass = WAC_OBJ_AS_CLASS(wac_vm_peek(vm, 1));
+				wac_table_addAll(state, &superclass->methods, &klass->methods);
+				klass->init = superclass->init;
+				++klass->version;
 				wac_vm_pop(vm);
-				break;
-			case WAC_OP_POPN:
+				WAC_VM_NEXT();
+			}
+			WAC_VM_CASE(WAC_OP_POP):
+				wac_vm_pop(vm);
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_POPN)
 #ifdef WAC_DEBUG_STACK_CHECK
-			{
-				uint32_t n = WAC_READ_4_BYTES();
-				if (vm->sp - vm->stack < n) {
+				if (vm->sp - vm->stack < arg) {
 					fprintf(stderr, "[-] Error: stack underflow\n");
 				}
-				vm->sp -= n;
-			}
-#else
-				vm->sp -= WAC_READ_4_BYTES();
 #endif
-				break;
-			case WAC_OP_GET_LOCAL:
-				wac_vm_push(vm, frame->bp[WAC_READ_4_BYTES()]);
-				break;
-			case WAC_OP_SET_LOCAL:
-				frame->bp[WAC_READ_4_BYTES()] = wac_vm_peek(vm, 0);
-				break;
-			case WAC_OP_GET_UPVAL:
-				wac_vm_push(vm, *frame->closure->upvals[WAC_READ_4_BYTES()]->loc);
-				break;
-			case WAC_OP_SET_UPVAL:
-				*frame->closure->upvals[WAC_READ_4_BYTES()]->loc = wac_vm_peek(vm, 0);
-				break;
-			case WAC_OP_GET_GLOBAL: {
-				wac_obj_string_t *name = WAC_READ_STRING();
-				wac_value_t value;
-
-				if (!wac_table_get(&vm->globals, name, &value)) {
-					wac_vm_error(vm, "Undefined variable '%s'", name->buf);
+				vm->sp -= arg;
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_GET_LOCAL)
+				wac_vm_push(vm, frame->bp[arg]);
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_SET_LOCAL)
+				frame->bp[arg] = wac_vm_peek(vm, 0);
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_GET_UPVAL)
+				wac_vm_push(vm, *frame->closure->upvals[arg]->loc);
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_SET_UPVAL)
+				*frame->closure->upvals[arg]->loc = wac_vm_peek(vm, 0);
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_GET_GLOBAL)
+				if (WAC_VAL_IS_UNDEF(vm->globals[arg])) {
+					wac_vm_error(vm, "Undefined variable '%s'", wac_vm_global_name(vm, arg)->buf);
 					return WAC_INTERPRET_RUNTIME_ERROR;
 				}
-
-				wac_vm_push(vm, value);
-				break;
-			}
-			case WAC_OP_SET_GLOBAL: {
-				wac_obj_string_t *name = WAC_READ_STRING();
-				if (wac_table_set(state, &vm->globals, name, wac_vm_peek(vm, 0))) {
-					wac_table_delete(&vm->globals, name);
-					wac_vm_error(vm, "Undefined variable '%s'", name->buf);
+				wac_vm_push(vm, vm->globals[arg]);
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_SET_GLOBAL)
+				if (WAC_VAL_IS_UNDEF(vm->globals[arg])) {
+					wac_vm_error(vm, "Undefined variable '%s'", wac_vm_global_name(vm, arg)->buf);
 					return WAC_INTERPRET_RUNTIME_ERROR;
 				}
-				break;
-			}
-			case WAC_OP_GET_PROPERTY: {
+				vm->globals[arg] = wac_vm_peek(vm, 0);
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_GET_PROPERTY)
 				if (!WAC_OBJ_IS_INSTANCE(wac_vm_peek(vm, 1))) {
 					wac_vm_error(vm, "Only instances have properties");
 					return WAC_INTERPRET_RUNTIME_ERROR;
@@ -448,22 +1102,11 @@ static wac_interpretResult_t wac_vm_run(wac_state_t *state) {
 					wac_vm_error(vm, "You can only use strings to access properties");
 					return WAC_INTERPRET_RUNTIME_ERROR;
 				}
-				wac_obj_instance_t *instance = WAC_OBJ_AS_INSTANCE(wac_vm_peek(vm, 1));
-				wac_obj_string_t *name = WAC_OBJ_AS_STRING(wac_vm_peek(vm, 0));
-				wac_value_t value;
-				if (wac_table_get(&instance->fields, name, &value)) {
-					wac_vm_pop(vm);
-					wac_vm_pop(vm);
-					wac_vm_push(vm, value);
-					break;
-				}
-
-				if (!wac_vm_bindMethod(state, instance->klass, name, true)) {
+				if (!wac_vm_getProperty(state, &frame->closure->fun->page.props[arg], WAC_OBJ_AS_STRING(wac_vm_peek(vm, 0)), true)) {
 					return WAC_INTERPRET_RUNTIME_ERROR;
 				}
-				break;
-			}
-			case WAC_OP_SET_PROPERTY: {
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_SET_PROPERTY)
 				if (!WAC_OBJ_IS_INSTANCE(wac_vm_peek(vm, 2))) {
 					wac_vm_error(vm, "Only instances have fields");
 					return WAC_INTERPRET_RUNTIME_ERROR;
@@ -472,102 +1115,257 @@ static wac_interpretResult_t wac_vm_run(wac_state_t *state) {
 					wac_vm_error(vm, "You can only use strings to access fields");
 					return WAC_INTERPRET_RUNTIME_ERROR;
 				}
-				wac_obj_instance_t *instance = WAC_OBJ_AS_INSTANCE(wac_vm_peek(vm, 2));
-				wac_table_set(state, &instance->fields, WAC_OBJ_AS_STRING(wac_vm_peek(vm, 1)), wac_vm_peek(vm, 0));
-				wac_value_t value = wac_vm_pop(vm);
-				wac_vm_pop(vm);
+				wac_vm_setProperty(state, &frame->closure->fun->page.props[arg], WAC_OBJ_AS_STRING(wac_vm_peek(vm, 1)), true);
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG2(WAC_OP_GET_PROPERTY_CONST)
+				if (!WAC_OBJ_IS_INSTANCE(wac_vm_peek(vm, 0))) {
+					wac_vm_error(vm, "Only instances have properties");
+					return WAC_INTERPRET_RUNTIME_ERROR;
+				}
+				if (!wac_vm_getProperty(state, &frame->closure->fun->page.props[arg2], WAC_READ_STRING(), false)) {
+					return WAC_INTERPRET_RUNTIME_ERROR;
+				}
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG2(WAC_OP_SET_PROPERTY_CONST)
+				if (!WAC_OBJ_IS_INSTANCE(wac_vm_peek(vm, 1))) {
+					wac_vm_error(vm, "Only instances have fields");
+					return WAC_INTERPRET_RUNTIME_ERROR;
+				}
+				wac_vm_setProperty(state, &frame->closure->fun->page.props[arg2], WAC_READ_STRING(), false);
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG2(WAC_OP_GET_SUPER) {
+				wac_obj_closure_t *method = wac_vm_superMethod(state, &frame->closure->fun->page.props[arg2], WAC_OBJ_AS_CLASS(wac_vm_peek(vm, 0)), WAC_READ_STRING());
+				wac_obj_bound_t *bound;
+				if (!method) return WAC_INTERPRET_RUNTIME_ERROR;
+				bound = wac_obj_bound_init(state, wac_vm_peek(vm, 1), method);
 				wac_vm_pop(vm);
-				wac_vm_push(vm, value);
-				break;
+				vm->sp[-1] = WAC_VAL_OBJ(bound);
+				WAC_VM_NEXT();
 			}
-			case WAC_OP_CLOSE_UPVAL:
+			WAC_VM_CASE(WAC_OP_CLOSE_UPVAL):
 				wac_vm_closeUpvals(vm, vm->sp - 1);
 				wac_vm_pop(vm);
-				break;
-			case WAC_OP_DEFINE_GLOBAL:
-				wac_table_set(state, &vm->globals, WAC_READ_STRING(), wac_vm_peek(vm, 0));
-				wac_vm_pop(vm);
-				break;
-			case WAC_OP_NOT:
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_DEFINE_GLOBAL)
+				vm->globals[arg] = wac_vm_pop(vm);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_NOT):
 				//wac_vm_push(vm, WAC_VAL_BOOL(wac_value_falsey(wac_vm_pop(vm))));
 				vm->sp[-1] = WAC_VAL_BOOL(wac_value_falsey(vm->sp[-1]));
-				break;
-			case WAC_OP_EQUAL: {
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_EQUAL): {
 				wac_value_t a = wac_vm_pop(vm);
 				wac_value_t b = wac_vm_pop(vm);
 				wac_vm_push(vm, WAC_VAL_BOOL(wac_value_equal(a, b)));
-				break;
+				WAC_VM_NEXT();
 			}
-			case WAC_OP_GREATER:
-				WAC_BIN_OP(WAC_VAL_BOOL, >);
-				break;
-			case WAC_OP_LESS:
-				WAC_BIN_OP(WAC_VAL_BOOL, <);
-				break;
-			case WAC_OP_NEG:
+			WAC_VM_CASE(WAC_OP_GREATER):
+				WAC_CMP_OP(WAC_VAL_BOOL, >);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_LESS):
+				WAC_CMP_OP(WAC_VAL_BOOL, <);
+				if (WAC_VAL_IS_INT(a) && WAC_VAL_IS_INT(b)) {
+					frame->ip[-1] = WAC_OP_LESS_INT;
+				} else if (WAC_VAL_IS_NUMBER(a) && WAC_VAL_IS_NUMBER(b)) {
+					frame->ip[-1] = WAC_OP_LESS_NUM;
+				}
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_NEG):
+				if (WAC_VAL_IS_INT(wac_vm_peek(vm, 0))) {
+					vm->sp[-1] = WAC_VAL_INT(WAC_INT_WRAP(0, -, WAC_VAL_AS_INT(vm->sp[-1])));
+					WAC_VM_NEXT();
+				}
 				if (!WAC_VAL_IS_NUMBER(wac_vm_peek(vm, 0))) {
 					wac_vm_error(vm, "Operand must be a number");
 					return WAC_INTERPRET_RUNTIME_ERROR;
 				}
 				//wac_vm_push(vm, WAC_VAL_NUMBER(-WAC_VAL_AS_NUMBER(wac_vm_pop(vm))));
 				vm->sp[-1] = WAC_VAL_NUMBER(-WAC_VAL_AS_NUMBER(vm->sp[-1]));
-				break;
-			case WAC_OP_ADD: {
-				if (WAC_OBJ_IS_STRING(wac_vm_peek(vm, 0)) && WAC_OBJ_IS_STRING(wac_vm_peek(vm, 0))) {
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_ADD): {
+				if (WAC_OBJ_IS_STRING(wac_vm_peek(vm, 0)) && WAC_OBJ_IS_STRING(wac_vm_peek(vm, 1))) {
 					wac_vm_concat(state);
-				} else if (WAC_VAL_IS_NUMBER(wac_vm_peek(vm, 0)) && WAC_VAL_IS_NUMBER(wac_vm_peek(vm, 0))) {
-					double b = WAC_VAL_AS_NUMBER(wac_vm_pop(vm));
-					double a = WAC_VAL_AS_NUMBER(wac_vm_pop(vm));
-					wac_vm_push(vm, WAC_VAL_NUMBER(a + b));
+				} else if (WAC_VAL_IS_NUMERIC(wac_vm_peek(vm, 0)) && WAC_VAL_IS_NUMERIC(wac_vm_peek(vm, 1))) {
+					WAC_BIN_OP(+);
+					if (WAC_VAL_IS_INT(a) && WAC_VAL_IS_INT(b)) {
+						frame->ip[-1] = WAC_OP_ADD_INT_INT;
+					} else if (WAC_VAL_IS_NUMBER(a) && WAC_VAL_IS_NUMBER(b)) {
+						frame->ip[-1] = WAC_OP_ADD_NUM_NUM;
+					}
 				} else {
 					wac_vm_error(vm, "Operands must be two numbers or two strings");
+					return WAC_INTERPRET_RUNTIME_ERROR;
 				}
-				break;
+				WAC_VM_NEXT();
 			}
-			case WAC_OP_SUB:
-				WAC_BIN_OP(WAC_VAL_NUMBER, -);
-				break;
-			case WAC_OP_MUL:
-				WAC_BIN_OP(WAC_VAL_NUMBER, *);
-				break;
-			case WAC_OP_DIV:
-				WAC_BIN_OP(WAC_VAL_NUMBER, /);
-				break;
-			case WAC_OP_JMP_FORW: {
-				uint32_t address = WAC_READ_4_BYTES();
+			WAC_VM_CASE(WAC_OP_SUB):
+				WAC_BIN_OP(-);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_MUL):
+				WAC_BIN_OP(*);
+				WAC_VM_NEXT();
+			//always double, ~/ is int division
+			WAC_VM_CASE(WAC_OP_DIV):
+				WAC_NUM_OP(WAC_VAL_NUMBER((double)x / (double)y), WAC_VAL_NUMBER(x / y));
+				WAC_VM_NEXT();
+			//-1 is special coz INT64_MIN / -1 overflows
+			WAC_VM_CASE(WAC_OP_MOD):
+				WAC_INT_DIV_OP(WAC_VAL_INT(y == -1 ? 0 : x % y), WAC_VAL_NUMBER(fmod(x, y)));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_IDIV):
+				WAC_INT_DIV_OP(WAC_VAL_INT(y == -1 ? WAC_INT_WRAP(0, -, x) : x / y), WAC_VAL_NUMBER(trunc(x / y)));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_BAND):
+				WAC_BIT_OP(x & y);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_BOR):
+				WAC_BIT_OP(x | y);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_BXOR):
+				WAC_BIT_OP(x ^ y);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_SHL):
+				WAC_BIT_OP(wac_vm_shl(x, y));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_SHR):
+				WAC_BIT_OP(wac_vm_shl(x, y <= -64 ? 64 : -y));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_BNOT): {
+				int64_t x;
+				if (!wac_value_toInt(wac_vm_peek(vm, 0), &x)) {
+					wac_vm_error(vm, "Operand must be an integer");
+					return WAC_INTERPRET_RUNTIME_ERROR;
+				}
+				vm->sp[-1] = WAC_VAL_INT(~x);
+				WAC_VM_NEXT();
+			}
+			WAC_VM_CASE(WAC_OP_JMP_FORW): {
+				uint16_t address = WAC_READ_2_BYTES();
 				frame->ip += address;
-				break;
+				WAC_VM_NEXT();
+			}
+			WAC_VM_CASE_ARG(WAC_OP_JMP_BACK)
+				frame->ip -= arg;
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_JMP_TRUE): {
+				uint16_t address = WAC_READ_2_BYTES();
+				if (!wac_value_falsey(wac_vm_peek(vm, 0))) frame->ip += address;
+				WAC_VM_NEXT();
+			}
+			WAC_VM_CASE(WAC_OP_JMP_FALSE): {
+				uint16_t address = WAC_READ_2_BYTES();
+				if (wac_value_falsey(wac_vm_peek(vm, 0))) frame->ip += address;
+				WAC_VM_NEXT();
 			}
-			case WAC_OP_JMP_BACK: {
+			WAC_VM_CASE(WAC_OP_JMP_FORW_LONG): {
 				uint32_t address = WAC_READ_4_BYTES();
-				frame->ip -= address;
-				break;
+				frame->ip += address;
+				WAC_VM_NEXT();
 			}
-			case WAC_OP_JMP_TRUE: {
+			WAC_VM_CASE(WAC_OP_JMP_TRUE_LONG): {
 				uint32_t address = WAC_READ_4_BYTES();
 				if (!wac_value_falsey(wac_vm_peek(vm, 0))) frame->ip += address;
-				break;
+				WAC_VM_NEXT();
 			}
-			case WAC_OP_JMP_FALSE: {
+			WAC_VM_CASE(WAC_OP_JMP_FALSE_LONG): {
 				uint32_t address = WAC_READ_4_BYTES();
 				if (wac_value_falsey(wac_vm_peek(vm, 0))) frame->ip += address;
-				break;
+				WAC_VM_NEXT();
 			}
-			case WAC_OP_CALL: {
-				uint32_t argc = WAC_READ_4_BYTES();
-				if (!wac_vm_call_value(state, wac_vm_peek(vm, argc), argc)) return WAC_INTERPRET_RUNTIME_ERROR;
+			WAC_VM_CASE_ARG_AT(WAC_OP_CALL)
+				b = wac_vm_peek(vm, arg);
+				if (WAC_OBJ_IS_CLOSURE(b) && WAC_OBJ_AS_CLOSURE(b)->fun->arity == arg) {
+					WAC_VM_QUICKEN(WAC_OP_CALL, WAC_OP_CALL_CLOSURE_EXACT_ARITY);
+				}
+				if (!wac_vm_call_value(state, b, arg)) return WAC_INTERPRET_RUNTIME_ERROR;
 				frame = &vm->frames[vm->frames_usize - 1];
-				break;
-			}
-			case WAC_OP_INVOKE:
-				if (!wac_vm_invoke(state, WAC_READ_4_BYTES())) {
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG(WAC_OP_TAIL_CALL)
+				b = wac_vm_peek(vm, arg);
+				if (WAC_OBJ_IS_CLOSURE(b)) {
+					if (!wac_vm_tailCall(state, WAC_OBJ_AS_CLOSURE(b), arg)) return WAC_INTERPRET_RUNTIME_ERROR;
+					WAC_VM_NEXT();
+				}
+				if (!wac_vm_call_value(state, b, arg)) return WAC_INTERPRET_RUNTIME_ERROR;
+				frame = &vm->frames[vm->frames_usize - 1];
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG2(WAC_OP_INVOKE)
+				if (!wac_vm_invoke(state, WAC_READ_STRING(), arg2)) {
 					return WAC_INTERPRET_RUNTIME_ERROR;
 				}
 				frame = &vm->frames[vm->frames_usize - 1];
-				break;
-			case WAC_OP_RET: {
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG3(WAC_OP_SUPER_INVOKE) {
+				wac_obj_closure_t *method = wac_vm_superMethod(state, &frame->closure->fun->page.props[arg3], WAC_OBJ_AS_CLASS(wac_vm_pop(vm)), WAC_READ_STRING());
+				if (!method || !wac_vm_call(state, method, arg2)) {
+					return WAC_INTERPRET_RUNTIME_ERROR;
+				}
+				frame = &vm->frames[vm->frames_usize - 1];
+				WAC_VM_NEXT();
+			}
+			WAC_VM_CASE(WAC_OP_CALL_INLINE): {
+				arg = frame->ip[0];
+				arg2 = frame->ip[1];
+				uint16_t address = (uint16_t)((frame->ip[2] << 8) | frame->ip[3]);
+				frame->ip += 4;
+				b = wac_vm_peek(vm, arg2);
+				//a class is the callee of a scalar replaced instance, its fields follow
+				if (wac_value_equal(b, WAC_READ_CONST())
+					|| (WAC_OBJ_IS_CLASS(b) && WAC_OBJ_AS_CLASS(b)->init == WAC_OBJ_AS_CLOSURE(WAC_READ_CONST()))
+				) WAC_VM_NEXT();
+				frame->ip += address;
+				if (!wac_vm_call_value(state, b, arg2)) return WAC_INTERPRET_RUNTIME_ERROR;
+				frame = &vm->frames[vm->frames_usize - 1];
+				WAC_VM_NEXT();
+			}
+			WAC_VM_CASE_ARG(WAC_OP_RET_INLINE)
+				vm->sp[-(ptrdiff_t)arg - 1] = vm->sp[-1];
+				vm->sp -= arg;
+				WAC_VM_NEXT();
+			//local holds the class until a guard failed and made the instance
+			WAC_VM_CASE(WAC_OP_GET_SCALAR_LONG):
+				a = frame->bp[WAC_READ_4_BYTES()];
+				arg3 = WAC_READ_4_BYTES();
+				arg = WAC_READ_4_BYTES();
+				arg2 = WAC_READ_4_BYTES();
+				goto wac_vm_get_scalar;
+			WAC_VM_CASE(WAC_OP_GET_SCALAR):
+				a = frame->bp[frame->ip[0]];
+				arg3 = frame->ip[1];
+				arg = frame->ip[2];
+				arg2 = frame->ip[3];
+				frame->ip += 4;
+			wac_vm_get_scalar:
+				if (!WAC_OBJ_IS_INSTANCE(a)) {
+					wac_vm_push(vm, frame->bp[arg3]);
+					WAC_VM_NEXT();
+				}
+				wac_vm_push(vm, a);
+				goto wac_vm_arg_WAC_OP_GET_PROPERTY_CONST;
+			WAC_VM_CASE(WAC_OP_SET_SCALAR_LONG):
+				a = frame->bp[WAC_READ_4_BYTES()];
+				arg3 = WAC_READ_4_BYTES();
+				arg = WAC_READ_4_BYTES();
+				arg2 = WAC_READ_4_BYTES();
+				goto wac_vm_set_scalar;
+			WAC_VM_CASE(WAC_OP_SET_SCALAR):
+				a = frame->bp[frame->ip[0]];
+				arg3 = frame->ip[1];
+				arg = frame->ip[2];
+				arg2 = frame->ip[3];
+				frame->ip += 4;
+			wac_vm_set_scalar:
+				if (!WAC_OBJ_IS_INSTANCE(a)) {
+					frame->bp[arg3] = vm->sp[-1];
+					WAC_VM_NEXT();
+				}
+				vm->sp[0] = vm->sp[-1];
+				vm->sp[-1] = a;
+				++vm->sp;
+				goto wac_vm_arg_WAC_OP_SET_PROPERTY_CONST;
+			WAC_VM_CASE(WAC_OP_RET): {
 				wac_value_t result = wac_vm_pop(vm);
-				wac_vm_closeUpvals(vm, frame->bp);
+				if (frame->closure->fun->closesUpvals) wac_vm_closeUpvals(vm, frame->bp);
 				--vm->frames_usize;
 				if (vm->frames_usize == 0) {
 					wac_vm_pop(vm);
@@ -576,8 +1374,186 @@ static wac_interpretResult_t wac_vm_run(wac_state_t *state) {
 				vm->sp = frame->bp;
 				wac_vm_push(vm, result);
 				frame = &vm->frames[vm->frames_usize - 1];
-				break;
+				WAC_VM_NEXT();
 			}
+			WAC_VM_CASE_REG(WAC_OP_ADD)
+				if (WAC_OBJ_IS_STRING(a) && WAC_OBJ_IS_STRING(b)) {
+					wac_vm_push(vm, a);
+					wac_vm_push(vm, b);
+					wac_vm_concat(state);
+					result = wac_vm_pop(vm);
+					goto wac_vm_reg_store;
+				}
+				if (!WAC_VAL_IS_NUMERIC(a) || !WAC_VAL_IS_NUMERIC(b)) {
+					wac_vm_error(vm, "Operands must be two numbers or two strings");
+					return WAC_INTERPRET_RUNTIME_ERROR;
+				}
+				WAC_REG_OP(+);
+			WAC_VM_CASE_REG(WAC_OP_SUB)
+				WAC_REG_OP(-);
+			WAC_VM_CASE_REG(WAC_OP_MUL)
+				WAC_REG_OP(*);
+			WAC_VM_CASE_REG(WAC_OP_DIV)
+				WAC_REG_NUM_OP(WAC_VAL_NUMBER((double)x / (double)y), WAC_VAL_NUMBER(x / y));
+			WAC_VM_CASE_REG(WAC_OP_GREATER)
+				WAC_REG_CMP(>);
+			WAC_VM_CASE_REG(WAC_OP_LESS)
+				WAC_REG_CMP(<);
+			WAC_VM_CASE_REG(WAC_OP_EQUAL)
+				result = WAC_VAL_BOOL(wac_value_equal(a, b));
+			wac_vm_reg_store:
+				if (reg) {
+					frame->bp[frame->ip[0]] = result;
+				} else {
+					//operands may not have been pushed, so the slot can be at sp
+					vm->sp = frame->bp + frame->ip[0];
+					wac_vm_push(vm, result);
+				}
+				frame->ip += 3;
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_GET_LOCAL_2):
+				wac_vm_push(vm, frame->bp[frame->ip[0]]);
+				wac_vm_push(vm, frame->bp[frame->ip[1]]);
+				frame->ip += 2;
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_GET_LOCAL_CONST):
+				wac_vm_push(vm, frame->bp[frame->ip[0]]);
+				arg = frame->ip[1];
+				wac_vm_push(vm, WAC_READ_CONST());
+				frame->ip += 2;
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_GET_LOCAL_PROPERTY):
+				wac_vm_push(vm, frame->bp[WAC_READ_BYTE()]);
+				arg = WAC_READ_BYTE();
+				arg2 = WAC_READ_BYTE();
+				goto wac_vm_arg_WAC_OP_GET_PROPERTY_CONST;
+			WAC_VM_CASE(WAC_OP_SET_LOCAL_POP):
+				frame->bp[WAC_READ_BYTE()] = wac_vm_pop(vm);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_NOT_EQUAL):
+				b = wac_vm_pop(vm);
+				a = wac_vm_pop(vm);
+				wac_vm_push(vm, WAC_VAL_BOOL(!wac_value_equal(a, b)));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_GREATER_EQUAL):
+				WAC_CMP_OP(WAC_VAL_BOOL_NOT, <);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_LESS_EQUAL):
+				WAC_CMP_OP(WAC_VAL_BOOL_NOT, >);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_EQUAL_JMP_FALSE):
+				WAC_CMP_JMP_FALSE(false, wac_value_equal(a, b));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_NOT_EQUAL_JMP_FALSE):
+				WAC_CMP_JMP_FALSE(false, !wac_value_equal(a, b));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_GREATER_JMP_FALSE):
+				WAC_CMP_JMP_FALSE(true, WAC_NUM_CMP(>));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_GREATER_EQUAL_JMP_FALSE):
+				WAC_CMP_JMP_FALSE(true, !WAC_NUM_CMP(<));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_LESS_JMP_FALSE):
+				WAC_CMP_JMP_FALSE(true, WAC_NUM_CMP(<));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_LESS_EQUAL_JMP_FALSE):
+				WAC_CMP_JMP_FALSE(true, !WAC_NUM_CMP(>));
+				WAC_VM_NEXT();
+			//on failed guard the generic op runs the instruction again
+			WAC_VM_CASE(WAC_OP_ADD_NUM_NUM):
+				a = vm->sp[-2];
+				b = vm->sp[-1];
+				if (!WAC_VAL_IS_NUMBER(a) || !WAC_VAL_IS_NUMBER(b)) {
+					*--frame->ip = WAC_OP_ADD;
+					WAC_VM_NEXT();
+				}
+				--vm->sp;
+				vm->sp[-1] = WAC_VAL_NUMBER(WAC_VAL_AS_NUMBER(a) + WAC_VAL_AS_NUMBER(b));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_LESS_NUM):
+				a = vm->sp[-2];
+				b = vm->sp[-1];
+				if (!WAC_VAL_IS_NUMBER(a) || !WAC_VAL_IS_NUMBER(b)) {
+					*--frame->ip = WAC_OP_LESS;
+					WAC_VM_NEXT();
+				}
+				--vm->sp;
+				vm->sp[-1] = WAC_VAL_BOOL(WAC_VAL_AS_NUMBER(a) < WAC_VAL_AS_NUMBER(b));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_ADD_INT_INT):
+				a = vm->sp[-2];
+				b = vm->sp[-1];
+				if (!WAC_VAL_IS_INT(a) || !WAC_VAL_IS_INT(b)) {
+					*--frame->ip = WAC_OP_ADD;
+					WAC_VM_NEXT();
+				}
+				--vm->sp;
+				vm->sp[-1] = WAC_VAL_INT(WAC_INT_WRAP(WAC_VAL_AS_INT(a), +, WAC_VAL_AS_INT(b)));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_LESS_INT):
+				a = vm->sp[-2];
+				b = vm->sp[-1];
+				if (!WAC_VAL_IS_INT(a) || !WAC_VAL_IS_INT(b)) {
+					*--frame->ip = WAC_OP_LESS;
+					WAC_VM_NEXT();
+				}
+				--vm->sp;
+				vm->sp[-1] = WAC_VAL_BOOL(WAC_VAL_AS_INT(a) < WAC_VAL_AS_INT(b));
+				WAC_VM_NEXT();
+			WAC_VM_CASE_ARG_AT(WAC_OP_CALL_CLOSURE_EXACT_ARITY)
+				b = wac_vm_peek(vm, arg);
+				if (!WAC_OBJ_IS_CLOSURE(b) || WAC_OBJ_AS_CLOSURE(b)->fun->arity != arg) {
+					WAC_VM_QUICKEN(WAC_OP_CALL_CLOSURE_EXACT_ARITY, WAC_OP_CALL);
+					goto wac_vm_arg_WAC_OP_CALL;
+				}
+				if (!wac_vm_call_exact(state, WAC_OBJ_AS_CLOSURE(b), arg)) return WAC_INTERPRET_RUNTIME_ERROR;
+				frame = &vm->frames[vm->frames_usize - 1];
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_ADD_II):
+				WAC_TYPED_INT_OP(+);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_SUB_II):
+				WAC_TYPED_INT_OP(-);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_MUL_II):
+				WAC_TYPED_INT_OP(*);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_ADD_DD):
+				WAC_TYPED_NUM_OP(+);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_SUB_DD):
+				WAC_TYPED_NUM_OP(-);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_MUL_DD):
+				WAC_TYPED_NUM_OP(*);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_DIV_DD):
+				WAC_TYPED_NUM_OP(/);
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_GREATER_II_JMP_FALSE):
+				WAC_TYPED_JMP_FALSE(WAC_VAL_IS_INT, WAC_VAL_AS_INT(a) > WAC_VAL_AS_INT(b));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_GREATER_EQUAL_II_JMP_FALSE):
+				WAC_TYPED_JMP_FALSE(WAC_VAL_IS_INT, WAC_VAL_AS_INT(a) >= WAC_VAL_AS_INT(b));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_LESS_II_JMP_FALSE):
+				WAC_TYPED_JMP_FALSE(WAC_VAL_IS_INT, WAC_VAL_AS_INT(a) < WAC_VAL_AS_INT(b));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_LESS_EQUAL_II_JMP_FALSE):
+				WAC_TYPED_JMP_FALSE(WAC_VAL_IS_INT, WAC_VAL_AS_INT(a) <= WAC_VAL_AS_INT(b));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_GREATER_DD_JMP_FALSE):
+				WAC_TYPED_JMP_FALSE(WAC_VAL_IS_NUMBER, WAC_VAL_AS_NUMBER(a) > WAC_VAL_AS_NUMBER(b));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_GREATER_EQUAL_DD_JMP_FALSE):
+				WAC_TYPED_JMP_FALSE(WAC_VAL_IS_NUMBER, !(WAC_VAL_AS_NUMBER(a) < WAC_VAL_AS_NUMBER(b)));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_LESS_DD_JMP_FALSE):
+				WAC_TYPED_JMP_FALSE(WAC_VAL_IS_NUMBER, WAC_VAL_AS_NUMBER(a) < WAC_VAL_AS_NUMBER(b));
+				WAC_VM_NEXT();
+			WAC_VM_CASE(WAC_OP_LESS_EQUAL_DD_JMP_FALSE):
+				WAC_TYPED_JMP_FALSE(WAC_VAL_IS_NUMBER, !(WAC_VAL_AS_NUMBER(a) > WAC_VAL_AS_NUMBER(b)));
+				WAC_VM_NEXT();
 		}
 	}
 }
@@ -594,15 +1570,26 @@ static void wac_vm_objs_free(wac_state_t *state) {
 void wac_vm_free(wac_state_t *state) {
 	wac_vm_t *vm = &state->vm;
 
-	WAC_ARRAY_FREE(state, wac_frame_t, vm->frames, vm->frames_asize);
-	free(vm->stack);
+#ifdef WAC_DEBUG_PROFILE_OPS
+	wac_profile_print(&vm->profile);
+#endif
+
+	wac_vmem_release(&vm->frames_vmem);
+	wac_vmem_release(&vm->stack_vmem);
+	wac_vmem_release(&vm->upvalSlots_vmem);
 	free(vm->grays);
 
+	vm->frames_asize = 0;
+	vm->frames = NULL;
 	vm->stack_asize = 0;
 	vm->sp = NULL;
 	vm->stack = NULL;
+	vm->upvalSlots = NULL;
 
 	wac_vm_objs_free(state);
-	wac_table_free(state, &vm->globals);
+	WAC_ARRAY_FREE(state, wac_value_t, vm->globals, vm->globals_asize);
+	wac_table_free(state, &vm->globalNames);
+	wac_table_free(state, &vm->globalConsts);
 	wac_table_free(state, &vm->strings);
+	wac_shape_free(state, vm->shapeRoot);
 }
@@ -6,8 +6,31 @@
 #include "wac_value.h"
 #include "wac_table.h"
 #include "wac_object.h"
+#include "wac_vmem.h"
 
-//#define WAC_STACK_MAX 256
+#ifdef WAC_DEBUG_PROFILE_OPS
+#include "wac_debug.h"
+#endif
+
+//reserved when the vm starts, pages are committed as calls go deeper
+//going over is a "Stack overflow" runtime error
+#define WAC_STACK_MAX	(1024 * 1024)
+#define WAC_FRAMES_MAX	(64 * 1024)
+
+//stack slots above frame's max stack, for values pushed by the vm itself
+//(operands of concat, objects kept from gc while being created)
+#define WAC_STACK_SLACK 4
+
+//entries of vm->methods, power of 2
+#define WAC_VM_METHOD_CACHE_SIZE 256
+
+//(class, name) -> method, hit of every call site of the program
+//classes can be freed and their address reused, so gc clears it all
+typedef struct wac_vm_methodEntry_s {
+	wac_obj_class_t *klass;
+	wac_obj_string_t *name;
+	wac_obj_closure_t *method;
+} wac_vm_methodEntry_t;
 
 typedef struct wac_frame_s {
 	wac_obj_closure_t *closure;
@@ -16,23 +39,42 @@ typedef struct wac_frame_s {
 } wac_frame_t;
 
 struct wac_vm_s {
+	//asize is the committed part of vmem, addresses never move
+	wac_vmem_t frames_vmem;
 	size_t frames_asize, frames_usize;
 	wac_frame_t *frames;
 
+	wac_vmem_t stack_vmem;
 	size_t stack_asize;
 	wac_value_t *stack;
 	wac_value_t *sp;
+	//open upval of each stack slot or NULL, committed along with the stack
+	wac_vmem_t upvalSlots_vmem;
+	wac_obj_upval_t **upvalSlots;
 
-	wac_table_t globals;
+	//compiler resolves global names to indices into globals
+	//globalNames maps name -> index for natives, the repl and globals used before they are defined
+	wac_table_t globalNames;
+	//name -> value of top level consts of earlier compilations, so the repl keeps them constant
+	wac_table_t globalConsts;
+	size_t globals_asize, globals_usize;
+	wac_value_t *globals;
 	wac_table_t strings;
 	wac_obj_string_t *initString;
 	wac_obj_upval_t *openUpvals;
+	//empty shape every instance starts with
+	wac_shape_t *shapeRoot;
+	wac_vm_methodEntry_t methods[WAC_VM_METHOD_CACHE_SIZE];
 	wac_obj_t *objs;
 
 	size_t mem_total, mem_nextGC;
 
 	size_t grays_asize, grays_usize;
 	wac_obj_t **grays;
+
+#ifdef WAC_DEBUG_PROFILE_OPS
+	wac_profile_t profile;
+#endif
 };
 
 
@@ -47,6 +89,9 @@ void wac_defineNativeFun(wac_state_t *state, uint32_t arity, const char *name, w
 wac_interpretResult_t wac_interpret(wac_state_t *state, const char *src);
 void wac_vm_push(wac_vm_t *vm, wac_value_t value);
 wac_value_t wac_vm_pop(wac_vm_t *vm);
+void wac_vm_methods_clear(wac_vm_t *vm);
+int64_t wac_vm_shl(int64_t x, int64_t y);
+uint32_t wac_vm_global_index(wac_state_t *state, wac_obj_string_t *name);
 void wac_vm_free(wac_state_t *state);
 
 #endif //__WAC_VM_H
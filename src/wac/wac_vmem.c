@@ -0,0 +1,92 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "wac_vmem.h"
+
+static size_t wac_vmem_pageSize(void) {
+	static size_t pageSize = 0;
+	if (!pageSize) {
+#ifdef _WIN32
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		pageSize = info.dwPageSize;
+#else
+		pageSize = (size_t)sysconf(_SC_PAGESIZE);
+#endif
+	}
+	return pageSize;
+}
+
+static size_t wac_vmem_pageAlign(size_t size) {
+	size_t pageSize = wac_vmem_pageSize();
+	return (size + pageSize - 1) / pageSize * pageSize;
+}
+
+//nothing is usable until wac_vmem_commit
+bool wac_vmem_reserve(wac_vmem_t *vmem, size_t size) {
+	size_t total;
+
+	vmem->reserved = wac_vmem_pageAlign(size);
+	vmem->committed = 0;
+	total = vmem->reserved + wac_vmem_pageSize();
+
+#ifdef _WIN32
+	vmem->base = VirtualAlloc(NULL, total, MEM_RESERVE, PAGE_NOACCESS);
+	return vmem->base != NULL;
+#else
+	vmem->base = mmap(NULL, total, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (vmem->base == MAP_FAILED) {
+		vmem->base = NULL;
+		return false;
+	}
+	return true;
+#endif
+}
+
+//makes at least size bytes from base usable, never moves base
+//commits at least twice what it had, so it is done O(log n) times
+bool wac_vmem_commit(wac_vmem_t *vmem, size_t size) {
+	size_t newSize;
+
+	if (size <= vmem->committed) return true;
+	if (size > vmem->reserved) return false;
+
+	newSize = vmem->committed * 2;
+	if (newSize < size) newSize = size;
+	newSize = wac_vmem_pageAlign(newSize);
+	if (newSize > vmem->reserved) newSize = vmem->reserved;
+
+#ifdef _WIN32
+	if (!VirtualAlloc(vmem->base + vmem->committed, newSize - vmem->committed, MEM_COMMIT, PAGE_READWRITE)) return false;
+#else
+	if (mprotect(vmem->base + vmem->committed, newSize - vmem->committed, PROT_READ | PROT_WRITE)) return false;
+#endif
+
+	vmem->committed = newSize;
+	return true;
+}
+
+void wac_vmem_release(wac_vmem_t *vmem) {
+	if (vmem->base) {
+#ifdef _WIN32
+		VirtualFree(vmem->base, 0, MEM_RELEASE);
+#else
+		munmap(vmem->base, vmem->reserved + wac_vmem_pageSize());
+#endif
+	}
+
+	vmem->base = NULL;
+	vmem->reserved = 0;
+	vmem->committed = 0;
+}
@@ -0,0 +1,17 @@
+#ifndef __WAC_VMEM_H
+#define __WAC_VMEM_H
+
+#include "wac_common.h"
+
+//address space reserved up front and committed page by page
+//the page after the reserved size is never committed, it is the guard page
+typedef struct wac_vmem_s {
+	uint8_t *base;
+	size_t reserved, committed;
+} wac_vmem_t;
+
+bool wac_vmem_reserve(wac_vmem_t *vmem, size_t size);
+bool wac_vmem_commit(wac_vmem_t *vmem, size_t size);
+void wac_vmem_release(wac_vmem_t *vmem);
+
+#endif //__WAC_VMEM_H